@@ -0,0 +1,106 @@
+#include "benchmark.hpp"
+
+#include <tech-core/shapes/frustum.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using Clock = std::chrono::high_resolution_clock;
+
+const uint32_t BenchmarkRepeats = 50;
+
+template<typename Callback>
+double timeNanoseconds(uint32_t count, Callback &&callback) {
+    auto start = Clock::now();
+    for (uint32_t repeat = 0; repeat < BenchmarkRepeats; ++repeat) {
+        callback();
+    }
+    auto end = Clock::now();
+
+    std::chrono::duration<double, std::nano> elapsed = end - start;
+    return elapsed.count() / (static_cast<double>(count) * BenchmarkRepeats);
+}
+
+void runCullingBenchmark(uint32_t count) {
+    // Times are reported per bound
+    if (count == 0) {
+        std::cerr << "The culling benchmark needs at least one bound" << std::endl;
+        return;
+    }
+
+    Engine::Frustum frustum;
+    frustum.update(
+        glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 500.0f) *
+            glm::lookAt(glm::vec3(0, 0, 0), glm::vec3(1, 0, 0), glm::vec3(0, 1, 0))
+    );
+
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(-500, 500);
+    std::uniform_real_distribution<float> size(0.1f, 10);
+
+    std::vector<float> xMin(count), yMin(count), zMin(count), xMax(count), yMax(count), zMax(count);
+    std::vector<float> x(count), y(count), z(count), radius(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        x[i] = position(random);
+        y[i] = position(random);
+        z[i] = position(random);
+        radius[i] = size(random);
+
+        xMin[i] = x[i] - radius[i];
+        yMin[i] = y[i] - radius[i];
+        zMin[i] = z[i] - radius[i];
+        xMax[i] = x[i] + radius[i];
+        yMax[i] = y[i] + radius[i];
+        zMax[i] = z[i] + radius[i];
+    }
+
+    Engine::BoxArrays boxes { xMin.data(), yMin.data(), zMin.data(), xMax.data(), yMax.data(), zMax.data() };
+    Engine::SphereArrays spheres { x.data(), y.data(), z.data(), radius.data() };
+
+    std::vector<uint64_t> scalarVisibility((count + 63) / 64);
+    std::vector<uint64_t> boxVisibility((count + 63) / 64);
+    std::vector<uint64_t> sphereVisibility((count + 63) / 64);
+
+    auto scalarTime = timeNanoseconds(
+        count, [&]() {
+            std::fill(scalarVisibility.begin(), scalarVisibility.end(), 0);
+            for (uint32_t i = 0; i < count; ++i) {
+                if (frustum.intersects({ xMin[i], yMin[i], zMin[i] }, { xMax[i], yMax[i], zMax[i] })) {
+                    scalarVisibility[i / 64] |= 1ull << (i % 64);
+                }
+            }
+        }
+    );
+
+    auto boxTime = timeNanoseconds(
+        count, [&]() {
+            frustum.intersects(boxes, count, boxVisibility.data());
+        }
+    );
+
+    auto sphereTime = timeNanoseconds(
+        count, [&]() {
+            frustum.intersects(spheres, count, sphereVisibility.data());
+        }
+    );
+
+    uint32_t visible = 0;
+    uint32_t mismatched = 0;
+    for (size_t word = 0; word < scalarVisibility.size(); ++word) {
+        visible += std::popcount(scalarVisibility[word]);
+        mismatched += std::popcount(scalarVisibility[word] ^ boxVisibility[word]);
+    }
+
+    std::cout << "Culling " << count << " bounds (" << visible << " visible)" << std::endl;
+    std::cout << "  Boxes, one at a time: " << scalarTime << " ns each" << std::endl;
+    std::cout << "  Boxes, batched:       " << boxTime << " ns each" << std::endl;
+    std::cout << "  Spheres, batched:     " << sphereTime << " ns each" << std::endl;
+    if (mismatched > 0) {
+        std::cout << "  WARNING: " << mismatched << " boxes differ from the one at a time test" << std::endl;
+    }
+}
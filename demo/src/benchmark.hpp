@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Times frustum culling of the given number of random boxes and spheres,
+ * comparing one at a time tests against the batched tests.
+ * Nothing is run when the count is 0
+ */
+void runCullingBenchmark(uint32_t count);
@@ -15,10 +15,17 @@
 #include <tech-core/scene/components/mesh_renderer.hpp>
 #include <tech-core/scene/entity.hpp>
 #include <imgui.h>
+#include <iostream>
 
 
 const float AverageFPSFactor = 0.983;
 
+void Demo::setHeadless(uint32_t frames) {
+    headless = true;
+    headlessFrames = frames;
+    engine.setHeadless(1920, 1080);
+}
+
 void Demo::initialize() {
     engine.addSubsystem(Engine::Subsystem::DebugSubsystem::ID);
     engine.addSubsystem(Engine::Subsystem::ImGuiSubsystem::ID);
@@ -83,11 +90,18 @@ void Demo::initScene() {
 
 void Demo::run() {
     lastFrameStart = std::chrono::high_resolution_clock::now();
+    auto runStart = lastFrameStart;
+    uint32_t frameCount = 0;
 
     while (engine.beginFrame()) {
-        if (this->inputManager->isPressed(Engine::Key::eEscape)) {
+        if (headless) {
+            if (frameCount == headlessFrames) {
+                break;
+            }
+        } else if (this->inputManager->isPressed(Engine::Key::eEscape)) {
             break;
         }
+        ++frameCount;
 
         auto frameStart = std::chrono::high_resolution_clock::now();
         std::chrono::duration<double> timeDelta = frameStart - lastFrameStart;
@@ -96,12 +110,20 @@ void Demo::run() {
         averageFPS = averageFPS * AverageFPSFactor + instantFPS * (1 - AverageFPSFactor);
         instantFrameTime = timeDelta.count();
 
-        handleCameraMovement();
+        if (!headless) {
+            handleCameraMovement();
+        }
 
         showSceneDebugUI(*engine.getScene());
 
         engine.render();
     }
+
+    if (headless && frameCount > 0) {
+        std::chrono::duration<double, std::milli> total = std::chrono::high_resolution_clock::now() - runStart;
+        std::cout << "Rendered " << frameCount << " frames, average frame time " << total.count() / frameCount
+            << "ms" << std::endl;
+    }
 }
 
 
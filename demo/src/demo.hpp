@@ -9,6 +9,10 @@
 
 class Demo {
 public:
+    /**
+     * Renders offscreen for the given number of frames then stops
+     */
+    void setHeadless(uint32_t frames);
     void initialize();
 
     void run();
@@ -25,6 +29,10 @@ private:
     float instantFPS { 0 };
     float instantFrameTime { 0 };
 
+    // Headless
+    bool headless { false };
+    uint32_t headlessFrames { 0 };
+
     void initScene();
     void handleCameraMovement();
 };
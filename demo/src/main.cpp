@@ -1,9 +1,33 @@
 #include <iostream>
+#include <string>
+#include <string_view>
 #include "demo.hpp"
+#include "benchmark.hpp"
+
+int main(int argc, char **argv) {
+    // --benchmark-culling [count] times the frustum culling paths without starting the engine
+    if (argc > 1 && std::string_view(argv[1]) == "--benchmark-culling") {
+        uint32_t count = 100000;
+        if (argc > 2) {
+            count = std::stoul(argv[2]);
+        }
+
+        runCullingBenchmark(count);
+        return 0;
+    }
 
-int main() {
     Demo demo;
 
+    // --headless [frames] renders offscreen for a fixed number of frames and reports the frame time
+    if (argc > 1 && std::string_view(argv[1]) == "--headless") {
+        uint32_t frames = 1000;
+        if (argc > 2) {
+            frames = std::stoul(argv[2]);
+        }
+
+        demo.setHeadless(frames);
+    }
+
     try {
         demo.initialize();
     } catch (std::exception &ex) {
@@ -6,8 +6,10 @@
 
 #include <deque>
 #include <limits>
-#include <list>
+#include <memory>
+#include <vector>
 #include "forward.hpp"
+#include "section_allocator.hpp"
 
 // When defined, this will enable debug logging for buffers
 // #define DEBUG_BUFFER
@@ -32,8 +34,9 @@ struct BufferFence {
 
 class BufferManager {
     friend class RenderEngine;
+    friend class StagingBuffer;
 public:
-    explicit BufferManager(VulkanDevice &device);
+    BufferManager(VulkanDevice &device, uint32_t framesInFlight);
 
     /**
      * General purpose buffer aquisition.
@@ -72,27 +75,32 @@ public:
     );
 
     /**
-     * Releases a buffer after the next frame has completed.
-     * This should be used for releasing any buffer that is used in the
-     * render pipeline
+     * Replicated buffer aquisition.
+     * This buffer keeps a separate copy for each frame that can be in use
      */
-    void releaseAfterFrame(std::unique_ptr<Buffer> buffer);
+    std::unique_ptr<ReplicatedBuffer> aquireReplicated(
+        vk::DeviceSize size,
+        vk::BufferUsageFlags usage,
+        vk::MemoryUsage memoryUsage,
+        uint32_t copies
+    );
 
     /**
-     * Aquire a staging buffer of the required size.
-     * A staging buffer has the following characteristics:
-     * - It is CPU local
-     * - Can be used as a transfer source
+     * Releases a buffer after every frame currently in flight has completed.
+     * This should be used for releasing any buffer that is used in the
+     * render pipeline
      */
-    std::unique_ptr<Buffer> aquireStaging(vk::DeviceSize size);
+    void releaseAfterFrame(std::unique_ptr<Buffer> buffer);
 
     /**
      * Aquire a staging buffer of the required size.
      * A staging buffer has the following characteristics:
      * - It is CPU local
      * - Can be used as a transfer source
+     * - It is a region of a shared ring buffer, so it must be kept alive until the
+     *   transfer has completed. Use Task::freeWhenDone()
      */
-    std::shared_ptr<Buffer> aquireStagingShared(vk::DeviceSize size);
+    std::unique_ptr<StagingBuffer> aquireStaging(vk::DeviceSize size);
 
     /**
      * Releases a buffer
@@ -107,27 +115,60 @@ public:
 
 private:
     void processActions();
+    /**
+     * Releases all pending buffers. The device must be idle
+     */
+    void releaseAll();
+
+    struct StagingEntry {
+        vk::DeviceSize start;
+        vk::DeviceSize end;
+        bool released;
+    };
 
     // Provided fields
     VulkanDevice &device;
+    const uint32_t framesInFlight;
 
     // State
-    std::deque<std::unique_ptr<Buffer>> nextFrameRelease;
+    // Buffers released during each of the frames that may still be in flight. Oldest first
+    std::deque<std::deque<std::unique_ptr<Buffer>>> frameRelease;
     std::deque<BufferFence> fenceRelease;
 
-    /*
-    TODO: This is where we left off.
-    The idea here is: 
-    Instead of creating a staging buffer as a stack variable and then waiting until the transfer is complete,
-    we use this class to aquire a buffer of the correct size for staging use.
-    We write whatever to it and queue it up to be transferred.
-    After queueing it up, submit the task and release the staging buffer back to this class
-    along with a fence. We will then use the fence to determine if the resource can be returned or not.
-    We dont actually need to wait, we can just query the status using device.waitForFences with a 0 timeout.
-    https://www.khronos.org/registry/vulkan/specs/1.2-extensions/man/html/vkWaitForFences.html
-
-    The check for buffers to be released can be done after each frame I think.
-    */
+    // Staging ring. Regions are handed out in order and reclaimed from the front as their tasks complete
+    std::unique_ptr<Buffer> stagingRing;
+    std::deque<StagingEntry> stagingEntries;
+    uint64_t firstStagingEntry { 0 };
+
+    bool allocateStaging(vk::DeviceSize size, vk::DeviceSize &offset, uint64_t &entry);
+    void releaseStaging(uint64_t entry);
+};
+
+/**
+ * Tracks the ranges of a buffer written since they were last flushed.
+ * Adjacent and overlapping ranges are merged so each region is only flushed once.
+ */
+class DirtyRanges {
+public:
+    struct Range {
+        vk::DeviceSize offset;
+        vk::DeviceSize size;
+    };
+
+    void add(vk::DeviceSize offset, vk::DeviceSize size);
+
+    bool empty() const { return ranges.empty(); }
+
+    /**
+     * Sorts and merges the ranges
+     */
+    const std::vector<Range> &merged();
+
+    void clear();
+
+private:
+    std::vector<Range> ranges;
+    bool isMerged { true };
 };
 
 class Buffer {
@@ -179,13 +220,25 @@ public:
     }
 
     inline void map(void **data) {
-        vmaMapMemory(allocator, allocation, data);
+        if (mappedData) {
+            *data = mappedData;
+        } else {
+            vmaMapMemory(allocator, allocation, data);
+        }
     }
 
     inline void unmap() {
-        vmaUnmapMemory(allocator, allocation);
+        if (!mappedData) {
+            vmaUnmapMemory(allocator, allocation);
+        }
     }
 
+    /**
+     * Host visible buffers stay mapped for their whole life.
+     * @returns The mapped memory or nullptr if this buffer is not host visible
+     */
+    void *getMappedData() const { return mappedData; }
+
     /**
      * Flushes the entire buffer.
      * Only applicable for host visible but non-coherent buffers
@@ -196,6 +249,16 @@ public:
      * Only applicable for host visible but non-coherent buffers
      */
     void flushRange(vk::DeviceSize start, vk::DeviceSize size);
+    /**
+     * Flushes all of the dirty ranges then clears them.
+     * Only applicable for host visible but non-coherent buffers
+     */
+    void flushRanges(DirtyRanges &ranges);
+    /**
+     * Makes device writes to a range of memory visible to the host.
+     * Only applicable for host visible but non-coherent buffers
+     */
+    void invalidateRange(vk::DeviceSize start, vk::DeviceSize size);
 
     const vk::Buffer buffer() const {
         return internalBuffer;
@@ -212,12 +275,7 @@ protected:
 private:
     VmaAllocator allocator;
     VmaAllocation allocation;
-};
-
-#define ALLOCATION_FAILED std::numeric_limits<vk::DeviceSize>::max()
-struct FreeSpace {
-    vk::DeviceSize offset;
-    vk::DeviceSize size;
+    void *mappedData { nullptr };
 };
 
 class DivisibleBuffer : public Buffer {
@@ -234,20 +292,168 @@ public:
     /**
      * Releases a previously held region of the buffer
      */
-    void freeSection(vk::DeviceSize offset, vk::DeviceSize size);
-    template<typename T>
     void freeSection(vk::DeviceSize offset);
 
     /**
      * Allocates a new region of the buffer.
+     * @param alignment The required alignment of the offset. Must be a power of 2
      * @returns The offset in the buffer. Returns ALLOCATION_FAILED if allocation failed
      */
-    vk::DeviceSize allocateSection(vk::DeviceSize size);
+    vk::DeviceSize allocateSection(vk::DeviceSize size, vk::DeviceSize alignment = 1);
+
     template<typename T>
-    vk::DeviceSize allocateSection();
+    vk::DeviceSize allocateSection() {
+        return allocateSection(sizeof(T), alignof(T));
+    }
+
+    SectionAllocatorStats getStats() const {
+        return sections.getStats();
+    }
 
 private:
-    std::list<FreeSpace> freeSpaceTracking;
+    SectionAllocator sections;
+};
+
+/**
+ * A region of memory to upload from.
+ * Small staging buffers are taken from the BufferManager staging ring, large ones get their own buffer.
+ * Either way, offsets are relative to the start of this region.
+ */
+class StagingBuffer {
+    friend class BufferManager;
+public:
+    ~StagingBuffer();
+    StagingBuffer(const StagingBuffer &) = delete;
+
+    vk::DeviceSize getSize() const { return size; }
+
+    /**
+     * The buffer that this region is within
+     */
+    const Buffer &getBuffer() const { return *buffer; }
+
+    /**
+     * The offset of this region in getBuffer()
+     */
+    vk::DeviceSize getOffset() const { return offset; }
+
+    void copyIn(const void *data, vk::DeviceSize offset, vk::DeviceSize size);
+
+    inline void copyIn(const void *data, vk::DeviceSize size = VK_WHOLE_SIZE) {
+        if (size == VK_WHOLE_SIZE) {
+            size = this->size;
+        }
+
+        copyIn(data, 0, size);
+    }
+
+    void transfer(
+        VkCommandBuffer commandBuffer, Buffer &target, vk::DeviceSize srcOffset, vk::DeviceSize destOffset,
+        vk::DeviceSize size
+    );
+
+    inline void transfer(VkCommandBuffer commandBuffer, Buffer &target, vk::DeviceSize offset, vk::DeviceSize size) {
+        transfer(commandBuffer, target, offset, 0, size);
+    }
+
+    inline void transfer(VkCommandBuffer commandBuffer, Buffer &target, vk::DeviceSize size = VK_WHOLE_SIZE) {
+        if (size == VK_WHOLE_SIZE) {
+            size = this->size;
+        }
+        transfer(commandBuffer, target, 0, 0, size);
+    }
+
+private:
+    StagingBuffer(BufferManager &manager, Buffer *buffer, vk::DeviceSize offset, vk::DeviceSize size, uint64_t entry);
+    StagingBuffer(BufferManager &manager, std::unique_ptr<Buffer> ownBuffer, vk::DeviceSize size);
+
+    // Provided
+    BufferManager &manager;
+    Buffer *buffer;
+    const vk::DeviceSize offset;
+    const vk::DeviceSize size;
+    const uint64_t entry;
+
+    // Owned. Only when not in the ring
+    std::unique_ptr<Buffer> ownBuffer;
+};
+
+/**
+ * A divisible buffer with one GPU copy per swap chain image.
+ * Writes go to a CPU side copy and are applied to each GPU copy only when
+ * that copy is updated, so copies still being read by frames in flight are left alone.
+ */
+class ReplicatedBuffer {
+public:
+    ReplicatedBuffer(
+        VmaAllocator allocator, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryUsage targetUsage,
+        uint32_t copies
+    );
+
+    vk::DeviceSize getSize() const { return size; }
+
+    uint32_t getCopyCount() const { return static_cast<uint32_t>(copies.size()); }
+
+    /**
+     * Changes the number of copies. New copies receive the current contents when next updated
+     */
+    void setCopyCount(uint32_t count);
+
+    void copyIn(const void *data, vk::DeviceSize offset, vk::DeviceSize size);
+
+    /**
+     * Grows the buffer keeping its contents. Each copy is replaced when it is next updated.
+     * Buffers divided into sections cannot be resized.
+     */
+    void resize(vk::DeviceSize size);
+
+    /**
+     * Applies all writes since the last update of this copy then flushes them together.
+     * Only call this once the copy is no longer in use by the GPU
+     * @returns true if the copy was replaced by a larger buffer
+     */
+    bool update(uint32_t copy);
+
+    const vk::Buffer buffer(uint32_t copy) const {
+        return copies[copy].buffer->buffer();
+    }
+
+    const std::shared_ptr<Buffer> &getCopy(uint32_t copy) const {
+        return copies[copy].buffer;
+    }
+
+    /**
+     * Releases a previously held region of the buffer
+     */
+    void freeSection(vk::DeviceSize offset);
+
+    /**
+     * Allocates a new region of the buffer.
+     * @param alignment The required alignment of the offset. Must be a power of 2
+     * @returns The offset in the buffer. Returns ALLOCATION_FAILED if allocation failed
+     */
+    vk::DeviceSize allocateSection(vk::DeviceSize size, vk::DeviceSize alignment = 1);
+
+    SectionAllocatorStats getStats() const {
+        return sections.getStats();
+    }
+
+private:
+    struct Copy {
+        std::shared_ptr<Buffer> buffer;
+        DirtyRanges pending;
+    };
+
+    // Provided
+    VmaAllocator allocator;
+    vk::DeviceSize size;
+    vk::BufferUsageFlags usage;
+    vk::MemoryUsage targetUsage;
+
+    // State
+    SectionAllocator sections;
+    std::vector<uint8_t> contents;
+    std::vector<Copy> copies;
 };
 
 }
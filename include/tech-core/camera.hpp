@@ -10,6 +10,8 @@ namespace Engine {
 struct CameraUBO {
     glm::mat4 view;
     glm::mat4 proj;
+    // Takes clip space back to world space, for rebuilding positions from depth
+    glm::mat4 inverseViewProj;
 };
 
 class CameraDescriptorSlot {
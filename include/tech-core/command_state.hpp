@@ -0,0 +1,123 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace Engine {
+
+struct CommandCounter {
+    uint32_t issued { 0 };
+    uint32_t skipped { 0 };
+
+    CommandCounter &operator+=(const CommandCounter &other) {
+        issued += other.issued;
+        skipped += other.skipped;
+        return *this;
+    }
+};
+
+struct CommandStateStats {
+    CommandCounter pipelines;
+    CommandCounter descriptorSets;
+    CommandCounter vertexBuffers;
+    CommandCounter indexBuffers;
+    CommandCounter pushConstants;
+
+    CommandStateStats &operator+=(const CommandStateStats &other) {
+        pipelines += other.pipelines;
+        descriptorSets += other.descriptorSets;
+        vertexBuffers += other.vertexBuffers;
+        indexBuffers += other.indexBuffers;
+        pushConstants += other.pushConstants;
+        return *this;
+    }
+
+    uint32_t totalIssued() const {
+        return pipelines.issued + descriptorSets.issued + vertexBuffers.issued + indexBuffers.issued +
+            pushConstants.issued;
+    }
+
+    uint32_t totalSkipped() const {
+        return pipelines.skipped + descriptorSets.skipped + vertexBuffers.skipped + indexBuffers.skipped +
+            pushConstants.skipped;
+    }
+};
+
+/**
+ * Remembers what has been bound in one command buffer so that binding the same
+ * state again records nothing.
+ * begin() must be called whenever recording into the command buffer starts.
+ */
+class CommandState {
+public:
+    static constexpr uint32_t MaxDescriptorSets = 8;
+    static constexpr uint32_t MaxVertexBindings = 4;
+
+    /**
+     * Forgets all bound state and targets the command buffer.
+     * The stats are kept until resetStats() is called.
+     */
+    void begin(vk::CommandBuffer);
+
+    vk::CommandBuffer getCommandBuffer() const { return commandBuffer; }
+
+    void bindPipeline(vk::PipelineBindPoint, vk::Pipeline);
+    void bindDescriptorSets(
+        vk::PipelineBindPoint, vk::PipelineLayout, uint32_t firstSet,
+        uint32_t descriptorSetCount, const vk::DescriptorSet *descriptorSets,
+        uint32_t dynamicOffsetCount, const uint32_t *dynamicOffsets
+    );
+    void bindVertexBuffer(uint32_t binding, vk::Buffer, vk::DeviceSize offset);
+    void bindIndexBuffer(vk::Buffer, vk::DeviceSize offset, vk::IndexType);
+    void pushConstants(
+        vk::PipelineLayout, vk::ShaderStageFlags, uint32_t offset, uint32_t size, const void *data
+    );
+
+    const CommandStateStats &getStats() const { return stats; }
+    void resetStats() { stats = {}; }
+
+private:
+    struct BoundSet {
+        vk::DescriptorSet set;
+        std::vector<uint32_t> dynamicOffsets;
+    };
+
+    struct BindPointState {
+        vk::Pipeline pipeline;
+        vk::PipelineLayout layout;
+        std::array<BoundSet, MaxDescriptorSets> sets;
+    };
+
+    struct VertexBinding {
+        vk::Buffer buffer;
+        vk::DeviceSize offset { 0 };
+    };
+
+    struct PushedRange {
+        vk::ShaderStageFlags stages;
+        uint32_t offset;
+        std::vector<uint8_t> data;
+    };
+
+    // Provided
+    vk::CommandBuffer commandBuffer;
+
+    // State
+    BindPointState graphics;
+    BindPointState compute;
+    std::array<VertexBinding, MaxVertexBindings> vertexBindings;
+    vk::Buffer indexBuffer;
+    vk::DeviceSize indexOffset { 0 };
+    vk::IndexType indexType { vk::IndexType::eUint16 };
+    vk::PipelineLayout pushLayout;
+    std::vector<PushedRange> pushedRanges;
+
+    CommandStateStats stats;
+
+    BindPointState &getBindPoint(vk::PipelineBindPoint);
+};
+
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "forward.hpp"
+#include "device.hpp"
 #include <vulkan/vulkan.hpp>
 
 #include <memory>
@@ -40,13 +41,38 @@ public:
     template<typename T>
     void execute(const T &pushData, uint32_t xElements, uint32_t yElements = 1, uint32_t zElements = 1);
 
+    /**
+     * Records the task into this frame's graphics commands ahead of rendering instead of
+     * submitting it to the compute queue. The results can be used by draws in the same frame.
+     * Must be called between starting the frame and beginning the render pass.
+     */
+    template<typename T>
+    void executeBeforeRender(
+        const T &pushData, uint32_t xElements, uint32_t yElements = 1, uint32_t zElements = 1
+    );
+
     void doAfterExecution(std::function<void()> callback);
 
+    /**
+     * Prevents the next execution from running until the point is reached.
+     * Use this to consume the results of a task without waiting on the CPU.
+     */
+    void waitFor(
+        const TimelinePoint &point,
+        const vk::PipelineStageFlags &stages = vk::PipelineStageFlagBits::eComputeShader
+    );
+    /**
+     * The point reached once the last submitted execution has completed
+     */
+    const TimelinePoint &getCompletion() const { return completion; }
+
     void bindImage(uint32_t binding, const std::shared_ptr<Image> &image);
     void bindBuffer(uint32_t binding, const std::shared_ptr<Buffer> &buffer);
 
     // This is for ExecutionController use only
     void fillCommandBuffer(vk::CommandBuffer);
+    std::vector<TimelineWait> takeWaits();
+    void notifySubmitted(const TimelinePoint &point);
     void notifyComplete();
 private:
     // Keep track of all images we use and make sure that the images are transitioned as appropriate
@@ -72,6 +98,8 @@ private:
     uint32_t yGroupSize { 1 };
     uint32_t zGroupSize { 1 };
     std::function<void()> callback;
+    std::vector<TimelineWait> waits;
+    TimelinePoint completion;
 
     // Bound Items
     std::map<uint32_t, std::shared_ptr<Image>> boundImages;
@@ -86,6 +114,8 @@ private:
     void push(const void *data, size_t size);
     void beginExecute();
     void internalExecute(uint32_t xElements, uint32_t yElements, uint32_t zElements);
+    void internalExecuteBeforeRender(uint32_t xElements, uint32_t yElements, uint32_t zElements);
+    void setGroupCounts(uint32_t xElements, uint32_t yElements, uint32_t zElements);
 };
 
 class ComputeTaskBuilder {
@@ -93,6 +123,7 @@ class ComputeTaskBuilder {
 public:
     ComputeTaskBuilder &fromFile(const char *filename, const char *symbol = "main");
     ComputeTaskBuilder &fromBytes(const char *bytes, size_t size, const char *symbol = "main");
+    ComputeTaskBuilder &fromBytes(const unsigned char *bytes, size_t size, const char *symbol = "main");
     ComputeTaskBuilder &fromBytes(const std::vector<char> &, const char *symbol = "main");
     template<typename T>
     ComputeTaskBuilder &withPushConstant();
@@ -141,6 +172,13 @@ void ComputeTask::execute(const T &pushData, uint32_t xElements, uint32_t yEleme
     internalExecute(xElements, yElements, zElements);
 }
 
+template<typename T>
+void ComputeTask::executeBeforeRender(const T &pushData, uint32_t xElements, uint32_t yElements, uint32_t zElements) {
+    beginExecute();
+    push(&pushData, sizeof(T));
+    internalExecuteBeforeRender(xElements, yElements, zElements);
+}
+
 template<typename T>
 ComputeTaskBuilder &ComputeTaskBuilder::withPushConstant() {
     pushConstant = vk::PushConstantRange(
@@ -7,9 +7,37 @@
 
 namespace Engine {
 
+/**
+ * A value on a queue's timeline semaphore.
+ * It is reached once all work submitted to the queue up to that point has completed.
+ */
+struct TimelinePoint {
+    vk::Semaphore semaphore;
+    uint64_t value { 0 };
+};
+
+/**
+ * A timeline point that a submission must wait on before the given stages can run
+ */
+struct TimelineWait {
+    TimelinePoint point;
+    vk::PipelineStageFlags stages;
+};
+
 struct VulkanQueue {
     uint32_t index;
     vk::Queue queue;
+
+    // Signalled with an increasing value by every submission to this queue
+    vk::Semaphore timeline;
+    uint64_t timelineValue { 0 };
+
+    /**
+     * Reserves the value to be signalled by the next submission
+     */
+    TimelinePoint nextTimelinePoint() {
+        return { timeline, ++timelineValue };
+    }
 };
 
 class VulkanDevice {
@@ -24,6 +52,7 @@ public:
     /**
      * Attempts to initiate a vulkan device.
      * 
+     * @param surface The surface that will be presented to. Leave null for a headless device
      * @throw DeviceNotSuitable if the device cannot be used
      */
     VulkanDevice(vk::PhysicalDevice device, vk::Instance instance, vk::SurfaceKHR surface);
@@ -33,6 +62,11 @@ public:
 
     void waitIdle() const;
 
+    /**
+     * Checks if the GPU has reached the timeline point without blocking
+     */
+    bool hasReached(const TimelinePoint &point) const;
+
     vk::Device device;
     VmaAllocator allocator;
 
@@ -45,12 +79,10 @@ public:
     vk::CommandPool computePool;
     vk::CommandPool transferPool;
 
-    vk::Semaphore renderFinished;
-    vk::Semaphore presentFinished;
-    vk::Semaphore readyForCompute;
-    vk::Semaphore computeFinished;
-    vk::Fence renderReady;
-    vk::Fence computeReady;
+    // Whether pipelines can use the depth bounds test
+    bool supportsDepthBounds { false };
+    // Whether indirect draws can start from an instance other than 0
+    bool supportsDrawIndirectFirstInstance { false };
 
 private:
     // Provided
@@ -59,6 +91,7 @@ private:
 
     VulkanQueueIndices findQueueIndices() const;
     bool hasAllRequiredExtensions() const;
+    bool hasTimelineSemaphores() const;
 };
 
 class DeviceNotSuitable : public std::exception {
@@ -16,6 +16,7 @@ struct SwapChainSupportDetails;
 #include "tech-core/gui/manager.hpp"
 #include "tech-core/subsystem/base.hpp"
 #include "post_processing.hpp"
+#include "command_state.hpp"
 
 
 #include <optional>
@@ -26,6 +27,25 @@ struct SwapChainSupportDetails;
 
 namespace Engine {
 
+/**
+ * The extra work done by the depth pre-pass in a frame
+ */
+struct DepthPrepassStats {
+    uint32_t draws { 0 };
+    // Triangles of every instance submitted to the pass. With GPU driven rendering these are the
+    // candidates before culling, not the instances actually drawn. See getGpuVisibleInstances()
+    uint64_t triangles { 0 };
+};
+
+/**
+ * The resolution point and spot lights are shaded at, relative to the window
+ */
+enum class LightingResolution {
+    Full,
+    Half,
+    Quarter
+};
+
 class RenderEngine {
 public:
     RenderEngine();
@@ -34,6 +54,31 @@ public:
 
     void initialize(const std::string_view &title);
 
+    /**
+     * Sets how many frames may be prepared while the GPU is still rendering previous ones.
+     * Must be between 1 and 3.
+     * NOTE: This needs to be set before initialization
+     */
+    void setFramesInFlight(uint32_t count);
+
+    uint32_t getFramesInFlight() const { return framesInFlight; }
+
+    /**
+     * Renders into offscreen images of the given size instead of a window.
+     * No window or surface is created so this works without a display, including on
+     * software implementations such as lavapipe. Input is unavailable in this mode.
+     * NOTE: This needs to be set before initialization
+     */
+    void setHeadless(uint32_t width, uint32_t height);
+
+    bool isHeadless() const { return headlessExtent.has_value(); }
+
+    /**
+     * The offscreen image rendered into for the given swap chain image.
+     * Only available in headless mode. Images are left in the transfer source layout.
+     */
+    const std::shared_ptr<Image> &getHeadlessTarget(uint32_t imageIndex) const;
+
     bool beginFrame();
 
     void render();
@@ -46,6 +91,34 @@ public:
 
     void setScene(const std::shared_ptr<Scene> &);
 
+    /**
+     * By default, transform changes are collected and applied to the scene once per frame.
+     * Eager updates apply each change to the entity and its descendants immediately,
+     * which is only useful when world transforms need to be visible mid frame.
+     */
+    void setEagerTransformUpdates(bool eager);
+    /**
+     * GPU driven rendering culls the scene against the camera in a compute pass and draws
+     * the geometry indirectly from its results, removing the per object work from the CPU.
+     * Devices without the drawIndirectFirstInstance feature keep culling on the CPU.
+     */
+    void setGpuDrivenRendering(bool enabled);
+    /**
+     * Clustered lighting sorts the lights into clusters of the view in a compute pass and
+     * shades them all in one full screen pass, so each pixel only pays for the lights near it.
+     */
+    void setClusteredLighting(bool enabled);
+    /**
+     * The depth pre-pass draws the scene's depth alone before the G-buffer is written, so each
+     * pixel of the G-buffer is only written once. This costs drawing the geometry twice.
+     */
+    void setDepthPrepass(bool enabled);
+    /**
+     * Below full resolution, point and spot lights are shaded into a smaller target which is then
+     * upsampled, following depth and normal edges. Trades some lighting detail for far less fill.
+     */
+    void setLightingResolution(LightingResolution resolution);
+
     const std::shared_ptr<Scene> &getScene() const { return currentScene; }
 
     // void reinitializeSwapChain();
@@ -189,14 +262,28 @@ public:
 
     vk::DescriptorBufferInfo getCameraDBI(uint32_t imageIndex);
 
+    /**
+     * How many binds the scene and gui recording issued and how many were skipped as redundant in the last frame
+     */
+    CommandStateStats getCommandStats() const;
+    /**
+     * The work done by the depth pre-pass in the last frame, when it is enabled.
+     * With GPU driven rendering the triangles are counted before culling.
+     */
+    DepthPrepassStats getDepthPrepassStats() const;
+    /**
+     * How many instances passed culling in a recent frame when GPU driven rendering is enabled
+     */
+    uint32_t getGpuVisibleInstances() const;
+
 protected:
 
 
 private:
-    GLFWwindow *window;
+    GLFWwindow *window { nullptr };
     vk::Instance instance;
     vk::PhysicalDevice physicalDevice;
-    VkSurfaceKHR surface;
+    VkSurfaceKHR surface { VK_NULL_HANDLE };
     std::unique_ptr<VulkanDevice> device;
 
     std::unique_ptr<SwapChain> swapChain;
@@ -208,16 +295,16 @@ private:
     struct {
         vk::RenderPass renderPass;
         std::vector<vk::Framebuffer> framebuffers;
-        vk::CommandBuffer commandBuffer;
+        std::vector<vk::CommandBuffer> commandBuffers;
     } layerMain;
 
     struct {
         vk::RenderPass renderPass;
         std::vector<vk::Framebuffer> framebuffers;
-        vk::CommandBuffer commandBuffer;
+        std::vector<vk::CommandBuffer> commandBuffers;
     } layerOverlay;
 
-    vk::CommandBuffer guiCommandBuffer;
+    std::vector<vk::CommandBuffer> guiCommandBuffers;
     std::vector<Buffer> uniformBuffers;
     std::unique_ptr<ExecutionController> executionController;
 
@@ -246,6 +333,13 @@ private:
 
 
     bool framebufferResized = false;
+    uint32_t framesInFlight = 2;
+    bool eagerTransformUpdates = false;
+    bool gpuDrivenRendering = false;
+    bool clusteredLighting = false;
+    bool depthPrepass = false;
+    LightingResolution lightingResolution = LightingResolution::Full;
+    std::optional<vk::Extent2D> headlessExtent;
 
     // void initializeVulkan(std::vector<const char *> extensions);
 
@@ -259,6 +353,8 @@ private:
 
     void recreateSwapChain();
 
+    void createHeadlessSwapChain();
+
     void createSurface();
 
     void createInstance();
@@ -308,8 +404,6 @@ private:
 
 template<typename VertexType>
 StaticMeshBuilder<VertexType> RenderEngine::createStaticMesh(const std::string &name) {
-    auto task = taskManager->createTask();
-
     return StaticMeshBuilder<VertexType>(
         *bufferManager,
         *taskManager,
@@ -8,6 +8,8 @@ class BufferManager;
 
 class Buffer;
 class DivisibleBuffer;
+class ReplicatedBuffer;
+class StagingBuffer;
 class ImageBuilder;
 
 class Image;
@@ -50,6 +52,7 @@ class Plane;
 class VulkanDevice;
 class Pipeline;
 class PipelineBuilder;
+class CommandState;
 class SwapChain;
 class ExecutionController;
 
@@ -64,6 +67,8 @@ class Effect;
 class Scene;
 class Entity;
 class Component;
+class MeshRenderer;
+class Light;
 
 // Gui
 namespace Gui {
@@ -3,8 +3,10 @@
 #include <vulkan/vulkan.hpp>
 
 #include "tech-core/forward.hpp"
+#include "tech-core/command_state.hpp"
 #include "common.hpp"
 
+#include <deque>
 #include <memory>
 #include <unordered_map>
 #include <limits>
@@ -48,7 +50,8 @@ public:
         Engine::TaskManager &taskManager,
         Engine::FontManager &fontManager,
         Engine::PipelineBuilder pipelineBuilder,
-        const vk::Extent2D &windowSize
+        const vk::Extent2D &windowSize,
+        uint32_t framesInFlight
     );
 
     void recreatePipeline(Engine::PipelineBuilder pipelineBuilder, const vk::Extent2D &windowSize);
@@ -61,10 +64,17 @@ public:
 
     void render(vk::CommandBuffer commandBuffer, vk::CommandBufferInheritanceInfo &cbInheritance);
 
+    /**
+     * Binds recorded and skipped by the last render()
+     */
+    const CommandStateStats &getCommandStats() const { return commandState.getStats(); }
+
 private:
     void renderComponent(BaseComponent *component, ComponentMapping &mapping);
     void markComponentDirty(uint16_t id);
     void processAnchors(BaseComponent *component);
+    void releaseRegion(const ComponentMapping::Region &region);
+    void retireReleasedRegions();
 
     // Provided
     vk::Device device;
@@ -73,6 +83,7 @@ private:
     Engine::TaskManager &taskManager;
     Engine::FontManager &fontManager;
     vk::Extent2D windowSize;
+    uint32_t framesInFlight;
 
     // resources
     std::unique_ptr<Engine::Pipeline> pipeline;
@@ -85,10 +96,13 @@ private:
     std::unordered_map<uint16_t, ComponentMapping> components;
     uint16_t nextId = 0;
     std::vector<uint16_t> dirtyComponents;
+    // Offsets of regions released during each update, oldest first. They are only freed once no frame can still read them
+    std::deque<std::vector<vk::DeviceSize>> releasedRegions;
 
     // For rendering
     std::unique_ptr<Engine::DivisibleBuffer> combinedVertexIndexBuffer;
     GuiPC viewState;
+    CommandState commandState;
 };
 
 }
\ No newline at end of file
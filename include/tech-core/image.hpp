@@ -65,6 +65,19 @@ public:
         vk::Extent2D extent, uint32_t layer = 0, uint32_t mipLevel = 0
     );
 
+    void transferIn(
+        vk::CommandBuffer commandBuffer, const StagingBuffer &source, uint32_t layer = 0, uint32_t mipLevel = 0
+    );
+    void transferIn(
+        vk::CommandBuffer commandBuffer, const StagingBuffer &source, vk::Offset2D offset, vk::Extent2D extent,
+        uint32_t layer = 0,
+        uint32_t mipLevel = 0
+    );
+    void transferInOffset(
+        vk::CommandBuffer commandBuffer, const StagingBuffer &source, vk::DeviceSize bufferOffset,
+        vk::Offset2D offset, vk::Extent2D extent, uint32_t layer = 0, uint32_t mipLevel = 0
+    );
+
     void transferOut(vk::CommandBuffer commandBuffer, Buffer *buffer, uint32_t layer = 0);
 
     void transition(
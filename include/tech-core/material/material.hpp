@@ -2,6 +2,7 @@
 
 #include "tech-core/forward.hpp"
 #include <glm/glm.hpp>
+#include <cstdint>
 #include <string>
 
 namespace Engine {
@@ -12,6 +13,11 @@ public:
 
     const std::string &getName() const { return name; }
 
+    /**
+     * Identifies the material when sorting draws. Unlike the material's address, it is never reused
+     */
+    uint32_t getSortId() const { return sortId; }
+
     const Texture *getAlbedo() const { return albedo; }
 
     const glm::vec4 &getAlbedoColor() const { return albedoColor; }
@@ -29,6 +35,7 @@ public:
     void setTextureOffset(const glm::vec2 &);
 private:
     const std::string name;
+    const uint32_t sortId;
 
     const Texture *albedo { nullptr };
     glm::vec4 albedoColor { 1, 1, 1, 1 };
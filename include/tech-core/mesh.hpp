@@ -4,8 +4,10 @@
 #include "forward.hpp"
 #include "tech-core/vertex.hpp"
 #include "tech-core/buffer.hpp"
+#include "tech-core/command_state.hpp"
 #include "tech-core/task.hpp"
 #include "tech-core/model.hpp"
+#include "tech-core/shapes/bounding_box.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -14,11 +16,28 @@
 #include <vulkan/vulkan.hpp>
 #include <vk_mem_alloc.h>
 #include <memory>
+#include <optional>
+#include <concepts>
 
 namespace Engine {
 
 #define VERTEX_ALIGN 4
 
+template<typename VertexType>
+concept HasVertexPosition = requires(const VertexType &vertex) {
+    { vertex.pos } -> std::convertible_to<glm::vec3>;
+};
+
+template<HasVertexPosition VertexType>
+BoundingBox computeVertexBounds(const VertexType *vertices, size_t count) {
+    BoundingBox bounds(vertices[0].pos, vertices[0].pos);
+    for (size_t i = 1; i < count; ++i) {
+        bounds.includeSelf(vertices[i].pos);
+    }
+
+    return bounds;
+}
+
 template<typename VertexType>
 class StaticMeshBuilder {
     friend class RenderEngine;
@@ -30,6 +49,10 @@ public:
     StaticMeshBuilder &fromModel(const std::string &path);
     StaticMeshBuilder &fromModel(const Model &model);
     StaticMeshBuilder &fromModel(const Model &model, const std::string &subModel);
+    /**
+     * Overrides the bounds of the mesh. If not provided, they are computed from the vertices
+     */
+    StaticMeshBuilder &withBounds(const BoundingBox &bounds);
 
     StaticMesh *build();
 
@@ -52,6 +75,7 @@ private:
     std::vector<uint16_t> indices16;
     size_t indexCount;
     vk::IndexType indexType;
+    std::optional<BoundingBox> bounds;
 };
 
 class Mesh {
@@ -62,6 +86,31 @@ public:
     virtual vk::IndexType getIndexType() const = 0;
 
     virtual void bind(vk::CommandBuffer commandBuffer) const = 0;
+    /**
+     * Binds the vertex and index buffers unless they are already bound
+     */
+    virtual void bind(CommandState &state) const = 0;
+
+    /**
+     * The bounds of the mesh in model space, or nullptr if they are not known.
+     */
+    virtual const BoundingBox *getBounds() const = 0;
+
+    /**
+     * Whether the bounds of this mesh may change after it has been created.
+     */
+    virtual bool hasDynamicBounds() const { return false; }
+
+    /**
+     * Identifies the mesh when sorting draws. Unlike the mesh's address, it is never reused
+     */
+    uint32_t getSortId() const { return sortId; }
+
+protected:
+    Mesh();
+
+private:
+    const uint32_t sortId;
 };
 
 class StaticMesh : public Mesh {
@@ -81,6 +130,11 @@ public:
     }
 
     virtual void bind(vk::CommandBuffer commandBuffer) const;
+    virtual void bind(CommandState &state) const;
+
+    virtual const BoundingBox *getBounds() const {
+        return bounds ? &*bounds : nullptr;
+    }
 
 private:
     StaticMesh(
@@ -89,7 +143,8 @@ private:
         vk::DeviceSize vertexOffset,
         vk::DeviceSize indexOffset,
         uint32_t indicesCount,
-        vk::IndexType indexType
+        vk::IndexType indexType,
+        const std::optional<BoundingBox> &bounds
     );
 
     BufferManager &bufferManager;
@@ -99,6 +154,7 @@ private:
     vk::DeviceSize indexOffset;
     const uint32_t indexCount;
     const vk::IndexType indexType;
+    const std::optional<BoundingBox> bounds;
 };
 
 template<typename VertexType>
@@ -180,6 +236,13 @@ public:
     }
 
     virtual void bind(vk::CommandBuffer commandBuffer) const override;
+    virtual void bind(CommandState &state) const override;
+
+    virtual const BoundingBox *getBounds() const override {
+        return bounds ? &*bounds : nullptr;
+    }
+
+    virtual bool hasDynamicBounds() const override { return true; }
 
 private:
     DynamicMesh(
@@ -207,6 +270,7 @@ private:
     vk::DeviceSize indexOffset;
     vk::DeviceSize totalCapacity;
     uint32_t indexCount;
+    std::optional<BoundingBox> bounds;
 
     // Reallocation Settings
     vk::DeviceSize vertexMaxCapacity;
@@ -275,12 +339,24 @@ StaticMeshBuilder<VertexType>::fromModel(const Model &model, const std::string &
     return *this;
 }
 
+template<typename VertexType>
+StaticMeshBuilder<VertexType> &StaticMeshBuilder<VertexType>::withBounds(const BoundingBox &bounds) {
+    this->bounds = bounds;
+    return *this;
+}
+
 template<typename VertexType>
 StaticMesh *StaticMeshBuilder<VertexType>::build() {
     if (indexCount == 0 || vertices.size() == 0 || indexType == vk::IndexType::eNoneNV) {
         throw std::runtime_error("Incomplete mesh definition");
     }
 
+    if constexpr (HasVertexPosition<VertexType>) {
+        if (!bounds) {
+            bounds = computeVertexBounds(vertices.data(), vertices.size());
+        }
+    }
+
     // Create a buffer to contain both the vertices and indices
     vk::DeviceSize vertexSize = sizeof(vertices[0]) * vertices.size();
     vk::DeviceSize indexSize;
@@ -313,13 +389,18 @@ StaticMesh *StaticMeshBuilder<VertexType>::build() {
         vk::MemoryUsage::eGPUOnly
     );
 
-    auto task = taskManager.createTask();
+    auto task = taskManager.createTransferTask();
 
     task->execute(
         [&, gpuBuffRef = gpuBuffer.get()](auto commandBuffer) {
             staging->transfer(commandBuffer, *gpuBuffRef);
         }
     );
+    task->releaseToGraphics(
+        *gpuBuffer,
+        vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead,
+        vk::PipelineStageFlagBits::eVertexInput
+    );
 
     task->freeWhenDone(std::move(staging));
     taskManager.submitTask(std::move(task));
@@ -331,7 +412,8 @@ StaticMesh *StaticMeshBuilder<VertexType>::build() {
             0,
             indexOffset,
             static_cast<uint32_t>(indexCount),
-            indexType
+            indexType,
+            bounds
         ));
 
     // Register with the engine
@@ -540,6 +622,14 @@ DynamicMesh<VertexType>::replaceAll(const std::vector<VertexType> &vertices, con
     staging->copyIn(vertices.data(), newVertexUsage);
     staging->copyIn(indices.data(), indexOffset, newIndexUsage);
 
+    // Earlier frames on this queue may still be reading the old contents
+    task->addMemoryBarrier(
+        vk::PipelineStageFlagBits::eVertexInput,
+        {},
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::AccessFlagBits::eTransferWrite
+    );
+
     task->execute(
         [&](vk::CommandBuffer commandBuffer) {
             staging->transfer(commandBuffer, *combinedBuffer, totalCapacity);
@@ -550,14 +640,22 @@ DynamicMesh<VertexType>::replaceAll(const std::vector<VertexType> &vertices, con
         vk::PipelineStageFlagBits::eTransfer,
         vk::AccessFlagBits::eTransferWrite,
         vk::PipelineStageFlagBits::eVertexInput,
-        vk::AccessFlagBits::eVertexAttributeRead
+        vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead
     );
 
-    auto fence = taskManager.submitTask(std::move(task));
-    bufferManager.release(staging, fence);
+    task->freeWhenDone(std::move(staging));
+    taskManager.submitTask(std::move(task));
 
     indexCount = indices.size();
 
+    if constexpr (HasVertexPosition<VertexType>) {
+        if (vertices.empty()) {
+            bounds.reset();
+        } else {
+            bounds = computeVertexBounds(vertices.data(), vertices.size());
+        }
+    }
+
     return true;
 }
 
@@ -581,14 +679,41 @@ DynamicMesh<VertexType>::replaceVertices(uint32_t srcOffset, uint32_t dstOffset,
 
     staging->copyIn(vertices, targetVertexSize);
 
+    // Earlier frames on this queue may still be reading the old contents
+    task->addMemoryBarrier(
+        vk::PipelineStageFlagBits::eVertexInput,
+        {},
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::AccessFlagBits::eTransferWrite
+    );
+
     task->execute(
         [&](auto commandBuffer) {
-            staging->transfer(commandBuffer, *combinedBuffer, targetOffset, targetVertexSize);
+            staging->transfer(commandBuffer, *combinedBuffer, 0, targetOffset, targetVertexSize);
         }
     );
 
-    auto fence = taskManager.submitTask(std::move(task));
-    bufferManager.release(staging, fence);
+    task->addMemoryBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::AccessFlagBits::eTransferWrite,
+        vk::PipelineStageFlagBits::eVertexInput,
+        vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead
+    );
+
+    task->freeWhenDone(std::move(staging));
+    taskManager.submitTask(std::move(task));
+
+    if constexpr (HasVertexPosition<VertexType>) {
+        // Old vertices may remain so the bounds can only grow here
+        if (count > 0) {
+            auto newBounds = computeVertexBounds(vertices, count);
+            if (bounds) {
+                bounds->includeSelf(newBounds);
+            } else {
+                bounds = newBounds;
+            }
+        }
+    }
 
     return true;
 }
@@ -613,14 +738,29 @@ DynamicMesh<VertexType>::replaceIndices(uint32_t srcOffset, uint32_t dstOffset,
 
     staging->copyIn(indices, targetIndexSize);
 
+    // Earlier frames on this queue may still be reading the old contents
+    task->addMemoryBarrier(
+        vk::PipelineStageFlagBits::eVertexInput,
+        {},
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::AccessFlagBits::eTransferWrite
+    );
+
     task->execute(
         [&](auto commandBuffer) {
-            staging->transfer(commandBuffer, *combinedBuffer, targetOffset, targetIndexSize);
+            staging->transfer(commandBuffer, *combinedBuffer, 0, targetOffset, targetIndexSize);
         }
     );
 
-    auto fence = taskManager.submitTask(std::move(task));
-    bufferManager.release(staging, fence);
+    task->addMemoryBarrier(
+        vk::PipelineStageFlagBits::eTransfer,
+        vk::AccessFlagBits::eTransferWrite,
+        vk::PipelineStageFlagBits::eVertexInput,
+        vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndexRead
+    );
+
+    task->freeWhenDone(std::move(staging));
+    taskManager.submitTask(std::move(task));
 
     return true;
 }
@@ -632,6 +772,12 @@ void DynamicMesh<VertexType>::bind(vk::CommandBuffer commandBuffer) const {
     commandBuffer.bindIndexBuffer(combinedBuffer->buffer(), indexOffset, getIndexType());
 }
 
+template<typename VertexType>
+void DynamicMesh<VertexType>::bind(CommandState &state) const {
+    state.bindVertexBuffer(0, combinedBuffer->buffer(), 0);
+    state.bindIndexBuffer(combinedBuffer->buffer(), indexOffset, getIndexType());
+}
+
 template<typename VertexType>
 void DynamicMesh<VertexType>::reallocate(vk::DeviceSize totalAllocationSize) {
     if (combinedBuffer) {
@@ -6,6 +6,7 @@
 
 #include <string>
 #include "common_includes.hpp"
+#include "command_state.hpp"
 #include <memory>
 #include <map>
 
@@ -87,6 +88,13 @@ public:
     PipelineBuilder &withDescriptorSet(vk::DescriptorSetLayout ds);
     PipelineBuilder &withoutDepthWrite();
     PipelineBuilder &withoutDepthTest();
+    PipelineBuilder &withDepthCompare(vk::CompareOp);
+    /**
+     * Discards fragments where the existing depth is outside of the bounds.
+     * The bounds are dynamic state, set with vk::CommandBuffer::setDepthBounds().
+     * Requires VulkanDevice::supportsDepthBounds
+     */
+    PipelineBuilder &withDepthBoundsTest();
     PipelineBuilder &withVertexBindingDescription(const vk::VertexInputBindingDescription &);
     PipelineBuilder &withVertexBindingDescriptions(const vk::ArrayProxy<const vk::VertexInputBindingDescription> &);
     PipelineBuilder &withVertexAttributeDescription(const vk::VertexInputAttributeDescription &);
@@ -100,7 +108,9 @@ public:
     PipelineBuilder &withAlphaBlend(vk::BlendOp op, vk::BlendFactor source, vk::BlendFactor dest);
     PipelineBuilder &withColorMask(const vk::ColorComponentFlags &);
 
-    PipelineBuilder &bindCamera(uint32_t set, uint32_t binding);
+    PipelineBuilder &bindCamera(
+        uint32_t set, uint32_t binding, const vk::ShaderStageFlags &stages = vk::ShaderStageFlagBits::eVertex
+    );
     PipelineBuilder &bindTextures(uint32_t set, uint32_t binding);
     PipelineBuilder &bindMaterial(uint32_t set, uint32_t binding, MaterialBindPoint);
     PipelineBuilder &bindSampledImage(
@@ -151,6 +161,13 @@ public:
         uint32_t set, uint32_t binding, std::shared_ptr<Buffer> buffer,
         const vk::ShaderStageFlags &stages = vk::ShaderStageFlagBits::eVertex
     );
+    /**
+     * A storage buffer with a separate descriptor for each swap chain image.
+     * The buffers are provided with Pipeline::bindBuffer(set, binding, index, buffer)
+     */
+    PipelineBuilder &bindStorageBufferPerImage(
+        uint32_t set, uint32_t binding, const vk::ShaderStageFlags &stages = vk::ShaderStageFlagBits::eVertex
+    );
     PipelineBuilder &bindSampledImagePool(
         uint32_t set, uint32_t binding, uint32_t size,
         const vk::ShaderStageFlags &stages = vk::ShaderStageFlagBits::eFragment,
@@ -194,6 +211,8 @@ private:
     std::vector<vk::DynamicState> dynamicState;
     bool depthTestEnable;
     bool depthWriteEnable;
+    vk::CompareOp depthCompareOp { vk::CompareOp::eLess };
+    bool depthBoundsTestEnable { false };
     std::vector<vk::VertexInputBindingDescription> vertexBindings;
     std::vector<vk::VertexInputAttributeDescription> vertexAttributes;
     bool cullFaces;
@@ -266,13 +285,24 @@ public:
     void bindImage(uint32_t set, uint32_t binding, const std::shared_ptr<Image> &image);
     void bindImage(uint32_t set, uint32_t binding, const std::shared_ptr<Image> &image, vk::Sampler sampler);
     void bindBuffer(uint32_t set, uint32_t binding, const std::shared_ptr<Buffer> &buffer);
+    /**
+     * Points the descriptor for one swap chain image at the buffer. Applied on the next bind().
+     * The buffer must outlive its use by the pipeline
+     */
+    void bindBuffer(uint32_t set, uint32_t binding, uint32_t index, const Buffer &buffer);
 
     void bindCamera(uint32_t set, uint32_t binding, RenderEngine &);
 
     void bind(vk::CommandBuffer, uint32_t activeImage = 0);
+    /**
+     * As bind(vk::CommandBuffer, uint32_t) but skips anything already bound in the command buffer
+     */
+    void bind(CommandState &, uint32_t activeImage = 0);
 
     void bindTexture(vk::CommandBuffer, uint32_t set, const Texture *);
+    void bindTexture(CommandState &, uint32_t set, const Texture *);
     void bindMaterial(vk::CommandBuffer, const Material *);
+    void bindMaterial(CommandState &, const Material *);
 
     void bindPoolImage(vk::CommandBuffer commandBuffer, uint32_t set, uint32_t binding, uint32_t index);
     void updatePoolImage(uint32_t set, uint32_t binding, uint32_t index, const Image &image);
@@ -285,6 +315,11 @@ public:
         uint32_t descriptorSetCount, const vk::DescriptorSet *descriptorSets,
         uint32_t dynamicOffsetCount, const uint32_t *dynamicOffsets
     );
+    void bindDescriptorSets(
+        CommandState &state, uint32_t firstSet,
+        uint32_t descriptorSetCount, const vk::DescriptorSet *descriptorSets,
+        uint32_t dynamicOffsetCount, const uint32_t *dynamicOffsets
+    );
 
     template<typename T>
     void push(
@@ -293,6 +328,13 @@ public:
         const T &constantData,
         uint32_t offset = 0
     );
+    template<typename T>
+    void push(
+        CommandState &state,
+        vk::ShaderStageFlags stage,
+        const T &constantData,
+        uint32_t offset = 0
+    );
 
 private:
     Pipeline(
@@ -317,6 +359,9 @@ private:
     // Material Bindings
     std::optional<uint32_t> bindingMaterialAlbedo {};
     std::optional<uint32_t> bindingMaterialNormal {};
+
+    void flushDescriptorUpdates();
+    vk::DescriptorSet getAutoBindSet(uint32_t set, uint32_t activeImage) const;
 };
 
 template<typename T>
@@ -384,6 +429,21 @@ void Pipeline::push(
     );
 }
 
+template<typename T>
+void Pipeline::push(
+    CommandState &state,
+    vk::ShaderStageFlags stage,
+    const T &constantData,
+    uint32_t offset
+) {
+    state.pushConstants(
+        resources.layout,
+        stage,
+        offset,
+        sizeof(T), &constantData
+    );
+}
+
 }
 
 #endif
\ No newline at end of file
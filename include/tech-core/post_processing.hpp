@@ -4,6 +4,7 @@
 #include "common_includes.hpp"
 #include "pipeline.hpp"
 #include <memory>
+#include <vector>
 
 namespace Engine {
 
@@ -82,17 +83,20 @@ public:
         uint32_t offset = 0
     );
 
-    void fillFrameCommands();
+    void fillFrameCommands(uint32_t activeImage);
     void onSwapChainRecreate(vk::RenderPass, vk::Extent2D windowSize, uint32_t subpass);
-    void applyCommandBuffer(vk::CommandBuffer);
+    /**
+     * Provides the command buffers to record into, one per swap chain image
+     */
+    void applyCommandBuffers(const std::vector<vk::CommandBuffer> &);
 
-    vk::CommandBuffer &getCommandBuffer() { return buffer; }
+    vk::CommandBuffer getCommandBuffer(uint32_t activeImage) const { return buffers[activeImage]; }
 
 private:
     std::string name;
     PipelineBuilder pipelineBuilder;
     std::unique_ptr<Pipeline> pipeline;
-    vk::CommandBuffer buffer;
+    std::vector<vk::CommandBuffer> buffers;
 
     Effect(std::string name, PipelineBuilder pipelineBuilder);
 };
@@ -10,6 +10,10 @@ public:
     explicit Component(Entity &owner)
         : owner(owner) {};
 
+    // Declaring the destructor would otherwise leave components copied when their pool moves them
+    Component(const Component &) = default;
+    Component(Component &&) = default;
+
     virtual ~Component() = default;
 protected:
     Entity &owner;
@@ -19,6 +19,10 @@ public:
     void setRange(float);
     void setIntensity(float);
     void setColor(const glm::vec3 &);
+    /**
+     * The angle in degrees between a spot light's direction and the edge of its cone
+     */
+    void setSpotAngle(float);
 
     LightType getType() const { return type; }
 
@@ -28,11 +32,14 @@ public:
 
     const glm::vec3 &getColor() const { return color; }
 
+    float getSpotAngle() const { return spotAngle; }
+
 private:
     LightType type { LightType::Directional };
     float range { 10 };
     float intensity { 1 };
     glm::vec3 color { 1, 1, 1 };
+    float spotAngle { 45 };
 };
 
 }
\ No newline at end of file
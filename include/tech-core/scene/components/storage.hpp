@@ -0,0 +1,127 @@
+#pragma once
+
+#include "base.hpp"
+#include "tech-core/forward.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace Engine::Internal {
+
+typedef uint32_t ComponentTypeId;
+
+const uint32_t MaxComponentTypes = 32;
+const uint32_t NoComponentSlot = std::numeric_limits<uint32_t>::max();
+
+class ComponentPoolBase {
+public:
+    virtual ~ComponentPoolBase() = default;
+
+    virtual void erase(uint32_t slot) = 0;
+};
+
+/**
+ * Hands out the next unused component type id and remembers the pool for it.
+ */
+ComponentTypeId registerComponentType(ComponentPoolBase *pool);
+
+ComponentPoolBase *getComponentPool(ComponentTypeId);
+
+/**
+ * Called when a component is moved within its pool
+ */
+void updateComponentSlot(Entity *owner, ComponentTypeId, uint32_t slot);
+
+/**
+ * Dense storage for every component of one type.
+ * Components are kept in fixed size pages so that adding never moves existing components.
+ * Erasing moves the last component into the hole to keep the storage packed.
+ * Pools are never destroyed. Entities may be held in statics or shared pointers that are
+ * released during exit, in any order, and each one erases its components from the pool.
+ */
+template<IsComponent T>
+class ComponentPool final : public ComponentPoolBase {
+public:
+    static ComponentPool<T> &instance() {
+        // Intentionally leaked so that it outlives every entity, see above
+        static auto *pool = new ComponentPool<T>();
+        return *pool;
+    }
+
+    ComponentPool(const ComponentPool &) = delete;
+    ComponentPool &operator=(const ComponentPool &) = delete;
+
+    ComponentTypeId getTypeId() const { return typeId; }
+
+    uint32_t size() const { return count; }
+
+    T &at(uint32_t slot) { return *address(slot); }
+
+    Entity &ownerAt(uint32_t slot) const { return *owners[slot]; }
+
+    template<typename... Args>
+    uint32_t emplace(Entity &owner, Args &&...args) {
+        auto slot = count;
+        if (slot / PageSize >= pages.size()) {
+            pages.push_back(std::make_unique<Page>());
+        }
+
+        std::construct_at(address(slot), owner, std::forward<Args>(args)...);
+        owners.push_back(&owner);
+        ++count;
+
+        return slot;
+    }
+
+    void erase(uint32_t slot) override {
+        auto last = count - 1;
+        std::destroy_at(address(slot));
+
+        if (slot != last) {
+            std::construct_at(address(slot), std::move(*address(last)));
+            std::destroy_at(address(last));
+            owners[slot] = owners[last];
+            updateComponentSlot(owners[slot], typeId, slot);
+        }
+
+        owners.pop_back();
+        --count;
+    }
+
+private:
+    static constexpr uint32_t PageSize = 256;
+
+    struct Page {
+        alignas(T) std::byte data[sizeof(T) * PageSize];
+    };
+
+    // State
+    const ComponentTypeId typeId;
+    std::vector<std::unique_ptr<Page>> pages;
+    std::vector<Entity *> owners;
+    uint32_t count { 0 };
+
+    ComponentPool()
+        : typeId(registerComponentType(this)) {}
+
+    T *address(uint32_t slot) const {
+        auto &page = *pages[slot / PageSize];
+        return std::launder(reinterpret_cast<T *>(page.data + (slot % PageSize) * sizeof(T)));
+    }
+};
+
+/**
+ * Identifies a component type without RTTI. Ids are small and dense so they index arrays directly.
+ */
+template<IsComponent T>
+ComponentTypeId getComponentTypeId() {
+    static const ComponentTypeId id = ComponentPool<T>::instance().getTypeId();
+    return id;
+}
+
+}
@@ -16,7 +16,16 @@ public:
 
     const glm::vec3 &getScale() const { return scale; };
 
-    const glm::mat4 &getTransform() const { return transform; }
+    /**
+     * The combined transformation matrix. This is only rebuilt when requested.
+     */
+    const glm::mat4 &getTransform() const;
+
+    /**
+     * Whether the matrix was set directly with setTransform() rather than being built
+     * from the position, rotation and scale
+     */
+    bool hasMatrixOverride() const { return matrixOverride; }
 
     void setPosition(const glm::vec3 &);
     void setRotation(const glm::quat &);
@@ -31,7 +40,9 @@ private:
     glm::quat rotation {};
     glm::vec3 scale { 1, 1, 1 };
     // Combined transformation matrix
-    glm::mat4 transform { 1 };
+    mutable glm::mat4 transform { 1 };
+    mutable bool transformDirty { true };
+    bool matrixOverride { false };
 
     void updateTransform();
 };
@@ -1,17 +1,18 @@
 #pragma once
 
 #include "components/base.hpp"
+#include "components/storage.hpp"
 #include "../forward.hpp"
 #include "../types.hpp"
 #include "scene.hpp"
 #include "components/transform.hpp"
 
+#include <array>
 #include <memory>
 #include <vector>
-#include <memory>
-#include <unordered_map>
 #include <cassert>
 #include <functional>
+#include <utility>
 
 namespace Engine {
 
@@ -37,8 +38,12 @@ public:
     const Transform &getTransform() const { return transform; }
 
     template<IsComponent T>
-    bool has();
+    bool has() const;
 
+    /**
+     * Components of a type are stored packed together. The reference is invalidated when any
+     * entity removes a component of the same type, as the last one is moved into its place.
+     */
     template<IsComponent T>
     T &get();
 
@@ -46,11 +51,23 @@ public:
     const T &get() const;
 
     template<IsComponent T, typename... Args>
-    T &add(Args ...args);
+    T &add(Args &&...args);
 
+    /**
+     * Moves the last component of the type into the removed one's place, invalidating any
+     * reference to that component held for another entity.
+     */
     template<IsComponent T>
     void remove();
 
+    /**
+     * Calls the callback for every entity which has all of the given components.
+     * The storage of the first component is walked in order so it should be the least common one.
+     * Components of the first type must not be added or removed during the iteration.
+     */
+    template<IsComponent T, IsComponent... With, typename Callback>
+    static void forEachWith(Callback &&callback);
+
     Entity *getParent() const { return parent; };
 
     Scene *getScene() const { return scene; }
@@ -75,46 +92,64 @@ private:
     std::vector<std::shared_ptr<Entity>> children;
 
     Transform transform;
-    std::unordered_map<size_t, std::unique_ptr<Component>> components;
+    // Slot within each component pool indexed by component type id
+    std::array<uint32_t, Internal::MaxComponentTypes> componentSlots;
 
     void invalidateComponentAdd();
     void invalidateComponentRemove();
+
+    friend void Internal::updateComponentSlot(Entity *, Internal::ComponentTypeId, uint32_t);
 };
 
 template<IsComponent T>
 T &Entity::get() {
-    auto it = components.find(typeid(T).hash_code());
-    assert(it != components.end());
-    return static_cast<T &>(*it->second);
+    auto slot = componentSlots[Internal::getComponentTypeId<T>()];
+    assert(slot != Internal::NoComponentSlot);
+    return Internal::ComponentPool<T>::instance().at(slot);
 }
 
 template<IsComponent T>
 const T &Entity::get() const {
-    auto it = components.find(typeid(T).hash_code());
-    assert(it != components.end());
-    return static_cast<T &>(*it->second);
+    auto slot = componentSlots[Internal::getComponentTypeId<T>()];
+    assert(slot != Internal::NoComponentSlot);
+    return Internal::ComponentPool<T>::instance().at(slot);
 }
 
 template<IsComponent T>
-bool Entity::has() {
-    auto it = components.find(typeid(T).hash_code());
-    return it != components.end();
+bool Entity::has() const {
+    return componentSlots[Internal::getComponentTypeId<T>()] != Internal::NoComponentSlot;
 }
 
 template<IsComponent T, typename... Args>
-T &Entity::add(Args... args) {
-    auto it = components.emplace(typeid(T).hash_code(), std::make_unique<T>(*this, args...));
-    assert(it.second);
+T &Entity::add(Args &&...args) {
+    auto &slot = componentSlots[Internal::getComponentTypeId<T>()];
+    assert(slot == Internal::NoComponentSlot);
+
+    auto &pool = Internal::ComponentPool<T>::instance();
+    slot = pool.emplace(*this, std::forward<Args>(args)...);
     invalidateComponentAdd();
-    return static_cast<T &>(*it.first->second);
+    return pool.at(componentSlots[pool.getTypeId()]);
 }
 
 template<IsComponent T>
 void Entity::remove() {
-    auto it = components.find(typeid(T).hash_code());
-    assert(it != components.end());
+    auto &slot = componentSlots[Internal::getComponentTypeId<T>()];
+    assert(slot != Internal::NoComponentSlot);
+
+    Internal::ComponentPool<T>::instance().erase(slot);
+    slot = Internal::NoComponentSlot;
     invalidateComponentRemove();
-    components.erase(it);
+}
+
+template<IsComponent T, IsComponent... With, typename Callback>
+void Entity::forEachWith(Callback &&callback) {
+    auto &pool = Internal::ComponentPool<T>::instance();
+    for (uint32_t slot = 0; slot < pool.size(); ++slot) {
+        Entity &entity = pool.ownerAt(slot);
+        if ((entity.has<With>() && ...)) {
+            callback(entity, pool.at(slot), entity.get<With>()...);
+        }
+    }
 }
 
 namespace Internal {
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <vulkan/vulkan.hpp>
+
+#include <array>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#define ALLOCATION_FAILED std::numeric_limits<vk::DeviceSize>::max()
+
+namespace Engine {
+
+struct SectionAllocatorStats {
+    vk::DeviceSize totalSize { 0 };
+    vk::DeviceSize usedSize { 0 };
+    vk::DeviceSize freeSize { 0 };
+    vk::DeviceSize largestFreeBlock { 0 };
+    uint32_t allocationCount { 0 };
+    uint32_t freeBlockCount { 0 };
+
+    /**
+     * The fraction of the space that is allocated
+     */
+    float occupancy() const {
+        return totalSize == 0 ? 0 : static_cast<float>(usedSize) / static_cast<float>(totalSize);
+    }
+
+    /**
+     * 0 when all free space is in one block, approaching 1 as the free space is split up
+     */
+    float fragmentation() const {
+        return freeSize == 0 ? 0 : 1.0f - static_cast<float>(largestFreeBlock) / static_cast<float>(freeSize);
+    }
+};
+
+/**
+ * Sub-allocates ranges out of a fixed size region using a two level segregated fit.
+ * Both allocating and freeing are constant time. The region itself is never touched
+ * so this can be used to manage GPU memory.
+ */
+class SectionAllocator {
+public:
+    explicit SectionAllocator(vk::DeviceSize size = 0);
+
+    /**
+     * Discards all allocations and starts again with the given size
+     */
+    void reset(vk::DeviceSize size);
+
+    /**
+     * Allocates a range.
+     * @param alignment The required alignment of the offset. Must be a power of 2
+     * @returns The offset of the range. Returns ALLOCATION_FAILED if allocation failed
+     */
+    vk::DeviceSize allocate(vk::DeviceSize size, vk::DeviceSize alignment = 1);
+
+    /**
+     * Releases a range previously returned by allocate()
+     */
+    void free(vk::DeviceSize offset);
+
+    SectionAllocatorStats getStats() const;
+
+private:
+    static constexpr uint32_t SubdivisionLog2 = 4;
+    static constexpr uint32_t SubdivisionCount = 1 << SubdivisionLog2;
+    static constexpr uint32_t FirstLevelCount = 64 - SubdivisionLog2 + 1;
+    static constexpr uint32_t NoBlock = std::numeric_limits<uint32_t>::max();
+
+    struct Block {
+        vk::DeviceSize offset;
+        vk::DeviceSize size;
+
+        uint32_t prevPhysical;
+        uint32_t nextPhysical;
+
+        uint32_t prevFree;
+        uint32_t nextFree;
+
+        bool isFree;
+    };
+
+    // State
+    vk::DeviceSize totalSize { 0 };
+    vk::DeviceSize usedSize { 0 };
+    uint32_t freeBlockCount { 0 };
+
+    std::vector<Block> blocks;
+    std::vector<uint32_t> unusedBlocks;
+    std::unordered_map<vk::DeviceSize, uint32_t> allocatedBlocks;
+
+    uint64_t firstLevelMap { 0 };
+    std::array<uint32_t, FirstLevelCount> secondLevelMap {};
+    std::array<uint32_t, FirstLevelCount * SubdivisionCount> freeLists {};
+
+    static void mapping(vk::DeviceSize size, uint32_t &firstLevel, uint32_t &secondLevel);
+    static bool mappingSearch(vk::DeviceSize size, uint32_t &firstLevel, uint32_t &secondLevel);
+
+    uint32_t findFreeBlock(uint32_t &firstLevel, uint32_t &secondLevel) const;
+    uint32_t findAlignedBlock(vk::DeviceSize size, vk::DeviceSize alignment) const;
+    uint32_t findFittingBlock(vk::DeviceSize size, vk::DeviceSize alignment) const;
+
+    uint32_t createBlock(vk::DeviceSize offset, vk::DeviceSize size);
+    void releaseBlock(uint32_t block);
+
+    void insertFree(uint32_t block);
+    void removeFree(uint32_t block);
+
+    void splitAfter(uint32_t block, vk::DeviceSize size);
+    uint32_t splitBefore(uint32_t block, vk::DeviceSize size);
+    uint32_t merge(uint32_t first, uint32_t second);
+};
+
+}
@@ -2,12 +2,36 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_access.hpp>
+#include <cstddef>
+#include <cstdint>
 
 namespace Engine {
 
 // Forward
 class Plane;
 
+/**
+ * Axis aligned boxes stored as one array per component
+ */
+struct BoxArrays {
+    const float *xMin;
+    const float *yMin;
+    const float *zMin;
+    const float *xMax;
+    const float *yMax;
+    const float *zMax;
+};
+
+/**
+ * Spheres stored as one array per component
+ */
+struct SphereArrays {
+    const float *x;
+    const float *y;
+    const float *z;
+    const float *radius;
+};
+
 class Frustum {
 public:
 
@@ -44,6 +68,37 @@ public:
         return true;
     }
 
+    /**
+     * Checks if the box lies entirely within the frustum.
+     * Only the corner furthest behind each plane needs to be checked.
+     */
+    inline bool contains(const glm::vec3 &minPoint, const glm::vec3 &maxPoint) const {
+        for (int i = 0; i < 6; i++) {
+            float x = (planes[i].x > 0) ? minPoint.x : maxPoint.x;
+            float y = (planes[i].y > 0) ? minPoint.y : maxPoint.y;
+            float z = (planes[i].z > 0) ? minPoint.z : maxPoint.z;
+
+            if (planes[i].x * x + planes[i].y * y + planes[i].z * z + planes[i].w <= 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Tests many boxes at once. Gives the same result as calling intersects() on each box.
+     * Bit (i % 64) of visibility[i / 64] is set when box i is at least partly inside.
+     * @param visibility Must have room for (count + 63) / 64 words
+     */
+    void intersects(const BoxArrays &boxes, size_t count, uint64_t *visibility) const;
+
+    /**
+     * Tests many spheres at once.
+     * Bit (i % 64) of visibility[i / 64] is set when sphere i is at least partly inside.
+     * @param visibility Must have room for (count + 63) / 64 words
+     */
+    void intersects(const SphereArrays &spheres, size_t count, uint64_t *visibility) const;
+
     Plane planeLeft() const;
     Plane planeRight() const;
     Plane planeTop() const;
@@ -51,6 +106,11 @@ public:
     Plane planeFar() const;
     Plane planeNear() const;
 
+    /**
+     * The six planes as (normal, distance). Points in front of all of them are inside.
+     */
+    const glm::vec4 *getPlanes() const { return planes; }
+
 private:
     glm::vec4 planes[6];
 };
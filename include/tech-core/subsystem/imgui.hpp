@@ -35,6 +35,8 @@ private:
 
     RenderEngine *engine;
     vk::Device device;
+    // Headless engines have no window so the display is set up by hand
+    bool hasWindow { false };
 
     std::unique_ptr<Pipeline> pipeline;
     vk::Sampler fontSampler;
@@ -2,19 +2,53 @@
 
 #include "forward.hpp"
 #include <vulkan/vulkan.hpp>
+#include <memory>
+#include <vector>
 
 namespace Engine {
 
 class SwapChain {
 public:
     SwapChain(vk::PhysicalDevice physicalDevice, VulkanDevice &device, vk::SurfaceKHR surface, vk::Extent2D size);
+    /**
+     * Creates a headless swap chain that renders into the offscreen targets instead of presenting
+     */
+    SwapChain(VulkanDevice &device, std::vector<std::shared_ptr<Image>> targets);
     ~SwapChain();
 
+    /**
+     * Recreates the swap chain for the new window size.
+     * Headless swap chains keep their offscreen targets so this does nothing.
+     */
     void rebuild(vk::Extent2D windowExtent);
     void cleanup();
 
     size_t size() const { return images.size(); }
 
+    bool isHeadless() const { return !surface; }
+
+    /**
+     * The layout images are left in once the frame is complete
+     */
+    vk::ImageLayout getFinalLayout() const;
+
+    /**
+     * Acquires the next image to render into.
+     * @param available Signalled once the image can be rendered into
+     * @throws vk::OutOfDateKHRError if the swap chain must be rebuilt
+     */
+    uint32_t acquire(vk::Semaphore available);
+    /**
+     * Presents the image once rendering has finished.
+     * Headless swap chains have nothing to present so this only waits on the semaphore.
+     */
+    vk::Result present(uint32_t imageIndex, vk::Semaphore renderFinished);
+
+    /**
+     * The offscreen image for a headless swap chain
+     */
+    const std::shared_ptr<Image> &getTarget(uint32_t imageIndex) const { return targets[imageIndex]; }
+
     vk::SwapchainKHR swapChain;
     vk::Extent2D extent;
     std::vector<vk::Image> images;
@@ -31,6 +65,10 @@ private:
     std::vector<vk::SurfaceFormatKHR> formats;
     std::vector<vk::PresentModeKHR> presentModes;
 
+    // Headless
+    std::vector<std::shared_ptr<Image>> targets;
+    uint32_t nextTarget { 0 };
+
     void setup(vk::Extent2D desiredExtent);
 };
 
@@ -1,49 +1,132 @@
 #pragma once
 
 #include "forward.hpp"
+#include "device.hpp"
 #include <vulkan/vulkan.hpp>
 
 #include <functional>
 #include <deque>
 #include <memory>
+#include <optional>
+#include <vector>
 
 namespace Engine {
 
 // Forward declarations
 class Task;
 
+/**
+ * Resources handed from the transfer queue to the graphics queue.
+ * The acquire barriers must be recorded on the graphics queue after waiting on the timeline point.
+ */
+struct QueueHandOff {
+    TimelinePoint point;
+    vk::PipelineStageFlags stages;
+    std::vector<vk::BufferMemoryBarrier> bufferBarriers;
+    std::vector<vk::ImageMemoryBarrier> imageBarriers;
+};
+
 class TaskManager {
     friend class RenderEngine;
+    friend class Task;
 public:
     explicit TaskManager(VulkanDevice &device);
+    ~TaskManager();
+
     std::unique_ptr<Task> createTask();
+    /**
+     * Creates a task which runs on the transfer queue so that uploads do not hold up rendering.
+     * Anything written by the task must be passed on with Task::releaseToGraphics()
+     * before it is used for rendering.
+     */
+    std::unique_ptr<Task> createTransferTask();
 
     /**
      * Submits a task to be executed.
-     * This is a non-blocking submission.
+     * This is a non-blocking submission. Tasks are recorded into a shared command buffer
+     * for their queue which is submitted once per frame, before the frame itself.
      * Use Task::executeWhenComplete to run code after
-     * the task is finished
+     * the task is finished.
+     * @returns The point reached once the task is complete. Other tasks, compute tasks
+     *          and frames may wait on this.
      */
-    vk::Fence submitTask(std::unique_ptr<Task> task);
+    TimelinePoint submitTask(std::unique_ptr<Task> task);
 
 private:
+    // All tasks recorded into one command buffer and submitted together
+    struct Batch {
+        vk::CommandBuffer commandBuffer;
+        TimelinePoint completion;
+        std::vector<std::unique_ptr<Task>> tasks;
+        std::vector<TimelineWait> waits;
+
+        // Transfer queue releases are recorded together at the end
+        std::vector<vk::BufferMemoryBarrier> releaseBufferBarriers;
+        std::vector<vk::ImageMemoryBarrier> releaseImageBarriers;
+        QueueHandOff handOff;
+
+        // Tasks created from this batch but not yet submitted
+        uint32_t openTasks { 0 };
+
+        // Kept from abandoned tasks as their commands were already recorded into the batch
+        std::vector<std::shared_ptr<Buffer>> abandonedBuffers;
+        std::vector<std::unique_ptr<StagingBuffer>> abandonedStaging;
+    };
+
+    struct TaskQueue {
+        VulkanQueue *queue;
+        vk::CommandPool pool;
+        std::vector<vk::CommandBuffer> freeBuffers;
+        std::vector<vk::CommandBuffer> allBuffers;
+
+        std::optional<Batch> openBatch;
+        // In submission order
+        std::deque<Batch> submittedBatches;
+    };
+
     void processActions();
+    /**
+     * Submits the open batch of each queue.
+     * Must be called before any other submission that signals the graphics timeline.
+     */
+    void flush();
+    void flush(TaskQueue &queue);
+    void retireCompleted(TaskQueue &queue);
+
+    std::unique_ptr<Task> allocateTask(TaskQueue &queue, bool onTransferQueue);
+    /**
+     * Called when a task is destroyed without being submitted.
+     * Anything the task was holding is kept until the batch completes.
+     */
+    void abandon(Task &task);
+
+    /**
+     * Takes all resources released by the transfer queue since the last call.
+     * These must be acquired by the next graphics submission.
+     */
+    std::vector<QueueHandOff> takeHandOffs();
 
     // Provided fields
     VulkanDevice &device;
 
     // State
-    std::deque<std::unique_ptr<Task>> submittedTasks;
+    TaskQueue graphicsTasks;
+    TaskQueue transferTasks;
+    std::vector<QueueHandOff> pendingHandOffs;
 };
 
 /**
  * A task allows you to execute vulkan commands once-off.
  * Useful for executing buffer transfers.
+ * Commands are recorded straight into the batch for the queue so a task must be
+ * submitted before the next frame is drawn.
  */
 class Task {
     friend class TaskManager;
 
 public:
+    ~Task();
+
     /**
      * Executes some function in the context of the command buffer
      */
@@ -61,18 +144,52 @@ public:
 
     void freeWhenDone(const std::shared_ptr<Buffer> &buffer);
     void freeWhenDone(std::unique_ptr<Buffer> &&buffer);
+    void freeWhenDone(std::unique_ptr<StagingBuffer> &&buffer);
+
+    /**
+     * Prevents the given stages of this task, and the rest of its batch, from running until the point is reached.
+     * The point may be from any queue.
+     */
+    void waitFor(const TimelinePoint &point, const vk::PipelineStageFlags &stages);
+
+    /**
+     * Makes a buffer written by this task available to the graphics queue.
+     * For transfer tasks this releases ownership of the buffer, which is acquired again
+     * at the start of the next frame.
+     * @param dstAccess How the buffer will be accessed by rendering
+     * @param dstStages The stages that will access the buffer
+     */
+    void releaseToGraphics(
+        const Buffer &buffer, const vk::AccessFlags &dstAccess, const vk::PipelineStageFlags &dstStages
+    );
+    /**
+     * Makes an image written by this task available to the graphics queue and transitions it into the layout.
+     * For transfer tasks this releases ownership of the image, which is acquired again
+     * at the start of the next frame.
+     */
+    void releaseToGraphics(
+        Image &image, vk::ImageLayout layout, const vk::AccessFlags &dstAccess,
+        const vk::PipelineStageFlags &dstStages
+    );
 private:
-    Task(vk::UniqueCommandBuffer, vk::UniqueFence, TaskManager &);
+    Task(vk::CommandBuffer, const TimelinePoint &completion, TaskManager &, bool onTransferQueue);
 
     void executeFinishCallbacks();
 
     // Provided
-    vk::UniqueCommandBuffer commandBuffer;
-    vk::UniqueFence submitFence;
+    vk::CommandBuffer commandBuffer;
     TaskManager &taskManager;
+    const bool onTransferQueue;
 
     // State
+    TimelinePoint completion;
+    bool submitted { false };
+    std::vector<TimelineWait> waits;
+    std::vector<vk::BufferMemoryBarrier> releaseBufferBarriers;
+    std::vector<vk::ImageMemoryBarrier> releaseImageBarriers;
+    QueueHandOff handOff;
     std::vector<std::function<void()>> finishCallbacks;
     std::vector<std::shared_ptr<Buffer>> buffersToFree; // This will just be freed when the task is destroyed, which on be until submission is complete
+    std::vector<std::unique_ptr<StagingBuffer>> stagingToFree; // Returned to the staging ring when the task is destroyed
 };
 }
\ No newline at end of file
@@ -7,15 +7,14 @@
 //    vec2 offset;
 //};
 
-layout(location = 0) out vec4 outPosition;
-layout(location = 1) out vec4 outNormalRoughness;
-layout(location = 2) out vec4 outDiffuseOcclusion;
+// Position is rebuilt from depth when lighting
+layout(location = 0) out vec4 outNormalRoughness;
+layout(location = 1) out vec4 outDiffuseOcclusion;
 
 layout(location = 0) in vec4 fragColour;
 layout(location = 1) in vec3 fragNormal;
 layout(location = 2) in vec3 fragTangent;
 layout(location = 3) in vec2 fragTexCoord;
-layout(location = 4) in vec4 fragPosition;
 
 //
 //layout(set = 1, binding = 2) uniform TextureUbo {
@@ -36,11 +35,20 @@ vec3 computeNormal() {
     return normalize(tangentToWorldTransform * tangentNormal);
 }
 
+// Folds the unit normal onto an octahedron, then flattens it into 0 to 1
+vec2 encodeNormal(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    if (n.z < 0.0) {
+        vec2 signs = vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+        n.xy = (1.0 - abs(n.yx)) * signs;
+    }
+    return n.xy * 0.5 + 0.5;
+}
+
 void main() {
     vec4 color = texture(albedo, fragTexCoord) * fragColour;
     vec3 normal = computeNormal();
 
-    outPosition = fragPosition;
     outDiffuseOcclusion = vec4(color.rgb, 0);// TODO: Occlusion
-    outNormalRoughness = vec4(normal, 0);// TODO: Roughness
+    outNormalRoughness = vec4(encodeNormal(normal), 0, 0);// TODO: Roughness
 }
\ No newline at end of file
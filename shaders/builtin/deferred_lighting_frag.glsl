@@ -6,40 +6,135 @@
 #define LT_POINT 1
 #define LT_SPOT 2
 
+// Matches the cluster grid in deferred_pipeline.cpp
+const uint CLUSTERS_X = 16;
+const uint CLUSTERS_Y = 9;
+const uint CLUSTERS_Z = 24;
+const uint MAX_CLUSTER_LIGHTS = 63;
+
 const vec3 attenuation = vec3(0.02f, 0.01f, 0.04f);
 
-layout (input_attachment_index = 0, binding = 3) uniform subpassInput inPosition;
-layout (input_attachment_index = 1, binding = 4) uniform subpassInput inNormalRoughness;
-layout (input_attachment_index = 2, binding = 5) uniform subpassInput inDiffuseOcclusion;
-layout (input_attachment_index = 3, binding = 6) uniform subpassInput inDepth;
+// When set, every light is shaded in one pass using the light clusters instead of one light per draw
+layout (constant_id = 0) const bool CLUSTERED = false;
+
+layout (set = 0, binding = 0) uniform CameraUBO {
+    mat4 view;
+    mat4 proj;
+    mat4 inverseViewProj;
+} cam;
+
+layout (input_attachment_index = 0, binding = 4) uniform subpassInput inNormalRoughness;
+layout (input_attachment_index = 1, binding = 5) uniform subpassInput inDiffuseOcclusion;
+layout (input_attachment_index = 2, binding = 6) uniform subpassInput inDepth;
 
-layout (set = 1, binding = 2) uniform LightUBO {
+struct LightData {
     vec3 position;
     vec3 direction;
     vec3 color;
     float intensity;
     float range;
     uint type;
-} light;
+    float spotCosine;
+};
+
+struct Cluster {
+    uint lightCount;
+    uint lightSlots[MAX_CLUSTER_LIGHTS];
+};
+
+// Every light in the scene, indexed by its slot
+layout (std430, set = 1, binding = 2) readonly buffer LightSSBO {
+    LightData lights[];
+} scene;
+
+// The slots of the lights being drawn this frame, directional lights first
+layout (std430, set = 1, binding = 7) readonly buffer ActiveLightSSBO {
+    uint lightSlots[];
+} active;
+
+layout (std430, set = 1, binding = 8) readonly buffer ClusterSSBO {
+    Cluster clusters[];
+} grid;
+
+layout (push_constant) uniform LightPushConstants {
+    // Only used by the light volume vertex shader
+    mat4 volume;
+    uint lightSlot;
+    // The rest is only used when clustered
+    uint directionalCount;
+    float sliceScale;
+    float sliceBias;
+    // The size of a pixel in 0 to 1 screen coordinates
+    vec2 pixelSize;
+} push;
 
 layout(location = 0) out vec4 outColor;
 
+vec3 decodeNormal(vec2 encoded) {
+    encoded = encoded * 2.0 - 1.0;
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    // Unfold the lower half of the octahedron
+    float fold = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -fold : fold;
+    n.y += n.y >= 0.0 ? -fold : fold;
+    return normalize(n);
+}
+
+vec3 reconstructPosition(float depth) {
+    vec2 ndc = gl_FragCoord.xy * push.pixelSize * 2.0 - 1.0;
+    vec4 world = cam.inverseViewProj * vec4(ndc, depth, 1.0);
+    return world.xyz / world.w;
+}
+
+vec3 shade(LightData light, vec3 position, vec3 normal) {
+    if (light.type == LT_DIRECTIONAL) {
+        return light.color * max(dot(normal, -light.direction), 0);
+    }
+
+    vec3 toLight = light.position - position;
+    float distToLight = length(toLight);
+    vec3 lightDir = toLight / distToLight;
+
+    float atten = 1.0 / dot(vec3(1, distToLight, distToLight*distToLight), attenuation / light.range);
+    // Fade to nothing at the range so that nothing is lost by bounding the light with it
+    float window = clamp(1.0 - pow(distToLight / light.range, 4.0), 0.0, 1.0);
+    atten *= window * window;
+
+    if (light.type == LT_SPOT) {
+        float cosine = dot(-lightDir, light.direction);
+        atten *= smoothstep(light.spotCosine, mix(light.spotCosine, 1.0, 0.1), cosine);
+    }
+
+    return light.color * max(0.0, dot(normal, lightDir) * light.intensity * atten);
+}
+
 void main() {
-    vec4 position = subpassLoad(inPosition);
     vec4 normalRoughness = subpassLoad(inNormalRoughness);
     vec4 diffuseOcclusion = subpassLoad(inDiffuseOcclusion);
 
-    vec3 normal = normalize(normalRoughness.xyz);
+    vec4 position = vec4(reconstructPosition(subpassLoad(inDepth).r), 1.0);
+    vec3 normal = decodeNormal(normalRoughness.xy);
+    vec3 light = vec3(0);
 
-    if (light.type == LT_DIRECTIONAL) {
-        float diffuse = max(dot(normal, -light.direction), 0);
-        outColor = vec4(diffuseOcclusion.rgb, 1.0) * diffuse * vec4(light.color, 1.0);
-    } else if (light.type == LT_POINT) {
-        vec3 toLight = light.position - position.xyz;
-        float distToLight = length(toLight);
+    if (CLUSTERED) {
+        for (uint i = 0; i < push.directionalCount; ++i) {
+            light += shade(scene.lights[active.lightSlots[i]], position.xyz, normal);
+        }
 
-        float atten = 1.0 / dot(vec3(1, distToLight, distToLight*distToLight), attenuation / light.range);
+        float viewDepth = -(cam.view * vec4(position.xyz, 1.0)).z;
+        uvec3 cluster = uvec3(
+            min(uvec2(gl_FragCoord.xy * push.pixelSize * vec2(CLUSTERS_X, CLUSTERS_Y)), uvec2(CLUSTERS_X, CLUSTERS_Y) - 1),
+            uint(clamp(log(max(viewDepth, 1e-4)) * push.sliceScale - push.sliceBias, 0.0, float(CLUSTERS_Z - 1)))
+        );
+        uint index = cluster.x + cluster.y * CLUSTERS_X + cluster.z * CLUSTERS_X * CLUSTERS_Y;
 
-        outColor = vec4(diffuseOcclusion.rgb, 1.0) * vec4(light.color * max(0.0, dot(normal, toLight / distToLight) * light.intensity * atten), 1);
+        uint count = grid.clusters[index].lightCount;
+        for (uint i = 0; i < count; ++i) {
+            light += shade(scene.lights[grid.clusters[index].lightSlots[i]], position.xyz, normal);
+        }
+    } else {
+        light = shade(scene.lights[push.lightSlot], position.xyz, normal);
     }
-}
\ No newline at end of file
+
+    outColor = vec4(diffuseOcclusion.rgb * light, 1.0);
+}
@@ -0,0 +1,139 @@
+#version 450
+#pragma shader_stage(fragment)
+#extension GL_ARB_separate_shader_objects : enable
+
+#define LT_DIRECTIONAL 0
+#define LT_POINT 1
+#define LT_SPOT 2
+
+// Matches the cluster grid in deferred_pipeline.cpp
+const uint CLUSTERS_X = 16;
+const uint CLUSTERS_Y = 9;
+const uint CLUSTERS_Z = 24;
+const uint MAX_CLUSTER_LIGHTS = 63;
+
+const vec3 attenuation = vec3(0.02f, 0.01f, 0.04f);
+
+// When set, every light in the pixel's cluster is shaded in one pass instead of one light per draw
+layout (constant_id = 0) const bool CLUSTERED = false;
+
+layout (set = 0, binding = 0) uniform CameraUBO {
+    mat4 view;
+    mat4 proj;
+    mat4 inverseViewProj;
+} cam;
+
+// The full resolution G-buffer
+layout (set = 0, binding = 4) uniform sampler2D inNormalRoughness;
+layout (set = 0, binding = 6) uniform sampler2D inDepth;
+
+struct LightData {
+    vec3 position;
+    vec3 direction;
+    vec3 color;
+    float intensity;
+    float range;
+    uint type;
+    float spotCosine;
+};
+
+struct Cluster {
+    uint lightCount;
+    uint lightSlots[MAX_CLUSTER_LIGHTS];
+};
+
+// Every light in the scene, indexed by its slot
+layout (std430, set = 1, binding = 2) readonly buffer LightSSBO {
+    LightData lights[];
+} scene;
+
+// The slots of the lights being drawn this frame, directional lights first
+layout (std430, set = 1, binding = 7) readonly buffer ActiveLightSSBO {
+    uint lightSlots[];
+} active;
+
+layout (std430, set = 1, binding = 8) readonly buffer ClusterSSBO {
+    Cluster clusters[];
+} grid;
+
+layout (push_constant) uniform LightPushConstants {
+    // Only used by the light volume vertex shader
+    mat4 volume;
+    uint lightSlot;
+    uint directionalCount;
+    float sliceScale;
+    float sliceBias;
+    // The size of a full resolution pixel in 0 to 1 screen coordinates
+    vec2 pixelSize;
+    // Full resolution pixels across each of these pixels
+    uint divisor;
+} push;
+
+// Light reaching the surface, before it is multiplied by the surface colour
+layout(location = 0) out vec4 outLight;
+
+vec3 decodeNormal(vec2 encoded) {
+    encoded = encoded * 2.0 - 1.0;
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    // Unfold the lower half of the octahedron
+    float fold = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -fold : fold;
+    n.y += n.y >= 0.0 ? -fold : fold;
+    return normalize(n);
+}
+
+vec3 reconstructPosition(vec2 screen, float depth) {
+    vec4 world = cam.inverseViewProj * vec4(screen * 2.0 - 1.0, depth, 1.0);
+    return world.xyz / world.w;
+}
+
+vec3 shade(LightData light, vec3 position, vec3 normal) {
+    vec3 toLight = light.position - position;
+    float distToLight = length(toLight);
+    vec3 lightDir = toLight / distToLight;
+
+    float atten = 1.0 / dot(vec3(1, distToLight, distToLight*distToLight), attenuation / light.range);
+    // Fade to nothing at the range so that nothing is lost by bounding the light with it
+    float window = clamp(1.0 - pow(distToLight / light.range, 4.0), 0.0, 1.0);
+    atten *= window * window;
+
+    if (light.type == LT_SPOT) {
+        float cosine = dot(-lightDir, light.direction);
+        atten *= smoothstep(light.spotCosine, mix(light.spotCosine, 1.0, 0.1), cosine);
+    }
+
+    return light.color * max(0.0, dot(normal, lightDir) * light.intensity * atten);
+}
+
+void main() {
+    // Each pixel is shaded for the full resolution pixel in the middle of the ones it covers.
+    // deferred_upsample_frag.glsl picks the same one when comparing depths and normals
+    ivec2 texel = min(
+        ivec2(gl_FragCoord.xy) * int(push.divisor) + int(push.divisor / 2),
+        textureSize(inDepth, 0) - 1
+    );
+    vec2 screen = (vec2(texel) + 0.5) * push.pixelSize;
+
+    vec3 position = reconstructPosition(screen, texelFetch(inDepth, texel, 0).r);
+    vec3 normal = decodeNormal(texelFetch(inNormalRoughness, texel, 0).xy);
+    vec3 light = vec3(0);
+
+    if (CLUSTERED) {
+        // Directional lights are shaded at full resolution so only the clusters are needed
+        float viewDepth = -(cam.view * vec4(position, 1.0)).z;
+        uvec3 cluster = uvec3(
+            min(uvec2(screen * vec2(CLUSTERS_X, CLUSTERS_Y)), uvec2(CLUSTERS_X, CLUSTERS_Y) - 1),
+            uint(clamp(log(max(viewDepth, 1e-4)) * push.sliceScale - push.sliceBias, 0.0, float(CLUSTERS_Z - 1)))
+        );
+        uint index = cluster.x + cluster.y * CLUSTERS_X + cluster.z * CLUSTERS_X * CLUSTERS_Y;
+
+        uint count = grid.clusters[index].lightCount;
+        for (uint i = 0; i < count; ++i) {
+            light += shade(scene.lights[grid.clusters[index].lightSlots[i]], position, normal);
+        }
+    } else {
+        light = shade(scene.lights[push.lightSlot], position, normal);
+    }
+
+    outLight = vec4(light, 1.0);
+}
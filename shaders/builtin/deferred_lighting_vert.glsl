@@ -7,9 +7,10 @@ layout(set = 0, binding = 0) uniform CameraUBO {
     mat4 proj;
 } cam;
 
-layout(set = 1, binding = 1) uniform EntityUBO {
-    mat4 transform;
-} obj;
+layout(push_constant) uniform LightPushConstants {
+    // Places the unit sphere or cone around the light
+    mat4 volume;
+} push;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
@@ -18,5 +19,5 @@ layout(location = 3) in vec4 inColor;
 layout(location = 4) in vec2 inTexCoord;
 
 void main() {
-    gl_Position = cam.proj * cam.view * obj.transform * vec4(inPosition, 1.0);
-}
\ No newline at end of file
+    gl_Position = cam.proj * cam.view * push.volume * vec4(inPosition, 1.0);
+}
@@ -0,0 +1,88 @@
+#version 450
+#pragma shader_stage(fragment)
+#extension GL_ARB_separate_shader_objects : enable
+
+// How quickly a sample loses weight as its depth moves away, relative to the pixel's depth
+const float DEPTH_FALLOFF = 50.0;
+// Higher only accepts samples facing more closely the same way
+const float NORMAL_POWER = 16.0;
+
+layout (set = 0, binding = 0) uniform CameraUBO {
+    mat4 view;
+    mat4 proj;
+} cam;
+
+layout (set = 0, binding = 1) uniform sampler2D inReducedLight;
+layout (set = 0, binding = 4) uniform sampler2D inNormalRoughness;
+layout (set = 0, binding = 5) uniform sampler2D inDiffuseOcclusion;
+layout (set = 0, binding = 6) uniform sampler2D inDepth;
+
+layout (push_constant) uniform UpsamplePushConstants {
+    // Full resolution pixels across each reduced lighting pixel
+    uint divisor;
+} push;
+
+layout(location = 0) out vec4 outColor;
+
+vec3 decodeNormal(vec2 encoded) {
+    encoded = encoded * 2.0 - 1.0;
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    // Unfold the lower half of the octahedron
+    float fold = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -fold : fold;
+    n.y += n.y >= 0.0 ? -fold : fold;
+    return normalize(n);
+}
+
+float viewDepth(float depth) {
+    return cam.proj[3][2] / (depth + cam.proj[2][2]);
+}
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    ivec2 fullSize = textureSize(inDepth, 0);
+    ivec2 reducedSize = textureSize(inReducedLight, 0);
+
+    float depth = viewDepth(texelFetch(inDepth, texel, 0).r);
+    vec3 normal = decodeNormal(texelFetch(inNormalRoughness, texel, 0).xy);
+
+    // The four reduced pixels around this one, with their bilinear weights
+    vec2 reduced = (vec2(texel) + 0.5) / float(push.divisor) - 0.5;
+    ivec2 base = ivec2(floor(reduced));
+    vec2 blend = reduced - vec2(base);
+
+    vec3 light = vec3(0);
+    float totalWeight = 0.0;
+    vec3 closestLight = vec3(0);
+    float closestDifference = 1e30;
+
+    for (int i = 0; i < 4; ++i) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 sampleTexel = clamp(base + offset, ivec2(0), reducedSize - 1);
+
+        // The full resolution pixel the reduced pixel was shaded for
+        ivec2 source = min(sampleTexel * int(push.divisor) + int(push.divisor / 2), fullSize - 1);
+        float sampleDepth = viewDepth(texelFetch(inDepth, source, 0).r);
+        vec3 sampleNormal = decodeNormal(texelFetch(inNormalRoughness, source, 0).xy);
+        vec3 sampleLight = texelFetch(inReducedLight, sampleTexel, 0).rgb;
+
+        vec2 bilinear = mix(1.0 - blend, blend, vec2(offset));
+        float difference = abs(sampleDepth - depth) / depth;
+        float weight = bilinear.x * bilinear.y *
+            exp(-difference * DEPTH_FALLOFF) *
+            pow(max(dot(sampleNormal, normal), 0.0), NORMAL_POWER);
+
+        light += sampleLight * weight;
+        totalWeight += weight;
+
+        if (difference < closestDifference) {
+            closestDifference = difference;
+            closestLight = sampleLight;
+        }
+    }
+
+    // Every sample is across an edge, so the nearest surface is the best guess
+    light = totalWeight > 1e-4 ? light / totalWeight : closestLight;
+
+    outColor = vec4(texelFetch(inDiffuseOcclusion, texel, 0).rgb * light, 1.0);
+}
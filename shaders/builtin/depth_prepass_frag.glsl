@@ -0,0 +1,7 @@
+#version 450
+#pragma shader_stage(fragment)
+#extension GL_ARB_separate_shader_objects : enable
+
+// Only depth is written by the pre-pass
+void main() {
+}
@@ -0,0 +1,34 @@
+#version 450
+#pragma shader_stage(vertex)
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0) uniform CameraUBO {
+    mat4 view;
+    mat4 proj;
+} cam;
+
+struct EntityData {
+    mat4 transform;
+};
+
+// Every entity in the scene, indexed by its slot
+layout(std430, set = 1, binding = 1) readonly buffer EntitySSBO {
+    EntityData entities[];
+} scene;
+
+// The entity slot of each instance of the draw. gl_InstanceIndex includes the draw's first instance
+layout(std430, set = 1, binding = 5) readonly buffer InstanceSSBO {
+    uint entitySlots[];
+} instances;
+
+layout(location = 0) in vec3 inPosition;
+
+// Must be computed exactly as in standard-vert.glsl so the geometry pass can test for equal depth
+invariant gl_Position;
+
+void main() {
+    mat4 transform = scene.entities[instances.entitySlots[gl_InstanceIndex]].transform;
+
+    vec4 worldPosition = transform * vec4(inPosition, 1.0);
+    gl_Position = cam.proj * cam.view * worldPosition;
+}
@@ -0,0 +1,97 @@
+#version 450
+#pragma shader_stage(compute)
+
+layout(local_size_x = 64) in;
+
+// Matches DrawGroup in deferred_pipeline.hpp
+struct DrawGroup {
+    // VkDrawIndexedIndirectCommand
+    uint indexCount;
+    uint instanceCount;
+    uint firstIndex;
+    int vertexOffset;
+    uint firstInstance;
+
+    uint padding[3];
+    // w is 0 when the mesh has no bounds and must always be drawn
+    vec4 boundsMin;
+    vec4 boundsMax;
+};
+
+struct EntityData {
+    mat4 transform;
+};
+
+layout(push_constant) uniform CullParameters {
+    vec4 planes[6];
+    uint instanceCount;
+} params;
+
+// The entity slot of every instance
+layout(std430, binding = 0) readonly buffer CandidateSSBO {
+    uint entitySlots[];
+} candidates;
+
+layout(std430, binding = 1) readonly buffer GroupSSBO {
+    uint groups[];
+} candidateGroups;
+
+layout(std430, binding = 2) buffer DrawSSBO {
+    DrawGroup groups[];
+} draws;
+
+layout(std430, binding = 3) writeonly buffer VisibleSSBO {
+    uint entitySlots[];
+} visible;
+
+layout(std430, binding = 4) buffer CounterSSBO {
+    uint visibleInstances;
+} counters;
+
+layout(std430, binding = 5) readonly buffer EntitySSBO {
+    EntityData entities[];
+} scene;
+
+bool isVisible(mat4 transform, vec3 localMin, vec3 localMax) {
+    // The world space box around the transformed local box
+    vec3 center = (transform * vec4((localMin + localMax) * 0.5, 1.0)).xyz;
+    vec3 localExtent = (localMax - localMin) * 0.5;
+    mat3 absolute = mat3(abs(transform[0].xyz), abs(transform[1].xyz), abs(transform[2].xyz));
+    vec3 extent = absolute * localExtent;
+
+    for (int i = 0; i < 6; ++i) {
+        vec4 plane = params.planes[i];
+        // The corner furthest in front of the plane
+        if (dot(plane.xyz, center) + dot(abs(plane.xyz), extent) + plane.w <= 0.0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    if (index >= params.instanceCount) {
+        return;
+    }
+
+    uint group = candidateGroups.groups[index];
+    if (draws.groups[group].indexCount == 0) {
+        return;
+    }
+
+    uint entitySlot = candidates.entitySlots[index];
+    mat4 transform = scene.entities[entitySlot].transform;
+
+    vec4 boundsMin = draws.groups[group].boundsMin;
+    vec4 boundsMax = draws.groups[group].boundsMax;
+    if (boundsMin.w != 0.0 && !isVisible(transform, boundsMin.xyz, boundsMax.xyz)) {
+        return;
+    }
+
+    // Visible instances are packed from the start of the group's range
+    uint slot = atomicAdd(draws.groups[group].instanceCount, 1);
+    visible.entitySlots[draws.groups[group].firstInstance + slot] = entitySlot;
+    atomicAdd(counters.visibleInstances, 1);
+}
@@ -0,0 +1,111 @@
+#version 450
+#pragma shader_stage(compute)
+
+layout(local_size_x = 64) in;
+
+// Matches the cluster grid in deferred_pipeline.cpp
+const uint CLUSTERS_X = 16;
+const uint CLUSTERS_Y = 9;
+const uint CLUSTERS_Z = 24;
+const uint MAX_CLUSTER_LIGHTS = 63;
+
+struct LightData {
+    vec3 position;
+    vec3 direction;
+    vec3 color;
+    float intensity;
+    float range;
+    uint type;
+    float spotCosine;
+};
+
+struct Cluster {
+    uint lightCount;
+    uint lightSlots[MAX_CLUSTER_LIGHTS];
+};
+
+layout(push_constant) uniform ClusterParameters {
+    mat4 view;
+    // proj[0][0] and proj[1][1]
+    vec2 projectionScale;
+    float nearClip;
+    float farClip;
+    // Lights before this in the active list are directional and are not binned
+    uint firstLight;
+    uint lightCount;
+} params;
+
+// Every light in the scene, indexed by its slot
+layout(std430, binding = 0) readonly buffer LightSSBO {
+    LightData lights[];
+} scene;
+
+// The slots of the lights being drawn this frame
+layout(std430, binding = 1) readonly buffer ActiveLightSSBO {
+    uint lightSlots[];
+} active;
+
+layout(std430, binding = 2) writeonly buffer ClusterSSBO {
+    Cluster clusters[];
+} grid;
+
+// View space spheres of the lights being tested by the workgroup
+shared vec4 batchSpheres[gl_WorkGroupSize.x];
+shared uint batchSlots[gl_WorkGroupSize.x];
+
+vec3 toView(vec2 ndc, float depth) {
+    return vec3(ndc * depth / params.projectionScale, -depth);
+}
+
+void main() {
+    uint index = gl_GlobalInvocationID.x;
+    bool inGrid = index < CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+
+    uint x = index % CLUSTERS_X;
+    uint y = (index / CLUSTERS_X) % CLUSTERS_Y;
+    uint z = index / (CLUSTERS_X * CLUSTERS_Y);
+
+    // Slices are spaced exponentially so that clusters stay roughly cubic with distance
+    vec2 ndcMin = vec2(x, y) / vec2(CLUSTERS_X, CLUSTERS_Y) * 2.0 - 1.0;
+    vec2 ndcMax = vec2(x + 1, y + 1) / vec2(CLUSTERS_X, CLUSTERS_Y) * 2.0 - 1.0;
+    float depthRatio = params.farClip / params.nearClip;
+    float nearDepth = params.nearClip * pow(depthRatio, float(z) / CLUSTERS_Z);
+    float farDepth = params.nearClip * pow(depthRatio, float(z + 1) / CLUSTERS_Z);
+
+    // The view space box around the cluster
+    vec3 boxMin = min(
+        min(toView(ndcMin, nearDepth), toView(ndcMax, nearDepth)),
+        min(toView(ndcMin, farDepth), toView(ndcMax, farDepth))
+    );
+    vec3 boxMax = max(
+        max(toView(ndcMin, nearDepth), toView(ndcMax, nearDepth)),
+        max(toView(ndcMin, farDepth), toView(ndcMax, farDepth))
+    );
+
+    uint count = 0;
+    for (uint batch = params.firstLight; batch < params.lightCount; batch += gl_WorkGroupSize.x) {
+        // Each invocation transforms one light of the batch for the whole workgroup
+        uint load = batch + gl_LocalInvocationID.x;
+        if (load < params.lightCount) {
+            uint slot = active.lightSlots[load];
+            LightData light = scene.lights[slot];
+            batchSpheres[gl_LocalInvocationID.x] = vec4((params.view * vec4(light.position, 1.0)).xyz, light.range);
+            batchSlots[gl_LocalInvocationID.x] = slot;
+        }
+        barrier();
+
+        uint batchSize = min(gl_WorkGroupSize.x, params.lightCount - batch);
+        for (uint i = 0; inGrid && i < batchSize && count < MAX_CLUSTER_LIGHTS; ++i) {
+            vec4 sphere = batchSpheres[i];
+            vec3 offset = sphere.xyz - clamp(sphere.xyz, boxMin, boxMax);
+            if (dot(offset, offset) <= sphere.w * sphere.w) {
+                grid.clusters[index].lightSlots[count++] = batchSlots[i];
+            }
+        }
+        barrier();
+    }
+
+    if (inGrid) {
+        grid.clusters[index].lightCount = count;
+    }
+}
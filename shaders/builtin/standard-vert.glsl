@@ -7,9 +7,19 @@ layout(binding = 0) uniform CameraUBO {
     mat4 proj;
 } cam;
 
-layout(set = 1, binding = 1) uniform EntityUBO {
+struct EntityData {
     mat4 transform;
-} obj;
+};
+
+// Every entity in the scene, indexed by its slot
+layout(std430, set = 1, binding = 1) readonly buffer EntitySSBO {
+    EntityData entities[];
+} scene;
+
+// The entity slot of each instance of the draw. gl_InstanceIndex includes the draw's first instance
+layout(std430, set = 1, binding = 5) readonly buffer InstanceSSBO {
+    uint entitySlots[];
+} instances;
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
@@ -23,12 +33,17 @@ layout(location = 2) out vec3 fragTangent;
 layout(location = 3) out vec2 fragTexCoord;
 layout(location = 4) out vec4 fragPosition;
 
+// Must match depth_prepass_vert.glsl exactly so the geometry pass can test for equal depth
+invariant gl_Position;
+
 
 void main() {
-    fragPosition = obj.transform * vec4(inPosition, 1.0);
+    mat4 transform = scene.entities[instances.entitySlots[gl_InstanceIndex]].transform;
+
+    fragPosition = transform * vec4(inPosition, 1.0);
     gl_Position = cam.proj * cam.view * fragPosition;
-    fragNormal = normalize(inNormal * mat3(obj.transform));
-    fragTangent = normalize(inTangent * mat3(obj.transform));
+    fragNormal = normalize(inNormal * mat3(transform));
+    fragTangent = normalize(inTangent * mat3(transform));
     fragTexCoord = inTexCoord;
     fragColour = inColor;
 
@@ -1,11 +1,22 @@
 #include "tech-core/buffer.hpp"
 #include "tech-core/device.hpp"
 #include <iostream>
+#include <cstring>
+#include <algorithm>
 
 namespace Engine {
 
-BufferManager::BufferManager(VulkanDevice &device)
-    : device(device) {}
+const vk::DeviceSize StagingRingSize = 32 * 1024 * 1024;
+// Uploads larger than this get their own buffer so they do not hold up the ring
+const vk::DeviceSize StagingRingMaxUpload = StagingRingSize / 4;
+// Buffer to image copies need offsets aligned to the texel size
+const vk::DeviceSize StagingAlignment = 16;
+
+BufferManager::BufferManager(VulkanDevice &device, uint32_t framesInFlight)
+    : device(device),
+    framesInFlight(framesInFlight) {
+    frameRelease.emplace_back();
+}
 
 std::unique_ptr<Buffer> BufferManager::aquire(
     vk::DeviceSize size,
@@ -39,29 +50,93 @@ std::shared_ptr<DivisibleBuffer> BufferManager::aquireDivisibleShared(
     return std::make_shared<DivisibleBuffer>(device.allocator, size, usage, memoryUsage);
 }
 
+std::unique_ptr<ReplicatedBuffer> BufferManager::aquireReplicated(
+    vk::DeviceSize size,
+    vk::BufferUsageFlags usage,
+    vk::MemoryUsage memoryUsage,
+    uint32_t copies
+) {
+    return std::make_unique<ReplicatedBuffer>(device.allocator, size, usage, memoryUsage, copies);
+}
+
 void BufferManager::releaseAfterFrame(std::unique_ptr<Buffer> buffer) {
 #ifdef DEBUG_BUFFER
     std::cout << "release buffer after frame " << buffer->buffer() << std::endl;
 #endif
-    nextFrameRelease.push_back(std::move(buffer));
+    frameRelease.back().push_back(std::move(buffer));
 }
 
-std::unique_ptr<Buffer> BufferManager::aquireStaging(vk::DeviceSize size) {
-    return std::make_unique<Buffer>(
+std::unique_ptr<StagingBuffer> BufferManager::aquireStaging(vk::DeviceSize size) {
+    vk::DeviceSize offset;
+    uint64_t entry;
+    if (allocateStaging(size, offset, entry)) {
+        return std::unique_ptr<StagingBuffer>(new StagingBuffer(*this, stagingRing.get(), offset, size, entry));
+    }
+
+    // Too large for the ring or the ring is full
+    auto buffer = std::make_unique<Buffer>(
         device.allocator,
         size,
         vk::BufferUsageFlagBits::eTransferSrc,
         vk::MemoryUsage::eCPUOnly
     );
+
+    return std::unique_ptr<StagingBuffer>(new StagingBuffer(*this, std::move(buffer), size));
 }
 
-std::shared_ptr<Buffer> BufferManager::aquireStagingShared(vk::DeviceSize size) {
-    return std::make_shared<Buffer>(
-        device.allocator,
-        size,
-        vk::BufferUsageFlagBits::eTransferSrc,
-        vk::MemoryUsage::eCPUOnly
-    );
+bool BufferManager::allocateStaging(vk::DeviceSize size, vk::DeviceSize &offset, uint64_t &entry) {
+    if (size == 0 || size > StagingRingMaxUpload) {
+        return false;
+    }
+
+    if (!stagingRing) {
+        stagingRing = std::make_unique<Buffer>(
+            device.allocator,
+            StagingRingSize,
+            vk::BufferUsageFlagBits::eTransferSrc,
+            vk::MemoryUsage::eCPUOnly
+        );
+    }
+
+    vk::DeviceSize start = 0;
+    if (!stagingEntries.empty()) {
+        auto tail = stagingEntries.front().start;
+        auto head = (stagingEntries.back().end + StagingAlignment - 1) & ~(StagingAlignment - 1);
+
+        if (stagingEntries.back().end > tail) {
+            // Free space is after the head, and before the tail once wrapped around
+            if (head + size <= StagingRingSize) {
+                start = head;
+            } else if (size <= tail) {
+                start = 0;
+            } else {
+                return false;
+            }
+        } else {
+            // Already wrapped, the only free space is between the head and the tail
+            if (head + size <= tail) {
+                start = head;
+            } else {
+                return false;
+            }
+        }
+    }
+
+    offset = start;
+    entry = firstStagingEntry + stagingEntries.size();
+    stagingEntries.push_back({ start, start + size, false });
+
+    return true;
+}
+
+void BufferManager::releaseStaging(uint64_t entry) {
+    stagingEntries[entry - firstStagingEntry].released = true;
+
+    // Regions are reclaimed in order so the ring stays contiguous
+    while (!stagingEntries.empty() && stagingEntries.front().released) {
+        stagingEntries.pop_front();
+        ++firstStagingEntry;
+    }
 }
 
 void BufferManager::release(std::unique_ptr<Buffer> &buffer, vk::Fence onlyAfter) {
@@ -99,8 +174,11 @@ void BufferManager::release(std::unique_ptr<Buffer> &buffer, vk::UniqueFence onl
 }
 
 void BufferManager::processActions() {
-    // Release the ones for the next frame
-    nextFrameRelease.clear();
+    // Release the ones no frame in flight can be using anymore
+    frameRelease.emplace_back();
+    while (frameRelease.size() > framesInFlight) {
+        frameRelease.pop_front();
+    }
 
     // Release after fences
     fenceRelease.erase(
@@ -121,6 +199,13 @@ void BufferManager::processActions() {
     );
 }
 
+void BufferManager::releaseAll() {
+    frameRelease.clear();
+    frameRelease.emplace_back();
+    fenceRelease.clear();
+    stagingRing.reset();
+}
+
 
 Buffer::Buffer()
     : allocator(VK_NULL_HANDLE), size(0), allocation(VK_NULL_HANDLE) {}
@@ -149,12 +234,22 @@ Buffer::allocate(VmaAllocator allocator, vk::DeviceSize size, vk::BufferUsageFla
     VmaAllocationCreateInfo allocInfo = {};
     allocInfo.usage = static_cast<VmaMemoryUsage>(targetUsage);
 
+    // Host visible memory is kept mapped rather than mapping on every access
+    bool hostVisible = targetUsage == vk::MemoryUsage::eCPUOnly ||
+        targetUsage == vk::MemoryUsage::eCPUToGPU ||
+        targetUsage == vk::MemoryUsage::eGPUToCPU;
+    if (hostVisible) {
+        allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    }
+
     VkBuffer temp;
-    if (vmaCreateBuffer(allocator, &createInfo, &allocInfo, &temp, &allocation, nullptr) != VK_SUCCESS) {
+    VmaAllocationInfo allocationInfo = {};
+    if (vmaCreateBuffer(allocator, &createInfo, &allocInfo, &temp, &allocation, &allocationInfo) != VK_SUCCESS) {
         throw std::runtime_error("Failed to allocate buffer");
     }
 
     internalBuffer = vk::Buffer(temp);
+    mappedData = allocationInfo.pMappedData;
 
 #ifdef DEBUG_BUFFER
     std::cout << "Created Buffer " << internalBuffer << std::endl;
@@ -170,21 +265,22 @@ void Buffer::destroy() {
 
         allocator = VK_NULL_HANDLE;
         allocation = VK_NULL_HANDLE;
+        mappedData = nullptr;
     }
 }
 
 void Buffer::copyIn(const void *data, vk::DeviceSize offset, vk::DeviceSize size) {
     void *bufferData;
-    vmaMapMemory(allocator, allocation, &bufferData);
-    memcpy(bufferData + offset, data, size);
-    vmaUnmapMemory(allocator, allocation);
+    map(&bufferData);
+    memcpy(static_cast<uint8_t *>(bufferData) + offset, data, size);
+    unmap();
 }
 
 void Buffer::copyOut(void *dest, vk::DeviceSize offset, vk::DeviceSize size) {
     void *bufferData;
-    vmaMapMemory(allocator, allocation, &bufferData);
-    memcpy(dest, bufferData + offset, size);
-    vmaUnmapMemory(allocator, allocation);
+    map(&bufferData);
+    memcpy(dest, static_cast<const uint8_t *>(bufferData) + offset, size);
+    unmap();
 }
 
 void Buffer::transfer(
@@ -215,6 +311,109 @@ void Buffer::flushRange(vk::DeviceSize start, vk::DeviceSize size) {
     vmaFlushAllocation(allocator, allocation, start, size);
 }
 
+/**
+ * Makes device writes to a range of memory visible to the host.
+ * Only applicable for host visible but non-coherent buffers
+ */
+void Buffer::invalidateRange(vk::DeviceSize start, vk::DeviceSize size) {
+    vmaInvalidateAllocation(allocator, allocation, start, size);
+}
+
+void Buffer::flushRanges(DirtyRanges &ranges) {
+    for (auto &range : ranges.merged()) {
+        vmaFlushAllocation(allocator, allocation, range.offset, range.size);
+    }
+
+    ranges.clear();
+}
+
+// StagingBuffer
+StagingBuffer::StagingBuffer(
+    BufferManager &manager, Buffer *buffer, vk::DeviceSize offset, vk::DeviceSize size, uint64_t entry
+) : manager(manager),
+    buffer(buffer),
+    offset(offset),
+    size(size),
+    entry(entry) {}
+
+StagingBuffer::StagingBuffer(BufferManager &manager, std::unique_ptr<Buffer> ownBuffer, vk::DeviceSize size)
+    : manager(manager),
+    buffer(ownBuffer.get()),
+    offset(0),
+    size(size),
+    entry(0),
+    ownBuffer(std::move(ownBuffer)) {}
+
+StagingBuffer::~StagingBuffer() {
+    if (!ownBuffer) {
+        manager.releaseStaging(entry);
+    }
+}
+
+void StagingBuffer::copyIn(const void *data, vk::DeviceSize offset, vk::DeviceSize size) {
+    buffer->copyIn(data, this->offset + offset, size);
+    buffer->flushRange(this->offset + offset, size);
+}
+
+void StagingBuffer::transfer(
+    VkCommandBuffer commandBuffer, Buffer &target, vk::DeviceSize srcOffset, vk::DeviceSize destOffset,
+    vk::DeviceSize size
+) {
+    buffer->transfer(commandBuffer, target, offset + srcOffset, destOffset, size);
+}
+
+// DirtyRanges
+void DirtyRanges::add(vk::DeviceSize offset, vk::DeviceSize size) {
+    if (!ranges.empty()) {
+        // Writes are usually sequential so try to extend the last range first
+        auto &last = ranges.back();
+        if (offset >= last.offset && offset <= last.offset + last.size) {
+            last.size = std::max(last.offset + last.size, offset + size) - last.offset;
+            return;
+        }
+
+        if (offset < last.offset) {
+            isMerged = false;
+        }
+    }
+
+    ranges.push_back({ offset, size });
+}
+
+const std::vector<DirtyRanges::Range> &DirtyRanges::merged() {
+    if (isMerged) {
+        return ranges;
+    }
+
+    std::sort(
+        ranges.begin(), ranges.end(), [](const Range &a, const Range &b) {
+            return a.offset < b.offset;
+        }
+    );
+
+    size_t count = 0;
+    for (auto &range : ranges) {
+        if (count > 0) {
+            auto &last = ranges[count - 1];
+            if (range.offset <= last.offset + last.size) {
+                last.size = std::max(last.offset + last.size, range.offset + range.size) - last.offset;
+                continue;
+            }
+        }
+
+        ranges[count++] = range;
+    }
+
+    ranges.resize(count);
+    isMerged = true;
+    return ranges;
+}
+
+void DirtyRanges::clear() {
+    ranges.clear();
+    isMerged = true;
+}
+
 // DivisibleBuffer
 DivisibleBuffer::DivisibleBuffer()
     : Buffer() {}
@@ -228,7 +427,6 @@ DivisibleBuffer::DivisibleBuffer(
 
 DivisibleBuffer::~DivisibleBuffer() {
     destroy();
-    freeSpaceTracking.clear();
 }
 
 void DivisibleBuffer::allocate(
@@ -236,80 +434,94 @@ void DivisibleBuffer::allocate(
 ) {
     Buffer::allocate(allocator, size, usage, targetUsage);
 
-    freeSpaceTracking.clear();
-    freeSpaceTracking.push_back({ 0, size });
+    sections.reset(size);
 }
 
-void DivisibleBuffer::freeSection(vk::DeviceSize offset, vk::DeviceSize size) {
-    auto it = freeSpaceTracking.begin();
-    for (; it != freeSpaceTracking.end(); ++it) {
-        if (it->offset + it->size == offset) {
-            // Contiguous after, possibly joined to free space after
-            it->size += size;
-            auto &lastSpace = *it;
-
-            // Check for merges
-            ++it;
-            if (it->offset == lastSpace.offset + lastSpace.size) {
-                // It is contiguous
-                lastSpace.size += it->size;
-                freeSpaceTracking.erase(it);
-            }
+void DivisibleBuffer::freeSection(vk::DeviceSize offset) {
+    sections.free(offset);
+}
 
-            return;
-        } else if (offset + size == it->offset) {
-            // Contiguous before, but not joined to free space before
-            it->offset = offset;
-            it->size += size;
+vk::DeviceSize DivisibleBuffer::allocateSection(vk::DeviceSize size, vk::DeviceSize alignment) {
+    return sections.allocate(size, alignment);
+}
 
-            return;
-        } else if (it->offset > offset) {
-            // Disjoint region
-            freeSpaceTracking.insert(it, { offset, size });
+// ReplicatedBuffer
+ReplicatedBuffer::ReplicatedBuffer(
+    VmaAllocator allocator, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryUsage targetUsage,
+    uint32_t copies
+) : allocator(allocator),
+    size(size),
+    usage(usage),
+    targetUsage(targetUsage),
+    sections(size),
+    contents(size) {
+    setCopyCount(copies);
+}
 
-            return;
-        }
+void ReplicatedBuffer::setCopyCount(uint32_t count) {
+    auto previousCount = copies.size();
+    copies.resize(count);
 
+    for (auto index = previousCount; index < count; ++index) {
+        auto &copy = copies[index];
+        copy.buffer = std::make_shared<Buffer>(allocator, size, usage, targetUsage);
+        copy.pending.add(0, size);
     }
+}
+
+void ReplicatedBuffer::copyIn(const void *data, vk::DeviceSize offset, vk::DeviceSize size) {
+    std::memcpy(contents.data() + offset, data, size);
 
-    // Disjoint region at end
-    freeSpaceTracking.push_back({ offset, size });
+    for (auto &copy : copies) {
+        copy.pending.add(offset, size);
+    }
 }
 
-template<typename T>
-void DivisibleBuffer::freeSection(vk::DeviceSize offset) {
-    freeSection(offset, sizeof(T));
+void ReplicatedBuffer::resize(vk::DeviceSize newSize) {
+    if (sections.getStats().allocationCount > 0) {
+        throw std::runtime_error("Cannot resize a buffer that is divided into sections");
+    }
+
+    if (newSize <= size) {
+        return;
+    }
+
+    size = newSize;
+    contents.resize(size);
+    sections.reset(size);
 }
 
-/**
- * Allocates a new region of the buffer.
- * @returns The offset in the buffer. Returns ALLOCATION_FAILED if allocation failed
- */
-vk::DeviceSize DivisibleBuffer::allocateSection(vk::DeviceSize size) {
-    // Use greedy method first. At some point we can try a best fit approach
-    auto it = freeSpaceTracking.begin();
-    for (; it != freeSpaceTracking.end(); ++it) {
-        if (it->size >= size) {
-            vk::DeviceSize offset = it->offset;
-
-            if (it->size == size) {
-                freeSpaceTracking.erase(it);
-            } else {
-                it->size -= size;
-                it->offset += size;
-            }
+bool ReplicatedBuffer::update(uint32_t copy) {
+    auto &target = copies[copy];
+    bool replaced = false;
+
+    if (target.buffer->getSize() < size) {
+        // Anything still holding the old buffer keeps it alive, so its address cannot be reused under it
+        auto buffer = std::make_shared<Buffer>(allocator, size, usage, targetUsage);
+        target.buffer = std::move(buffer);
+        target.pending.clear();
+        target.pending.add(0, size);
+        replaced = true;
+    }
 
-            return offset;
-        }
+    if (target.pending.empty()) {
+        return replaced;
+    }
+
+    for (auto &range : target.pending.merged()) {
+        target.buffer->copyIn(contents.data() + range.offset, range.offset, range.size);
     }
 
-    // Failed to allocate
-    return ALLOCATION_FAILED;
+    target.buffer->flushRanges(target.pending);
+    return replaced;
 }
 
-template<typename T>
-vk::DeviceSize DivisibleBuffer::allocateSection() {
-    return allocateSection(sizeof(T));
+void ReplicatedBuffer::freeSection(vk::DeviceSize offset) {
+    sections.free(offset);
 }
 
-}
\ No newline at end of file
+vk::DeviceSize ReplicatedBuffer::allocateSection(vk::DeviceSize size, vk::DeviceSize alignment) {
+    return sections.allocate(size, alignment);
+}
+
+}
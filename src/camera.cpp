@@ -90,6 +90,7 @@ float Camera::getAspectRatio() const {
 
 void Camera::updateView() {
     uniform.view = glm::lookAt(position, position + forward, up);
+    uniform.inverseViewProj = glm::inverse(uniform.proj * uniform.view);
 
     frustum.update(uniform.proj * uniform.view);
 }
@@ -103,6 +104,7 @@ void Camera::updateProjection() {
     if (type == CameraType::Perspective) {
         uniform.proj = glm::perspective(glm::radians(fov), aspectRatio, nearClip, farClip);
         uniform.proj[1][1] *= -1;
+        uniform.inverseViewProj = glm::inverse(uniform.proj * uniform.view);
 
         frustum.update(uniform.proj * uniform.view);
     } else {
@@ -115,7 +117,7 @@ const Frustum &Camera::getFrustum() const {
 }
 
 void Camera::rayFromCoord(const glm::vec2 &screenCoord, glm::vec3 &worldOrigin, glm::vec3 &worldDirection) const {
-    auto invViewProj = glm::inverse(uniform.proj * uniform.view);
+    auto &invViewProj = uniform.inverseViewProj;
     glm::vec4 screenCoordNear { screenCoord.x, screenCoord.y, 0, 1 };
     glm::vec4 screenCoordFar { screenCoord.x, screenCoord.y, 1, 1 };
 
@@ -0,0 +1,146 @@
+#include "tech-core/command_state.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace Engine {
+
+void CommandState::begin(vk::CommandBuffer buffer) {
+    commandBuffer = buffer;
+    graphics = {};
+    compute = {};
+    vertexBindings = {};
+    indexBuffer = nullptr;
+    indexOffset = 0;
+    pushLayout = nullptr;
+    pushedRanges.clear();
+}
+
+void CommandState::bindPipeline(vk::PipelineBindPoint bindPoint, vk::Pipeline pipeline) {
+    auto &state = getBindPoint(bindPoint);
+    if (state.pipeline == pipeline) {
+        ++stats.pipelines.skipped;
+        return;
+    }
+
+    commandBuffer.bindPipeline(bindPoint, pipeline);
+    state.pipeline = pipeline;
+    ++stats.pipelines.issued;
+}
+
+void CommandState::bindDescriptorSets(
+    vk::PipelineBindPoint bindPoint, vk::PipelineLayout layout, uint32_t firstSet,
+    uint32_t descriptorSetCount, const vk::DescriptorSet *descriptorSets,
+    uint32_t dynamicOffsetCount, const uint32_t *dynamicOffsets
+) {
+    auto &state = getBindPoint(bindPoint);
+
+    // Sets bound through another layout may have been disturbed
+    if (state.layout != layout) {
+        state.layout = layout;
+        state.sets = {};
+    }
+
+    // Dynamic offsets cannot be matched to their sets when several are bound at once, so only single sets are elided
+    bool trackable = descriptorSetCount == 1 && firstSet < MaxDescriptorSets;
+    if (trackable) {
+        auto &bound = state.sets[firstSet];
+        if (
+            bound.set == descriptorSets[0] &&
+                bound.dynamicOffsets.size() == dynamicOffsetCount &&
+                std::equal(bound.dynamicOffsets.begin(), bound.dynamicOffsets.end(), dynamicOffsets)
+            ) {
+            ++stats.descriptorSets.skipped;
+            return;
+        }
+    }
+
+    commandBuffer.bindDescriptorSets(
+        bindPoint, layout, firstSet, descriptorSetCount, descriptorSets, dynamicOffsetCount, dynamicOffsets
+    );
+    ++stats.descriptorSets.issued;
+
+    if (trackable) {
+        auto &bound = state.sets[firstSet];
+        bound.set = descriptorSets[0];
+        bound.dynamicOffsets.assign(dynamicOffsets, dynamicOffsets + dynamicOffsetCount);
+    } else {
+        for (uint32_t set = firstSet; set < std::min(firstSet + descriptorSetCount, MaxDescriptorSets); ++set) {
+            state.sets[set] = {};
+        }
+    }
+}
+
+void CommandState::bindVertexBuffer(uint32_t binding, vk::Buffer buffer, vk::DeviceSize offset) {
+    if (binding < MaxVertexBindings) {
+        auto &bound = vertexBindings[binding];
+        if (bound.buffer == buffer && bound.offset == offset) {
+            ++stats.vertexBuffers.skipped;
+            return;
+        }
+
+        bound.buffer = buffer;
+        bound.offset = offset;
+    }
+
+    commandBuffer.bindVertexBuffers(binding, 1, &buffer, &offset);
+    ++stats.vertexBuffers.issued;
+}
+
+void CommandState::bindIndexBuffer(vk::Buffer buffer, vk::DeviceSize offset, vk::IndexType type) {
+    if (indexBuffer == buffer && indexOffset == offset && indexType == type) {
+        ++stats.indexBuffers.skipped;
+        return;
+    }
+
+    commandBuffer.bindIndexBuffer(buffer, offset, type);
+    indexBuffer = buffer;
+    indexOffset = offset;
+    indexType = type;
+    ++stats.indexBuffers.issued;
+}
+
+void CommandState::pushConstants(
+    vk::PipelineLayout layout, vk::ShaderStageFlags stages, uint32_t offset, uint32_t size, const void *data
+) {
+    if (pushLayout != layout) {
+        pushLayout = layout;
+        pushedRanges.clear();
+    }
+
+    auto bytes = static_cast<const uint8_t *>(data);
+    auto it = std::find_if(
+        pushedRanges.begin(), pushedRanges.end(), [&](const PushedRange &range) {
+            return range.stages == stages && range.offset == offset && range.data.size() == size;
+        }
+    );
+
+    if (it != pushedRanges.end() && std::memcmp(it->data.data(), bytes, size) == 0) {
+        ++stats.pushConstants.skipped;
+        return;
+    }
+
+    // Anything overlapping this range for the same stages no longer holds what was recorded
+    pushedRanges.erase(
+        std::remove_if(
+            pushedRanges.begin(), pushedRanges.end(), [&](const PushedRange &range) {
+                return (range.stages & stages) &&
+                    range.offset < offset + size && offset < range.offset + range.data.size();
+            }
+        ),
+        pushedRanges.end()
+    );
+    pushedRanges.push_back({ stages, offset, std::vector<uint8_t>(bytes, bytes + size) });
+
+    commandBuffer.pushConstants(layout, stages, offset, size, data);
+    ++stats.pushConstants.issued;
+}
+
+CommandState::BindPointState &CommandState::getBindPoint(vk::PipelineBindPoint bindPoint) {
+    if (bindPoint == vk::PipelineBindPoint::eCompute) {
+        return compute;
+    }
+
+    return graphics;
+}
+
+}
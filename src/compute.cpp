@@ -61,11 +61,19 @@ void ComputeTask::beginExecute() {
 }
 
 void ComputeTask::internalExecute(uint32_t xElements, uint32_t yElements, uint32_t zElements) {
+    setGroupCounts(xElements, yElements, zElements);
+    controller.queueCompute(*this);
+}
+
+void ComputeTask::internalExecuteBeforeRender(uint32_t xElements, uint32_t yElements, uint32_t zElements) {
+    setGroupCounts(xElements, yElements, zElements);
+    controller.dispatchBeforeRender(*this);
+}
+
+void ComputeTask::setGroupCounts(uint32_t xElements, uint32_t yElements, uint32_t zElements) {
     xGroupSize = xElements / xSize;
     yGroupSize = yElements / ySize;
     zGroupSize = zElements / zSize;
-
-    controller.queueCompute(*this);
 }
 
 void ComputeTask::bindImage(uint32_t binding, const std::shared_ptr<Image> &image) {
@@ -193,6 +201,20 @@ void ComputeTask::doAfterExecution(std::function<void()> newCallback) {
     callback = std::move(newCallback);
 }
 
+void ComputeTask::waitFor(const TimelinePoint &point, const vk::PipelineStageFlags &stages) {
+    waits.push_back({ point, stages });
+}
+
+std::vector<TimelineWait> ComputeTask::takeWaits() {
+    std::vector<TimelineWait> taken;
+    taken.swap(waits);
+    return taken;
+}
+
+void ComputeTask::notifySubmitted(const TimelinePoint &point) {
+    completion = point;
+}
+
 void ComputeTask::notifyComplete() {
     if (callback) {
         callback();
@@ -217,6 +239,10 @@ ComputeTaskBuilder &ComputeTaskBuilder::fromBytes(const char *bytes, size_t size
     return *this;
 }
 
+ComputeTaskBuilder &ComputeTaskBuilder::fromBytes(const unsigned char *bytes, size_t size, const char *symbol) {
+    return fromBytes(reinterpret_cast<const char *>(bytes), size, symbol);
+}
+
 ComputeTaskBuilder &ComputeTaskBuilder::fromBytes(const std::vector<char> &bytes, const char *symbol) {
     shaderBytes = bytes;
     entryPoint = symbol;
@@ -14,7 +14,7 @@ namespace Engine {
 VulkanDevice::VulkanDevice(vk::PhysicalDevice device, vk::Instance instance, vk::SurfaceKHR surface)
     : physicalDevice(device), surface(surface) {
     // Ensure extensions are available
-    if (!hasAllRequiredExtensions()) {
+    if (!hasAllRequiredExtensions() || !hasTimelineSemaphores()) {
         throw DeviceNotSuitable();
     }
 
@@ -29,17 +29,19 @@ VulkanDevice::VulkanDevice(vk::PhysicalDevice device, vk::Instance instance, vk:
     computeQueue.index = *indices.compute;
     transferQueue.index = *indices.transfer;
 
-    // Ensure the swap chain can be built
-    auto capabilities = physicalDevice.getSurfaceCapabilitiesKHR(surface);
-    auto formats = physicalDevice.getSurfaceFormatsKHR(surface);
-    auto presentModes = physicalDevice.getSurfacePresentModesKHR(surface);
-    vk::PhysicalDeviceFeatures currentFeatures;
-    physicalDevice.getFeatures(&currentFeatures);
+    // Ensure the swap chain can be built. Headless devices have nothing to present to
+    if (surface) {
+        auto formats = physicalDevice.getSurfaceFormatsKHR(surface);
+        auto presentModes = physicalDevice.getSurfacePresentModesKHR(surface);
 
-    if (formats.empty() || presentModes.empty()) {
-        throw DeviceNotSuitable();
+        if (formats.empty() || presentModes.empty()) {
+            throw DeviceNotSuitable();
+        }
     }
 
+    vk::PhysicalDeviceFeatures currentFeatures;
+    physicalDevice.getFeatures(&currentFeatures);
+
     // Device can now be initialised
     // Queues first
     std::vector<vk::DeviceQueueCreateInfo> queueCreation;
@@ -61,9 +63,12 @@ VulkanDevice::VulkanDevice(vk::PhysicalDevice device, vk::Instance instance, vk:
     vk::PhysicalDeviceFeatures deviceFeatures;
     deviceFeatures.setSamplerAnisotropy(VK_TRUE);
 
-    std::array<const char *, 1> extensions = {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME
-    };
+    std::vector<const char *> extensions;
+    if (surface) {
+        extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
+
+    vk::PhysicalDeviceTimelineSemaphoreFeatures timelineFeatures(VK_TRUE);
 
     vk::DeviceCreateInfo deviceCreateInfo(
         {},
@@ -73,6 +78,7 @@ VulkanDevice::VulkanDevice(vk::PhysicalDevice device, vk::Instance instance, vk:
         vkUseArray(extensions),
         &deviceFeatures
     );
+    deviceCreateInfo.setPNext(&timelineFeatures);
 
 #ifdef ENABLE_VALIDATION_LAYERS
     const std::array<const char *, 1> validationLayers = {
@@ -87,6 +93,18 @@ VulkanDevice::VulkanDevice(vk::PhysicalDevice device, vk::Instance instance, vk:
         deviceFeatures.setFillModeNonSolid(VK_TRUE);
     }
 
+    // Lets light volumes skip pixels beyond their range
+    if (currentFeatures.depthBounds) {
+        deviceFeatures.setDepthBounds(VK_TRUE);
+        supportsDepthBounds = true;
+    }
+
+    // GPU culling draws each group's instances from its offset into the visible instances
+    if (currentFeatures.drawIndirectFirstInstance) {
+        deviceFeatures.setDrawIndirectFirstInstance(VK_TRUE);
+        supportsDrawIndirectFirstInstance = true;
+    }
+
     this->device = physicalDevice.createDevice(deviceCreateInfo);
 
     graphicsQueue.queue = this->device.getQueue(graphicsQueue.index, 0);
@@ -94,6 +112,12 @@ VulkanDevice::VulkanDevice(vk::PhysicalDevice device, vk::Instance instance, vk:
     transferQueue.queue = this->device.getQueue(transferQueue.index, 0);
     computeQueue.queue = this->device.getQueue(computeQueue.index, 0);
 
+    // Timelines for tracking completion of work on each queue
+    vk::SemaphoreTypeCreateInfo timelineInfo(vk::SemaphoreType::eTimeline, 0);
+    for (auto queue : { &graphicsQueue, &presentQueue, &transferQueue, &computeQueue }) {
+        queue->timeline = this->device.createSemaphore({ {}, &timelineInfo });
+    }
+
     // Memory allocator
     VmaAllocatorCreateInfo allocInfo = {};
     allocInfo.physicalDevice = physicalDevice;
@@ -120,18 +144,13 @@ VulkanDevice::VulkanDevice(vk::PhysicalDevice device, vk::Instance instance, vk:
         // Reuse the graphics pool when they are a shared queue
         transferPool = graphicsPool;
     }
-
-    // Semaphores
-    renderFinished = this->device.createSemaphore({});
-    presentFinished = this->device.createSemaphore({});
-    computeFinished = this->device.createSemaphore({});
-    readyForCompute = this->device.createSemaphore({});
-
-    renderReady = this->device.createFence({ vk::FenceCreateFlagBits::eSignaled });
-    computeReady = this->device.createFence({ vk::FenceCreateFlagBits::eSignaled });
 }
 
 VulkanDevice::~VulkanDevice() {
+    for (auto queue : { &graphicsQueue, &presentQueue, &transferQueue, &computeQueue }) {
+        this->device.destroySemaphore(queue->timeline);
+    }
+
     this->device.destroyCommandPool(computePool);
     this->device.destroyCommandPool(graphicsPool);
 
@@ -139,13 +158,6 @@ VulkanDevice::~VulkanDevice() {
         this->device.destroyCommandPool(transferPool);
     }
 
-    this->device.destroySemaphore(renderFinished);
-    this->device.destroySemaphore(presentFinished);
-    this->device.destroySemaphore(computeFinished);
-    this->device.destroySemaphore(readyForCompute);
-    this->device.destroyFence(renderReady);
-    this->device.destroyFence(computeReady);
-
     if (allocator) {
         vmaDestroyAllocator(allocator);
     }
@@ -156,6 +168,11 @@ VulkanDevice::~VulkanDevice() {
 }
 
 bool VulkanDevice::hasAllRequiredExtensions() const {
+    if (!surface) {
+        // Only presentation needs extensions
+        return true;
+    }
+
     auto extensions = physicalDevice.enumerateDeviceExtensionProperties();
 
     bool hasSurface = false;
@@ -171,6 +188,18 @@ bool VulkanDevice::hasAllRequiredExtensions() const {
     return hasSurface;
 }
 
+bool VulkanDevice::hasTimelineSemaphores() const {
+    if (physicalDevice.getProperties().apiVersion < VK_API_VERSION_1_2) {
+        return false;
+    }
+
+    auto features = physicalDevice.getFeatures2<
+        vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceTimelineSemaphoreFeatures
+    >();
+
+    return features.get<vk::PhysicalDeviceTimelineSemaphoreFeatures>().timelineSemaphore;
+}
+
 VulkanDevice::VulkanQueueIndices VulkanDevice::findQueueIndices() const {
     auto properties = physicalDevice.getQueueFamilyProperties();
 
@@ -227,7 +256,10 @@ VulkanDevice::VulkanQueueIndices VulkanDevice::findQueueIndices() const {
 
 
             // Presentation. Try to put as part of the same queue as graphics
-            if (!presentIndex || !sharedPresent) {
+            if (!surface) {
+                // Headless, the present queue is only used as an alias of graphics
+                presentIndex = graphicsIndex;
+            } else if (!presentIndex || !sharedPresent) {
                 vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, index, surface, &canPresent);
                 if (canPresent) {
                     if (graphicsIndex && *graphicsIndex == index) {
@@ -253,4 +285,8 @@ void VulkanDevice::waitIdle() const {
     this->device.waitIdle();
 }
 
+bool VulkanDevice::hasReached(const TimelinePoint &point) const {
+    return this->device.getSemaphoreCounterValue(point.semaphore) >= point.value;
+}
+
 }
\ No newline at end of file
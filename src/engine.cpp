@@ -44,6 +44,8 @@
 
 const int WIDTH = 1920;
 const int HEIGHT = 1080;
+// Enough offscreen targets to cover every frame in flight
+const uint32_t HeadlessImageCount = 4;
 
 using std::cout, std::endl;
 
@@ -70,11 +72,30 @@ RenderEngine::~RenderEngine() {
 
 void RenderEngine::initialize(const std::string_view &title) {
     addSubsystem(Internal::RenderPlanner::ID);
+    getSubsystem(Internal::RenderPlanner::ID)->setEagerTransforms(eagerTransformUpdates);
 
-    initWindow(title);
+    if (!isHeadless()) {
+        initWindow(title);
+    }
     initVulkan();
 }
 
+void RenderEngine::setFramesInFlight(uint32_t count) {
+    if (executionController) {
+        throw std::runtime_error("Frames in flight must be set before initialization");
+    }
+
+    framesInFlight = std::clamp(count, 1u, 3u);
+}
+
+void RenderEngine::setHeadless(uint32_t width, uint32_t height) {
+    if (executionController) {
+        throw std::runtime_error("Headless mode must be set before initialization");
+    }
+
+    headlessExtent = vk::Extent2D { width, height };
+}
+
 void RenderEngine::initWindow(const std::string_view &title) {
     glfwInit();
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
@@ -96,7 +117,9 @@ void RenderEngine::framebufferResizeCallback(GLFWwindow *window, int width, int
 
 void RenderEngine::initVulkan() {
     createInstance();
-    createSurface();
+    if (!isHeadless()) {
+        createSurface();
+    }
 
     // Find a suitable GPU
     auto gpus = instance.enumeratePhysicalDevices();
@@ -120,21 +143,25 @@ void RenderEngine::initVulkan() {
     }
 
     // Init the swap chain
-    int width, height;
-    glfwGetFramebufferSize(window, &width, &height);
+    if (isHeadless()) {
+        createHeadlessSwapChain();
+    } else {
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
 
-    vk::Extent2D windowExtent = {
-        static_cast<uint32_t>(width),
-        static_cast<uint32_t>(height)
-    };
+        vk::Extent2D windowExtent = {
+            static_cast<uint32_t>(width),
+            static_cast<uint32_t>(height)
+        };
 
-    swapChain = std::make_unique<SwapChain>(physicalDevice, *device, surface, windowExtent);
+        swapChain = std::make_unique<SwapChain>(physicalDevice, *device, surface, windowExtent);
+    }
 
     // Other resources
-    bufferManager = std::make_unique<BufferManager>(*device);
+    bufferManager = std::make_unique<BufferManager>(*device, framesInFlight);
     taskManager = std::make_unique<TaskManager>(*device);
     textureManager = std::make_unique<TextureManager>(*this, *device, physicalDevice);
-    executionController = std::make_unique<ExecutionController>(*device, swapChain->size());
+    executionController = std::make_unique<ExecutionController>(*device, swapChain->size(), framesInFlight);
     descriptorManager = std::make_unique<Internal::DescriptorCacheManager>(*device);
 
     createAttachments();
@@ -157,10 +184,15 @@ void RenderEngine::initVulkan() {
             *taskManager,
             *fontManager,
             createPipeline(Subsystem::SubsystemLayer::Overlay),
-            swapChain->extent
+            swapChain->extent,
+            framesInFlight
         ));
 
     deferredPipeline = std::make_unique<Internal::DeferredPipeline>(*this, *device, *executionController);
+    deferredPipeline->setGpuCulling(gpuDrivenRendering);
+    deferredPipeline->setClusteredLighting(clusteredLighting);
+    deferredPipeline->setDepthPrepass(depthPrepass);
+    deferredPipeline->setLightingResolution(lightingResolution);
 
     if (effects.empty()) {
         deferredPipeline->recreateSwapChain(
@@ -189,6 +221,12 @@ void RenderEngine::recreateSwapChain() {
     cout << "Recreating swap chain" << endl;
 
     int width = 0, height = 0;
+    if (isHeadless()) {
+        // There is no window to wait on, the target keeps the size it was created with
+        width = static_cast<int>(headlessExtent->width);
+        height = static_cast<int>(headlessExtent->height);
+    }
+
     while (width == 0 || height == 0) {
         glfwGetFramebufferSize(window, &width, &height);
         glfwWaitEvents();
@@ -237,6 +275,19 @@ void RenderEngine::recreateSwapChain() {
     framebufferResized = false;
 }
 
+void RenderEngine::createHeadlessSwapChain() {
+    std::vector<std::shared_ptr<Image>> targets(HeadlessImageCount);
+    for (auto &target : targets) {
+        target = createImage(headlessExtent->width, headlessExtent->height)
+            .withFormat(vk::Format::eB8G8R8A8Unorm)
+            .withUsage(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc)
+            .withMemoryUsage(vk::MemoryUsage::eGPUOnly)
+            .build();
+    }
+
+    swapChain = std::make_unique<SwapChain>(*device, std::move(targets));
+}
+
 void RenderEngine::createSurface() {
     if (glfwCreateWindowSurface(instance, window, nullptr, &surface) != VK_SUCCESS) {
         throw std::runtime_error("Failed to create window surface");
@@ -255,18 +306,20 @@ void RenderEngine::createInstance() {
         VK_MAKE_VERSION(1, 0, 0),
         "No Engine",
         VK_MAKE_VERSION(1, 0, 0),
-        VK_API_VERSION_1_0
+        VK_API_VERSION_1_2
     );
 
     vk::InstanceCreateInfo createInfo;
     createInfo.setPApplicationInfo(&appInfo);
 
-    uint32_t glfwExtensionCount = 0;
-    const char **glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    if (!isHeadless()) {
+        uint32_t glfwExtensionCount = 0;
+        const char **glfwExtensions;
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-    createInfo.setEnabledExtensionCount(glfwExtensionCount);
-    createInfo.setPpEnabledExtensionNames(glfwExtensions);
+        createInfo.setEnabledExtensionCount(glfwExtensionCount);
+        createInfo.setPpEnabledExtensionNames(glfwExtensions);
+    }
 
 #ifdef ENABLE_VALIDATION_LAYERS
     createInfo.setEnabledLayerCount(static_cast<uint32_t>(validationLayers.size()));
@@ -487,7 +540,7 @@ void RenderEngine::createOverlayRenderPass() {
         vk::AttachmentLoadOp::eDontCare,
         vk::AttachmentStoreOp::eDontCare,
         vk::ImageLayout::eColorAttachmentOptimal,
-        vk::ImageLayout::ePresentSrcKHR
+        swapChain->getFinalLayout()
     );
 
     vk::AttachmentReference colorAttachmentRef(0, vk::ImageLayout::eColorAttachmentOptimal);
@@ -604,9 +657,9 @@ void RenderEngine::createFramebuffers() {
 
 
 void RenderEngine::createCommandBuffers() {
-    guiCommandBuffer = executionController->acquireSecondaryGraphicsCommandBuffer();
-    layerMain.commandBuffer = executionController->acquireSecondaryGraphicsCommandBuffer();
-    layerOverlay.commandBuffer = executionController->acquireSecondaryGraphicsCommandBuffer();
+    guiCommandBuffers = executionController->acquireSecondaryGraphicsCommandBuffers();
+    layerMain.commandBuffers = executionController->acquireSecondaryGraphicsCommandBuffers();
+    layerOverlay.commandBuffers = executionController->acquireSecondaryGraphicsCommandBuffers();
 }
 
 void RenderEngine::createUniformBuffers() {
@@ -683,7 +736,10 @@ void RenderEngine::createDepthResources() {
     auto builder = createImage(swapChain->extent.width, swapChain->extent.height)
         .withFormat(depthFormat)
         .withImageTiling(vk::ImageTiling::eOptimal)
-        .withUsage(vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eInputAttachment)
+        .withUsage(
+            vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eInputAttachment |
+                vk::ImageUsageFlagBits::eSampled
+        )
         .withMemoryUsage(vk::MemoryUsage::eGPUOnly)
         .withSampleCount(vk::SampleCountFlagBits::e1)
         .withMipLevels(1);
@@ -706,14 +762,16 @@ void RenderEngine::printExtensions() {
 }
 
 bool RenderEngine::beginFrame() {
-    if (glfwWindowShouldClose(window)) {
+    if (window && glfwWindowShouldClose(window)) {
         return false;
     }
 
     bufferManager->processActions();
     taskManager->processActions();
     inputManager.updateStates();
-    glfwPollEvents();
+    if (window) {
+        glfwPollEvents();
+    }
 
     for (auto &subsystem : orderedSubsystems) {
         subsystem->beginFrame();
@@ -738,19 +796,24 @@ void RenderEngine::fillFrameCommands(
 }
 
 void RenderEngine::drawFrame() {
-    device->device.waitForFences(1, &device->renderReady, VK_TRUE, std::numeric_limits<uint64_t>::max());
-    device->device.waitForFences(1, &device->computeReady, VK_TRUE, std::numeric_limits<uint64_t>::max());
+    executionController->waitForFrame();
 
     uint32_t imageIndex;
     try {
-        imageIndex = device->device.acquireNextImageKHR(
-            swapChain->swapChain, std::numeric_limits<uint64_t>::max(), device->presentFinished, vk::Fence()).value;
+        imageIndex = swapChain->acquire(executionController->getImageAvailableSemaphore());
     } catch (vk::OutOfDateKHRError const &e) {
         recreateSwapChain();
         return;
     }
 
+    // Uploads are submitted together ahead of the frame
+    taskManager->flush();
     executionController->startRender(imageIndex);
+    executionController->acquireResources(taskManager->takeHandOffs());
+
+    auto mainCommandBuffer = layerMain.commandBuffers[imageIndex];
+    auto overlayCommandBuffer = layerOverlay.commandBuffers[imageIndex];
+    auto guiCommandBuffer = guiCommandBuffers[imageIndex];
 
     for (auto &subsystem : orderedSubsystems) {
         subsystem->prepareFrame(imageIndex);
@@ -776,12 +839,12 @@ void RenderEngine::drawFrame() {
         vk::CommandBufferUsageFlagBits::eRenderPassContinue,
         &mainCbInheritance
     );
-    layerMain.commandBuffer.begin(renderBeginInfo);
+    mainCommandBuffer.begin(renderBeginInfo);
 
-    fillFrameCommands(layerMain.commandBuffer, imageIndex, Subsystem::SubsystemLayer::Main);
+    fillFrameCommands(mainCommandBuffer, imageIndex, Subsystem::SubsystemLayer::Main);
 
-    layerMain.commandBuffer.end();
-    executionController->addToRender(layerMain.commandBuffer);
+    mainCommandBuffer.end();
+    executionController->addToRender(mainCommandBuffer);
 
     // Do post processing effects
     uint32_t pass = 1;
@@ -797,11 +860,12 @@ void RenderEngine::drawFrame() {
             &cbInheritance
         );
 
-        effect->getCommandBuffer().begin(effectBeginInfo);
+        auto effectCommandBuffer = effect->getCommandBuffer(imageIndex);
+        effectCommandBuffer.begin(effectBeginInfo);
         executionController->nextSubpass();
-        effect->fillFrameCommands();
-        effect->getCommandBuffer().end();
-        executionController->addToRender(effect->getCommandBuffer());
+        effect->fillFrameCommands(imageIndex);
+        effectCommandBuffer.end();
+        executionController->addToRender(effectCommandBuffer);
         ++pass;
     }
 
@@ -822,28 +886,26 @@ void RenderEngine::drawFrame() {
         vk::CommandBufferUsageFlagBits::eRenderPassContinue,
         &overlayCbInheritance
     );
-    layerOverlay.commandBuffer.begin(overlayBeginInfo);
+    overlayCommandBuffer.begin(overlayBeginInfo);
 
     guiManager->render(guiCommandBuffer, overlayCbInheritance);
-    fillFrameCommands(layerOverlay.commandBuffer, imageIndex, Subsystem::SubsystemLayer::Overlay);
+    fillFrameCommands(overlayCommandBuffer, imageIndex, Subsystem::SubsystemLayer::Overlay);
 
-    layerOverlay.commandBuffer.end();
-    executionController->addToRender(layerOverlay.commandBuffer);
+    overlayCommandBuffer.end();
+    executionController->addToRender(overlayCommandBuffer);
     executionController->addToRender(guiCommandBuffer);
     executionController->endRenderPass();
 
+    // Anything recorded while building the frame must be submitted before it
+    taskManager->flush();
     executionController->endRender();
 
-    vk::PresentInfoKHR presentInfo(
-        1, &device->renderFinished,
-        1, &swapChain->swapChain,
-        &imageIndex
-    );
+    auto renderFinished = executionController->getRenderFinishedSemaphore();
 
     bool needsRecreateSwapChain = false;
     vk::Result result;
     try {
-        result = device->presentQueue.queue.presentKHR(presentInfo);
+        result = swapChain->present(imageIndex, renderFinished);
     } catch (vk::OutOfDateKHRError const &e) {
         result = vk::Result::eSuboptimalKHR;
     }
@@ -863,6 +925,8 @@ void RenderEngine::drawFrame() {
             throw std::runtime_error("failed to acquire swap chain image!");
     }
 
+    executionController->advanceFrame();
+
     for (auto &subsystem : orderedSubsystems) {
         subsystem->afterFrame(imageIndex);
     }
@@ -923,21 +987,25 @@ void RenderEngine::cleanup() {
     materialManager.reset();
     textureManager.reset();
 
-    // Release all remaining buffers
-    bufferManager->processActions();
+    // Release all remaining buffers. Tasks hold onto staging buffers so they go first
     taskManager.reset();
+    bufferManager->releaseAll();
     executionController.reset();
 
     intermediateAttachments.clear();
     swapChain->cleanup();
     swapChain.reset();
     device.reset();
-    instance.destroySurfaceKHR(surface);
+    if (surface) {
+        instance.destroySurfaceKHR(surface);
+    }
     instance.destroy();
 
-    glfwDestroyWindow(window);
-    glfwTerminate();
-    window = nullptr;
+    if (window) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        window = nullptr;
+    }
 }
 
 // ==============================================
@@ -1081,6 +1149,34 @@ vk::DescriptorBufferInfo RenderEngine::getCameraDBI(uint32_t imageIndex) {
     );
 }
 
+CommandStateStats RenderEngine::getCommandStats() const {
+    CommandStateStats stats;
+    if (deferredPipeline) {
+        stats += deferredPipeline->getCommandStats();
+    }
+    if (guiManager) {
+        stats += guiManager->getCommandStats();
+    }
+
+    return stats;
+}
+
+DepthPrepassStats RenderEngine::getDepthPrepassStats() const {
+    if (deferredPipeline) {
+        return deferredPipeline->getDepthPrepassStats();
+    }
+
+    return {};
+}
+
+uint32_t RenderEngine::getGpuVisibleInstances() const {
+    if (deferredPipeline) {
+        return deferredPipeline->getGpuVisibleInstances();
+    }
+
+    return 0;
+}
+
 Gui::Rect RenderEngine::getScreenBounds() {
     return {
         { 0, 0 },
@@ -1088,6 +1184,14 @@ Gui::Rect RenderEngine::getScreenBounds() {
     };
 }
 
+const std::shared_ptr<Image> &RenderEngine::getHeadlessTarget(uint32_t imageIndex) const {
+    if (!swapChain->isHeadless()) {
+        throw std::runtime_error("Offscreen targets are only available in headless mode");
+    }
+
+    return swapChain->getTarget(imageIndex);
+}
+
 EffectBuilder RenderEngine::createEffect(const std::string &name) {
     PipelineBuilder builder(
         *this,
@@ -1112,8 +1216,8 @@ EffectBuilder RenderEngine::createEffect(const std::string &name) {
 void RenderEngine::addEffect(const std::shared_ptr<Effect> &effect) {
     effects.push_back(effect);
     effectsByName[effect->getName()] = effect;
-    auto buffer = executionController->acquireSecondaryGraphicsCommandBuffer();
-    effect->applyCommandBuffer(buffer);
+    auto buffers = executionController->acquireSecondaryGraphicsCommandBuffers();
+    effect->applyCommandBuffers(buffers);
 
     if (layerMain.renderPass) {
         recreateSwapChain();
@@ -1140,4 +1244,45 @@ void RenderEngine::setScene(const std::shared_ptr<Scene> &scene) {
     currentScene->onSetActive({}, getSubsystem(Internal::RenderPlanner::ID));
 }
 
+void RenderEngine::setEagerTransformUpdates(bool eager) {
+    eagerTransformUpdates = eager;
+
+    auto planner = getSubsystem(Internal::RenderPlanner::ID);
+    if (planner) {
+        planner->setEagerTransforms(eager);
+    }
+}
+
+void RenderEngine::setGpuDrivenRendering(bool enabled) {
+    gpuDrivenRendering = enabled;
+
+    if (deferredPipeline) {
+        deferredPipeline->setGpuCulling(enabled);
+    }
+}
+
+void RenderEngine::setClusteredLighting(bool enabled) {
+    clusteredLighting = enabled;
+
+    if (deferredPipeline) {
+        deferredPipeline->setClusteredLighting(enabled);
+    }
+}
+
+void RenderEngine::setDepthPrepass(bool enabled) {
+    depthPrepass = enabled;
+
+    if (deferredPipeline) {
+        deferredPipeline->setDepthPrepass(enabled);
+    }
+}
+
+void RenderEngine::setLightingResolution(LightingResolution resolution) {
+    lightingResolution = resolution;
+
+    if (deferredPipeline) {
+        deferredPipeline->setLightingResolution(resolution);
+    }
+}
+
 }
@@ -3,10 +3,12 @@
 #include "tech-core/compute.hpp"
 #include "vulkanutils.hpp"
 #include <glm/glm.hpp>
+#include <limits>
 
 namespace Engine {
 
-ExecutionController::ExecutionController(VulkanDevice &device, uint32_t chainSize) : device(device) {
+ExecutionController::ExecutionController(VulkanDevice &device, uint32_t chainSize, uint32_t framesInFlight)
+    : device(device) {
     // Allocate primary command buffers
     vk::CommandBufferAllocateInfo graphicsAllocInfo(
         device.graphicsPool,
@@ -22,10 +24,26 @@ ExecutionController::ExecutionController(VulkanDevice &device, uint32_t chainSiz
     );
     primaryCommandBuffers.compute = device.device.allocateCommandBuffers(computeAllocInfo);
 
-    // Signal compute semaphore
+    imageFrames.resize(chainSize);
+
+    // Synchronisation for each frame in flight
+    frames.resize(framesInFlight);
+    for (auto &frame : frames) {
+        frame.imageAvailable = device.device.createSemaphore({});
+        frame.renderFinished = device.device.createSemaphore({});
+        frame.readyForCompute = device.device.createSemaphore({});
+        frame.computeFinished = device.device.createSemaphore({});
+
+        frame.renderReady = device.device.createFence({ vk::FenceCreateFlagBits::eSignaled });
+        frame.computeReady = device.device.createFence({ vk::FenceCreateFlagBits::eSignaled });
+    }
+
+    // Signal compute semaphore so the first frame has something to wait on
+    lastComputeFinished = frames.back().computeFinished;
+
     vk::SubmitInfo submitInfo;
     submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &device.computeFinished;
+    submitInfo.pSignalSemaphores = &lastComputeFinished;
     device.computeQueue.queue.submit(1, &submitInfo, {});
     device.device.waitIdle();
 }
@@ -38,9 +56,37 @@ ExecutionController::~ExecutionController() {
 
     device.device.freeCommandBuffers(device.graphicsPool, vkUseArray(primaryCommandBuffers.graphics));
     device.device.freeCommandBuffers(device.computePool, vkUseArray(primaryCommandBuffers.compute));
+
+    for (auto &frame : frames) {
+        device.device.destroySemaphore(frame.imageAvailable);
+        device.device.destroySemaphore(frame.renderFinished);
+        device.device.destroySemaphore(frame.readyForCompute);
+        device.device.destroySemaphore(frame.computeFinished);
+        device.device.destroyFence(frame.renderReady);
+        device.device.destroyFence(frame.computeReady);
+    }
+}
+
+void ExecutionController::waitForFrame() {
+    auto &frame = frames[currentFrame];
+    std::array<vk::Fence, 2> fences { frame.renderReady, frame.computeReady };
+    device.device.waitForFences(vkUseArray(fences), VK_TRUE, std::numeric_limits<uint64_t>::max());
+}
+
+void ExecutionController::advanceFrame() {
+    currentFrame = (currentFrame + 1) % frames.size();
 }
 
 void ExecutionController::startRender(uint32_t imageIndex) {
+    // The image may have been acquired out of order, so the frame that last used it could still be running
+    auto &previousFrame = imageFrames[imageIndex];
+    if (previousFrame && *previousFrame != currentFrame) {
+        auto &frame = frames[*previousFrame];
+        std::array<vk::Fence, 2> fences { frame.renderReady, frame.computeReady };
+        device.device.waitForFences(vkUseArray(fences), VK_TRUE, std::numeric_limits<uint64_t>::max());
+    }
+    previousFrame = currentFrame;
+
     currentGraphicsBuffer = primaryCommandBuffers.graphics[imageIndex];
     currentComputeBuffer = primaryCommandBuffers.compute[imageIndex];
 
@@ -51,6 +97,25 @@ void ExecutionController::startRender(uint32_t imageIndex) {
     fillComputeBuffers();
 }
 
+void ExecutionController::acquireResources(std::vector<QueueHandOff> &&handOffs) {
+    for (auto &handOff : handOffs) {
+        // Source stage is ignored for an acquire, the semaphore wait orders it
+        currentGraphicsBuffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eTopOfPipe, handOff.stages,
+            {},
+            0, nullptr,
+            vkUseArray(handOff.bufferBarriers),
+            vkUseArray(handOff.imageBarriers)
+        );
+
+        waitFor(handOff.point, handOff.stages);
+    }
+}
+
+void ExecutionController::waitFor(const TimelinePoint &point, const vk::PipelineStageFlags &stages) {
+    graphicsWaits.push_back({ point, stages });
+}
+
 void ExecutionController::beginRenderPass(
     vk::RenderPass pass, vk::Framebuffer framebuffer, vk::Extent2D screenExtent, const glm::vec4 &clear,
     uint32_t intermediateAttachments
@@ -100,11 +165,31 @@ void ExecutionController::endRender() {
     currentComputeBuffer.end();
 
     // TODO: Automatically work out the wait stages based on where bound resources depend on eachother
-    std::array<vk::PipelineStageFlags, 2> graphicsWaitStages {
+    std::vector<vk::PipelineStageFlags> graphicsWaitStages {
         vk::PipelineStageFlagBits::eVertexInput, vk::PipelineStageFlagBits::eColorAttachmentOutput
     };
-    std::array<vk::Semaphore, 2> graphicsWait { device.computeFinished, device.presentFinished };
-    std::array<vk::Semaphore, 2> graphicsSignal { device.renderFinished, device.readyForCompute };
+    auto &frame = frames[currentFrame];
+
+    std::vector<vk::Semaphore> graphicsWait { lastComputeFinished, frame.imageAvailable };
+    // Binary semaphores ignore their value
+    std::vector<uint64_t> graphicsWaitValues { 0, 0 };
+    for (auto &wait : graphicsWaits) {
+        graphicsWait.push_back(wait.point.semaphore);
+        graphicsWaitValues.push_back(wait.point.value);
+        graphicsWaitStages.push_back(wait.stages);
+    }
+    graphicsWaits.clear();
+
+    auto graphicsPoint = device.graphicsQueue.nextTimelinePoint();
+    std::array<vk::Semaphore, 3> graphicsSignal {
+        frame.renderFinished, frame.readyForCompute, graphicsPoint.semaphore
+    };
+    std::array<uint64_t, 3> graphicsSignalValues { 0, 0, graphicsPoint.value };
+
+    vk::TimelineSemaphoreSubmitInfo graphicsTimelineInfo(
+        vkUseArray(graphicsWaitValues),
+        vkUseArray(graphicsSignalValues)
+    );
 
     vk::SubmitInfo graphicsSubmitInfo(
         vkUseArray(graphicsWait),
@@ -112,24 +197,48 @@ void ExecutionController::endRender() {
         1, &currentGraphicsBuffer,
         vkUseArray(graphicsSignal)
     );
+    graphicsSubmitInfo.setPNext(&graphicsTimelineInfo);
 
-    device.device.resetFences(1, &device.renderReady);
-    device.graphicsQueue.queue.submit(1, &graphicsSubmitInfo, device.renderReady);
+    device.device.resetFences(1, &frame.renderReady);
+    device.graphicsQueue.queue.submit(1, &graphicsSubmitInfo, frame.renderReady);
 
     // fire off the compute stage
-    std::array<vk::Semaphore, 1> computeWait { device.readyForCompute };
-    vk::PipelineStageFlags computeWaitStage = vk::PipelineStageFlagBits::eComputeShader;
+    std::vector<vk::Semaphore> computeWait { frame.readyForCompute };
+    std::vector<uint64_t> computeWaitValues { 0 };
+    std::vector<vk::PipelineStageFlags> computeWaitStages { vk::PipelineStageFlagBits::eComputeShader };
+    for (auto task : queuedComputeTasks) {
+        for (auto &wait : task->takeWaits()) {
+            computeWait.push_back(wait.point.semaphore);
+            computeWaitValues.push_back(wait.point.value);
+            computeWaitStages.push_back(wait.stages);
+        }
+    }
+
+    auto computePoint = device.computeQueue.nextTimelinePoint();
+    std::array<vk::Semaphore, 2> computeSignal { frame.computeFinished, computePoint.semaphore };
+    std::array<uint64_t, 2> computeSignalValues { 0, computePoint.value };
+
+    vk::TimelineSemaphoreSubmitInfo computeTimelineInfo(
+        vkUseArray(computeWaitValues),
+        vkUseArray(computeSignalValues)
+    );
+
     vk::SubmitInfo computeSubmitInfo(
         vkUseArray(computeWait),
-        &computeWaitStage,
+        computeWaitStages.data(),
         1, &currentComputeBuffer,
-        1, &device.computeFinished
+        vkUseArray(computeSignal)
     );
+    computeSubmitInfo.setPNext(&computeTimelineInfo);
+
+    device.device.resetFences(1, &frame.computeReady);
+    device.computeQueue.queue.submit(1, &computeSubmitInfo, frame.computeReady);
 
-    device.device.resetFences(1, &device.computeReady);
-    device.computeQueue.queue.submit(1, &computeSubmitInfo, device.computeReady);
+    // The next frame continues the chain from here
+    lastComputeFinished = frame.computeFinished;
 
     for (auto task : queuedComputeTasks) {
+        task->notifySubmitted(computePoint);
         task->notifyComplete();
     }
     queuedComputeTasks.clear();
@@ -149,6 +258,30 @@ void ExecutionController::queueCompute(ComputeTask &task) {
     queuedComputeTasks.push_back(&task);
 }
 
+void ExecutionController::dispatchBeforeRender(ComputeTask &task) {
+    for (auto &wait : task.takeWaits()) {
+        graphicsWaits.push_back(wait);
+    }
+
+    // The graphics queue is chosen without checking for compute support, but in practice always has it
+    task.fillCommandBuffer(currentGraphicsBuffer);
+
+    // The host may also read the results once the frame is complete
+    vk::MemoryBarrier barrier(
+        vk::AccessFlagBits::eShaderWrite,
+        vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eHostRead
+    );
+    currentGraphicsBuffer.pipelineBarrier(
+        vk::PipelineStageFlagBits::eComputeShader,
+        vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexShader |
+            vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eHost,
+        {},
+        1, &barrier,
+        0, nullptr,
+        0, nullptr
+    );
+}
+
 vk::CommandBuffer ExecutionController::acquireSecondaryGraphicsCommandBuffer() {
     vk::CommandBufferAllocateInfo allocInfo(
         device.graphicsPool,
@@ -160,6 +293,17 @@ vk::CommandBuffer ExecutionController::acquireSecondaryGraphicsCommandBuffer() {
     return buffers[0];
 }
 
+std::vector<vk::CommandBuffer> ExecutionController::acquireSecondaryGraphicsCommandBuffers() {
+    vk::CommandBufferAllocateInfo allocInfo(
+        device.graphicsPool,
+        vk::CommandBufferLevel::eSecondary,
+        static_cast<uint32_t>(primaryCommandBuffers.graphics.size())
+    );
+    auto buffers = device.device.allocateCommandBuffers(allocInfo);
+    secondaryCommandBuffers.graphics.insert(secondaryCommandBuffers.graphics.end(), buffers.begin(), buffers.end());
+    return buffers;
+}
+
 vk::CommandBuffer ExecutionController::acquireSecondaryComputeCommandBuffer() {
     vk::CommandBufferAllocateInfo allocInfo(
         device.computePool,
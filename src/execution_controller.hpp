@@ -2,8 +2,11 @@
 
 #include "tech-core/forward.hpp"
 #include "tech-core/subsystem/base.hpp"
+#include "tech-core/task.hpp"
 #include <vulkan/vulkan.hpp>
 #include <glm/fwd.hpp>
+#include <optional>
+#include <vector>
 
 namespace Engine {
 
@@ -30,14 +33,54 @@ enum class BindPoint {
 
 class ExecutionController {
 public:
-    ExecutionController(VulkanDevice &device, uint32_t chainSize);
+    ExecutionController(VulkanDevice &device, uint32_t chainSize, uint32_t framesInFlight);
     ~ExecutionController();
 
     vk::CommandBuffer acquireSecondaryGraphicsCommandBuffer();
     vk::CommandBuffer acquireSecondaryComputeCommandBuffer();
+    /**
+     * Allocates a secondary command buffer for each swap chain image.
+     * Command buffers used for rendering must not be shared between images as
+     * another frame may still be executing.
+     */
+    std::vector<vk::CommandBuffer> acquireSecondaryGraphicsCommandBuffers();
+
+    uint32_t getFramesInFlight() const { return static_cast<uint32_t>(frames.size()); }
+
+    /**
+     * Waits until the GPU has finished with the oldest frame in flight
+     * so that its synchronisation objects can be reused.
+     */
+    void waitForFrame();
+    /**
+     * The semaphore to be signalled when the swap chain image is available
+     */
+    vk::Semaphore getImageAvailableSemaphore() const { return frames[currentFrame].imageAvailable; }
+    /**
+     * The semaphore signalled once rendering is finished. Presentation must wait on this
+     */
+    vk::Semaphore getRenderFinishedSemaphore() const { return frames[currentFrame].renderFinished; }
 
+    /**
+     * Begins recording for the swap chain image.
+     * This waits until any previous frame that used this image is complete.
+     * All resources indexed by the image index may be safely updated after this.
+     */
     void startRender(uint32_t imageIndex);
+    /**
+     * Acquires resources released by transfer tasks.
+     * The frame will wait for the transfers to complete before it uses them.
+     */
+    void acquireResources(std::vector<QueueHandOff> &&handOffs);
+    /**
+     * Prevents the given stages of this frame's rendering from running until the point is reached
+     */
+    void waitFor(const TimelinePoint &point, const vk::PipelineStageFlags &stages);
     void endRender();
+    /**
+     * Moves on to the next frame in flight. Call after the frame has been presented
+     */
+    void advanceFrame();
 
     // Render pipeline
     void beginRenderPass(
@@ -51,6 +94,12 @@ public:
 
     // Compute pipeline
     void queueCompute(ComputeTask &);
+    /**
+     * Records the task into the graphics commands of this frame, followed by a barrier
+     * that makes its writes visible to indirect draws and shaders.
+     * Must be called before the render pass begins.
+     */
+    void dispatchBeforeRender(ComputeTask &);
 
     /**
      * Marks a resource as used within this frame. This will handle automatic memory barriers, layout transitions,
@@ -79,6 +128,17 @@ private:
     VulkanDevice &device;
 
     // Owned resources
+    struct FrameSync {
+        vk::Semaphore imageAvailable;
+        vk::Semaphore renderFinished;
+        vk::Semaphore readyForCompute;
+        vk::Semaphore computeFinished;
+        vk::Fence renderReady;
+        vk::Fence computeReady;
+    };
+
+    std::vector<FrameSync> frames;
+
     struct {
         std::vector<vk::CommandBuffer> graphics;
         std::vector<vk::CommandBuffer> compute;
@@ -93,7 +153,14 @@ private:
     vk::CommandBuffer currentComputeBuffer;
     uint32_t activeIndex { 0 };
 
+    // Frames in flight
+    uint32_t currentFrame { 0 };
+    vk::Semaphore lastComputeFinished;
+    // The frame which last rendered to each swap chain image
+    std::vector<std::optional<uint32_t>> imageFrames;
+
     std::vector<ComputeTask *> queuedComputeTasks;
+    std::vector<TimelineWait> graphicsWaits;
 
     void fillComputeBuffers();
 };
@@ -15,13 +15,15 @@ GuiManager::GuiManager(
     Engine::TaskManager &taskManager,
     Engine::FontManager &fontManager,
     Engine::PipelineBuilder pipelineBuilder,
-    const vk::Extent2D &windowSize
+    const vk::Extent2D &windowSize,
+    uint32_t framesInFlight
 ) : device(device),
     textureManager(textureManager),
     bufferManager(bufferManager),
     taskManager(taskManager),
     fontManager(fontManager),
-    windowSize(windowSize) {
+    windowSize(windowSize),
+    framesInFlight(framesInFlight) {
     recreatePipeline(pipelineBuilder, windowSize);
 
     combinedVertexIndexBuffer = bufferManager.aquireDivisible(
@@ -100,7 +102,7 @@ void GuiManager::removeComponent(uint16_t id) {
     // Free used sections
     auto mapping = it->second;
     for (auto &region : mapping.regions) {
-        combinedVertexIndexBuffer->freeSection(region.offset, region.size);
+        releaseRegion(region);
     }
 
     components.erase(it);
@@ -124,7 +126,7 @@ void GuiManager::renderComponent(BaseComponent *component, ComponentMapping &map
 
     // Remove all previously existing regions
     for (auto &region : mapping.regions) {
-        combinedVertexIndexBuffer->freeSection(region.offset, region.size);
+        releaseRegion(region);
     }
 
     mapping.regions.clear();
@@ -145,8 +147,8 @@ void GuiManager::renderComponent(BaseComponent *component, ComponentMapping &map
         vk::DeviceSize indexOffset;
         vk::DeviceSize size = vertexSize + indexSize;
 
-        // New buffer region
-        offset = combinedVertexIndexBuffer->allocateSection(size);
+        // New buffer region. The alignment keeps the indices that follow the vertices aligned
+        offset = combinedVertexIndexBuffer->allocateSection(size, std::max(alignof(Vertex), sizeof(GuiBufferInt)));
         if (offset == ALLOCATION_FAILED) {
             throw std::runtime_error("Out of GUI buffer memory");
         }
@@ -184,7 +186,30 @@ void GuiManager::markComponentDirty(uint16_t id) {
     dirtyComponents.push_back(id);
 }
 
+void GuiManager::releaseRegion(const ComponentMapping::Region &region) {
+    if (releasedRegions.empty()) {
+        releasedRegions.emplace_back();
+    }
+
+    releasedRegions.back().push_back(region.offset);
+}
+
+void GuiManager::retireReleasedRegions() {
+    // Regions released after the previous update may have been drawn by the frame submitted since.
+    // That frame is only known to be finished once framesInFlight more frames have been started
+    releasedRegions.emplace_back();
+
+    while (releasedRegions.size() > framesInFlight + 1) {
+        for (auto offset : releasedRegions.front()) {
+            combinedVertexIndexBuffer->freeSection(offset);
+        }
+        releasedRegions.pop_front();
+    }
+}
+
 void GuiManager::update() {
+    retireReleasedRegions();
+
     // Update all components
     Rect windowBounds = {{ 0, 0 }, { windowSize.width, windowSize.height }};
 
@@ -215,9 +240,14 @@ void GuiManager::render(vk::CommandBuffer commandBuffer, vk::CommandBufferInheri
         &cbInheritance
     );
     commandBuffer.begin(beginInfo);
+    commandState.resetStats();
+    commandState.begin(commandBuffer);
+
+    pipeline->bind(commandState);
+    pipeline->push(commandState, vk::ShaderStageFlagBits::eVertex, viewState);
 
-    pipeline->bind(commandBuffer);
-    pipeline->push(commandBuffer, vk::ShaderStageFlagBits::eVertex, viewState);
+    // Every region shares the one index buffer, so it is bound once and regions are selected by their first index
+    commandState.bindIndexBuffer(combinedVertexIndexBuffer->buffer(), 0, vk::IndexType::eUint16);
     bool hasBoundTexture = false;
 //
 //    // Wait for any changes to be propagated before rendering
@@ -241,22 +271,20 @@ void GuiManager::render(vk::CommandBuffer commandBuffer, vk::CommandBufferInheri
 
         for (auto &region : component.regions) {
             // Vertex info
-            commandBuffer.bindVertexBuffers(0, 1, combinedVertexIndexBuffer->bufferArray(), &region.offset);
-            commandBuffer.bindIndexBuffer(
-                combinedVertexIndexBuffer->buffer(), region.indexOffset, vk::IndexType::eUint16
-            );
+            commandState.bindVertexBuffer(0, combinedVertexIndexBuffer->buffer(), region.offset);
 
             // texture info
             if (region.texture) {
-                pipeline->bindTexture(commandBuffer, 0, region.texture);
+                pipeline->bindTexture(commandState, 0, region.texture);
                 hasBoundTexture = true;
             } else if (!hasBoundTexture) {
                 // It is required that all bindings have a value, even if we wont use one
-                pipeline->bindTexture(commandBuffer, 0, textureManager.get("internal.white"));
+                pipeline->bindTexture(commandState, 0, textureManager.get("internal.white"));
                 hasBoundTexture = true;
             }
 
-            commandBuffer.drawIndexed(region.indexCount, 1, 0, 0, 0);
+            auto firstIndex = static_cast<uint32_t>(region.indexOffset / sizeof(GuiBufferInt));
+            commandBuffer.drawIndexed(region.indexCount, 1, firstIndex, 0, 0);
         }
     }
 
@@ -70,6 +70,28 @@ void Image::transferInOffset(
     );
 }
 
+void Image::transferIn(
+    vk::CommandBuffer commandBuffer, const StagingBuffer &source, uint32_t layer, uint32_t mipLevel
+) {
+    transferInOffset(commandBuffer, source.getBuffer(), source.getOffset(), {}, { width, height }, layer, mipLevel);
+}
+
+void Image::transferIn(
+    vk::CommandBuffer commandBuffer, const StagingBuffer &source, vk::Offset2D offset, vk::Extent2D extent,
+    uint32_t layer, uint32_t mipLevel
+) {
+    transferInOffset(commandBuffer, source.getBuffer(), source.getOffset(), offset, extent, layer, mipLevel);
+}
+
+void Image::transferInOffset(
+    vk::CommandBuffer commandBuffer, const StagingBuffer &source, vk::DeviceSize bufferOffset, vk::Offset2D offset,
+    vk::Extent2D extent, uint32_t layer, uint32_t mipLevel
+) {
+    transferInOffset(
+        commandBuffer, source.getBuffer(), source.getOffset() + bufferOffset, offset, extent, layer, mipLevel
+    );
+}
+
 void Image::transferOut(vk::CommandBuffer commandBuffer, Buffer *buffer, uint32_t layer) {
     vk::BufferImageCopy region(
         0,
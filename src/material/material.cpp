@@ -1,10 +1,15 @@
 #include "tech-core/material/material.hpp"
 #include "tech-core/material/builder.hpp"
 
+#include <atomic>
+
 namespace Engine {
 
+std::atomic<uint32_t> nextMaterialSortId { 0 };
+
 Material::Material(const MaterialBuilder &builder)
-    : name(builder.getName()) {
+    : name(builder.getName()),
+    sortId(nextMaterialSortId++) {
     albedo = builder.albedo;
     albedoColor = builder.albedoColor;
     normal = builder.normal;
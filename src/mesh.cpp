@@ -1,25 +1,33 @@
 #include "tech-core/mesh.hpp"
 #include "tech-core/model.hpp"
 
+#include <atomic>
 #include <stdexcept>
 #include <unordered_map>
 #include <iostream>
 
 namespace Engine {
 
+std::atomic<uint32_t> nextMeshSortId { 0 };
+
+Mesh::Mesh()
+    : sortId(nextMeshSortId++) {}
+
 StaticMesh::StaticMesh(
     BufferManager& bufferManager,
     std::unique_ptr<Buffer> &combinedBuffer,
     vk::DeviceSize vertexOffset,
     vk::DeviceSize indexOffset,
     uint32_t indicesCount,
-    vk::IndexType indexType
+    vk::IndexType indexType,
+    const std::optional<BoundingBox> &bounds
 ) : bufferManager(bufferManager),
     combinedBuffer(std::move(combinedBuffer)), 
     vertexOffset(vertexOffset),
     indexOffset(indexOffset),
     indexCount(indicesCount),
-    indexType(indexType)
+    indexType(indexType),
+    bounds(bounds)
 {}
 
 StaticMesh::~StaticMesh() {
@@ -31,5 +39,10 @@ void StaticMesh::bind(vk::CommandBuffer commandBuffer) const {
     commandBuffer.bindIndexBuffer(combinedBuffer->buffer(), indexOffset, indexType);
 }
 
+void StaticMesh::bind(CommandState &state) const {
+    state.bindVertexBuffer(0, combinedBuffer->buffer(), vertexOffset);
+    state.bindIndexBuffer(combinedBuffer->buffer(), indexOffset, indexType);
+}
+
 
 }
\ No newline at end of file
@@ -156,6 +156,7 @@ void Model::applyCombined(StaticMeshBuilder<Vertex> &meshBuilder) const {
 
     meshBuilder.withVertices(vertices);
     meshBuilder.withIndices(indices);
+    meshBuilder.withBounds(overallBounds);
 }
 
 void Model::applySubModel(StaticMeshBuilder<Vertex> &meshBuilder, const std::string &name) const {
@@ -168,6 +169,7 @@ void Model::applySubModel(StaticMeshBuilder<Vertex> &meshBuilder, const std::str
 
     meshBuilder.withVertices(subModel.vertices);
     meshBuilder.withIndices(subModel.indices);
+    meshBuilder.withBounds(subModel.bounds);
 }
 
 void Model::getMeshData(
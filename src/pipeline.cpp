@@ -149,6 +149,19 @@ PipelineBuilder &PipelineBuilder::withoutDepthTest() {
     return *this;
 }
 
+PipelineBuilder &PipelineBuilder::withDepthCompare(vk::CompareOp op) {
+    depthCompareOp = op;
+
+    return *this;
+}
+
+PipelineBuilder &PipelineBuilder::withDepthBoundsTest() {
+    depthBoundsTestEnable = true;
+    dynamicState.push_back(vk::DynamicState::eDepthBounds);
+
+    return *this;
+}
+
 PipelineBuilder &PipelineBuilder::withAlpha() {
     withColorBlend(vk::BlendOp::eAdd, vk::BlendFactor::eSrcAlpha, vk::BlendFactor::eOneMinusDstAlpha);
     withAlphaBlend(vk::BlendOp::eAdd, vk::BlendFactor::eOne, vk::BlendFactor::eZero);
@@ -192,7 +205,7 @@ PipelineBuilder &PipelineBuilder::withColorMask(const vk::ColorComponentFlags &m
     return *this;
 }
 
-PipelineBuilder &PipelineBuilder::bindCamera(uint32_t set, uint32_t binding) {
+PipelineBuilder &PipelineBuilder::bindCamera(uint32_t set, uint32_t binding, const vk::ShaderStageFlags &stages) {
     bindings.emplace_back(
         PipelineBinding {
             set,
@@ -202,7 +215,7 @@ PipelineBuilder &PipelineBuilder::bindCamera(uint32_t set, uint32_t binding) {
                 binding,
                 vk::DescriptorType::eUniformBuffer,
                 1,
-                vk::ShaderStageFlagBits::eVertex
+                stages
             },
             SpecialBinding::Camera
         }
@@ -524,6 +537,24 @@ PipelineBuilder &PipelineBuilder::bindUniformBufferDynamic(
     return *this;
 }
 
+PipelineBuilder &
+PipelineBuilder::bindStorageBufferPerImage(uint32_t set, uint32_t binding, const vk::ShaderStageFlags &stages) {
+    bindings.emplace_back(
+        PipelineBinding {
+            set,
+            binding,
+            BindingCount::PerSwapChain,
+            {
+                binding,
+                vk::DescriptorType::eStorageBuffer,
+                1,
+                stages
+            }
+        }
+    );
+    return *this;
+}
+
 PipelineBuilder &PipelineBuilder::bindSampledImagePool(
     uint32_t set, uint32_t binding, uint32_t size, const vk::ShaderStageFlags &stages, vk::Sampler sampler
 ) {
@@ -998,8 +1029,8 @@ std::unique_ptr<Pipeline> PipelineBuilder::build() {
         {},
         depthTestEnable,
         depthWriteEnable,
-        vk::CompareOp::eLess,
-        VK_FALSE,
+        depthCompareOp,
+        depthBoundsTestEnable,
         VK_FALSE,
         {},
         {},
@@ -1114,36 +1145,55 @@ Pipeline::~Pipeline() {
 }
 
 void Pipeline::bind(vk::CommandBuffer commandBuffer, uint32_t activeImage) {
-    if (!descriptorUpdates.empty()) {
-        device.updateDescriptorSets(descriptorUpdates, {});
-
-        for (auto &update : descriptorUpdates) {
-            delete update.pImageInfo;
-            delete update.pBufferInfo;
-        }
-
-        descriptorUpdates.clear();
-    }
+    flushDescriptorUpdates();
 
     commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, resources.pipeline);
 
     // Ensure that all resources are in the correct states
 
     // Now bind all descriptor sets
-    uint32_t setIndex = 0;
-    for (auto &descriptorSets : resources.descriptorSets) {
-        if (!descriptorSets.empty() && resources.autoBindSet[setIndex]) {
-            vk::DescriptorSet set;
-
-            if (descriptorSets.size() == 1) {
-                set = descriptorSets[0];
-            } else {
-                set = descriptorSets[activeImage];
-            }
-
+    for (uint32_t setIndex = 0; setIndex < resources.descriptorSets.size(); ++setIndex) {
+        if (!resources.descriptorSets[setIndex].empty() && resources.autoBindSet[setIndex]) {
+            auto set = getAutoBindSet(setIndex, activeImage);
             bindDescriptorSets(commandBuffer, setIndex, 1, &set, 0, nullptr);
         }
-        ++setIndex;
+    }
+}
+
+void Pipeline::bind(CommandState &state, uint32_t activeImage) {
+    flushDescriptorUpdates();
+
+    state.bindPipeline(vk::PipelineBindPoint::eGraphics, resources.pipeline);
+
+    for (uint32_t setIndex = 0; setIndex < resources.descriptorSets.size(); ++setIndex) {
+        if (!resources.descriptorSets[setIndex].empty() && resources.autoBindSet[setIndex]) {
+            auto set = getAutoBindSet(setIndex, activeImage);
+            bindDescriptorSets(state, setIndex, 1, &set, 0, nullptr);
+        }
+    }
+}
+
+void Pipeline::flushDescriptorUpdates() {
+    if (descriptorUpdates.empty()) {
+        return;
+    }
+
+    device.updateDescriptorSets(descriptorUpdates, {});
+
+    for (auto &update : descriptorUpdates) {
+        delete update.pImageInfo;
+        delete update.pBufferInfo;
+    }
+
+    descriptorUpdates.clear();
+}
+
+vk::DescriptorSet Pipeline::getAutoBindSet(uint32_t set, uint32_t activeImage) const {
+    auto &descriptorSets = resources.descriptorSets[set];
+    if (descriptorSets.size() == 1) {
+        return descriptorSets[0];
+    } else {
+        return descriptorSets[activeImage];
     }
 }
 
@@ -1161,6 +1211,20 @@ void Pipeline::bindDescriptorSets(
     );
 }
 
+void Pipeline::bindDescriptorSets(
+    CommandState &state, uint32_t firstSet,
+    uint32_t descriptorSetCount, const vk::DescriptorSet *descriptorSets,
+    uint32_t dynamicOffsetCount, const uint32_t *dynamicOffsets
+) {
+    state.bindDescriptorSets(
+        vk::PipelineBindPoint::eGraphics,
+        resources.layout,
+        firstSet,
+        descriptorSetCount, descriptorSets,
+        dynamicOffsetCount, dynamicOffsets
+    );
+}
+
 void Pipeline::bindImage(uint32_t set, uint32_t binding, const std::shared_ptr<Image> &image) {
     boundImages[binding] = image;
     auto &config = bindings[binding];
@@ -1242,6 +1306,29 @@ void Pipeline::bindBuffer(uint32_t set, uint32_t binding, const std::shared_ptr<
     }
 }
 
+void Pipeline::bindBuffer(uint32_t set, uint32_t binding, uint32_t index, const Buffer &buffer) {
+    auto &config = bindings[binding];
+
+    // Update the descriptor
+    auto *bufferInfo = new vk::DescriptorBufferInfo(
+        buffer.buffer(),
+        0,
+        buffer.getSize()
+    );
+
+    descriptorUpdates.emplace_back(
+        vk::WriteDescriptorSet(
+            resources.descriptorSets[set][index],
+            binding,
+            0,
+            1,
+            config.type,
+            nullptr,
+            bufferInfo
+        )
+    );
+}
+
 void Pipeline::bindCamera(uint32_t set, uint32_t binding, RenderEngine &engine) {
     auto &config = bindings[binding];
     auto descriptorSets = resources.descriptorSets[set];
@@ -1270,6 +1357,12 @@ void Pipeline::bindTexture(vk::CommandBuffer commandBuffer, uint32_t binding, co
     bindDescriptorSets(commandBuffer, set, 1, &descriptor, 0, nullptr);
 }
 
+void Pipeline::bindTexture(CommandState &state, uint32_t binding, const Texture *texture) {
+    auto descriptor = textureDescriptorCaches[binding]->get(texture);
+    auto set = bindings[binding].set;
+    bindDescriptorSets(state, set, 1, &descriptor, 0, nullptr);
+}
+
 void Pipeline::bindMaterial(vk::CommandBuffer commandBuffer, const Material *material) {
     if (bindingMaterialAlbedo) {
         auto albedoTexture = material->getAlbedo();
@@ -1282,6 +1375,16 @@ void Pipeline::bindMaterial(vk::CommandBuffer commandBuffer, const Material *mat
     }
 }
 
+void Pipeline::bindMaterial(CommandState &state, const Material *material) {
+    if (bindingMaterialAlbedo) {
+        bindTexture(state, *bindingMaterialAlbedo, material->getAlbedo());
+    }
+
+    if (bindingMaterialNormal) {
+        bindTexture(state, *bindingMaterialNormal, material->getNormal());
+    }
+}
+
 void Pipeline::bindPoolImage(vk::CommandBuffer commandBuffer, uint32_t set, uint32_t binding, uint32_t index) {
     auto descriptorSets = resources.descriptorSets[set];
     bindDescriptorSets(commandBuffer, set, 1, &descriptorSets[index], 0, nullptr);
@@ -1,10 +1,14 @@
 #include <scene/bindings.hpp>
 #include "deferred_pipeline.hpp"
 #include "tech-core/engine.hpp"
+#include "tech-core/camera.hpp"
+#include "tech-core/compute.hpp"
+#include "tech-core/buffer.hpp"
 #include "tech-core/device.hpp"
 #include "tech-core/image.hpp"
 #include "tech-core/mesh.hpp"
 #include "tech-core/material/manager.hpp"
+#include "tech-core/material/material.hpp"
 #include "tech-core/scene/entity.hpp"
 #include "tech-core/scene/components/mesh_renderer.hpp"
 #include "tech-core/scene/components/light.hpp"
@@ -15,13 +19,22 @@
 #include "internal/packaged/builtin_deferred_lighting_vert_glsl.h"
 #include "internal/packaged/builtin_deferred_geom_frag_glsl.h"
 #include "internal/packaged/builtin_standard_vert_glsl.h"
+#include "internal/packaged/builtin_instance_cull_comp_glsl.h"
+#include "internal/packaged/builtin_light_cluster_comp_glsl.h"
+#include "internal/packaged/builtin_depth_prepass_vert_glsl.h"
+#include "internal/packaged/builtin_depth_prepass_frag_glsl.h"
+#include "internal/packaged/builtin_deferred_lighting_reduced_frag_glsl.h"
+#include "internal/packaged/builtin_deferred_upsample_frag_glsl.h"
 #include "execution_controller.hpp"
+#include "light_volumes.hpp"
+#include <glm/gtx/quaternion.hpp>
+#include <algorithm>
+#include <cmath>
 
 namespace Engine::Internal {
 
 enum DeferredAttachments {
     CombinedOutput,
-    Position,
     NormalRoughness,
     DiffuseOcclusion,
     Depth,
@@ -32,26 +45,138 @@ enum DeferredPasses {
     LightingPass
 };
 
+// Instances reserved up front for each swap chain image
+const size_t MinInstanceCapacity = 1024;
+// Draw groups reserved up front for each swap chain image
+const size_t MinDrawGroupCapacity = 64;
+// Matches local_size_x in instance_cull_comp.glsl
+const uint32_t CullGroupSize = 64;
+
+enum CullBindings {
+    CullCandidates = 0,
+    CullGroups = 1,
+    CullDraws = 2,
+    CullVisible = 3,
+    CullCounters = 4,
+    CullEntities = 5,
+};
+
+// Matches the cluster constants in light_cluster_comp.glsl and deferred_lighting_frag.glsl
+const uint32_t ClustersX = 16;
+const uint32_t ClustersY = 9;
+const uint32_t ClustersZ = 24;
+const uint32_t ClusterCount = ClustersX * ClustersY * ClustersZ;
+const uint32_t MaxClusterLights = 63;
+// Matches local_size_x in light_cluster_comp.glsl
+const uint32_t ClusterGroupSize = 64;
+// Active lights reserved up front for each swap chain image
+const size_t MinLightCapacity = 64;
+// Packs the octahedral normal and roughness of deferred_geom_frag.glsl
+const vk::Format NormalRoughnessFormat = vk::Format::eA2B10G10R10UnormPack32;
+// Light reaching each surface at reduced lighting resolutions, before the surface colour is applied
+const vk::Format ReducedLightFormat = vk::Format::eR16G16B16A16Sfloat;
+// Wider spot lights are drawn as spheres as a cone would be larger
+const float MaxConeAngle = 60;
+
+// The lights touching one cluster, as written by light_cluster_comp.glsl
+struct LightCluster {
+    uint32_t lightCount;
+    uint32_t lightSlots[MaxClusterLights];
+};
+
+static_assert(sizeof(LightCluster) == 256, "LightCluster must match the layout in light_cluster_comp.glsl");
+
+enum ClusterBindings {
+    ClusterLights = 0,
+    ClusterActiveLights = 1,
+    ClusterOutput = 2,
+};
+
 enum DeferredBindings {
     CameraBinding = 0,
-    EntityBinding = 1,
-    LightingUniformBinding = 2,
-    PositionBinding = 3,
+    ReducedLightBinding = 1,
+    LightStorageBinding = 2,
     NormalRoughnessBinding = 4,
     DiffuseOcclusionBinding = 5,
     DepthBinding = 6,
+    ActiveLightsBinding = 7,
+    ClustersBinding = 8,
 };
 
+void DeferredPipeline::GeometryDescriptors::resize(size_t imageCount) {
+    entities.resize(imageCount, nullptr);
+    instances.resize(imageCount, nullptr);
+}
+
+void DeferredPipeline::GeometryDescriptors::reset() {
+    std::fill(entities.begin(), entities.end(), nullptr);
+    std::fill(instances.begin(), instances.end(), nullptr);
+}
+
+void DeferredPipeline::LightingDescriptors::resize(size_t imageCount) {
+    lights.resize(imageCount, nullptr);
+    activeLights.resize(imageCount, nullptr);
+    clusters.resize(imageCount, nullptr);
+}
+
+void DeferredPipeline::LightingDescriptors::reset() {
+    std::fill(lights.begin(), lights.end(), nullptr);
+    std::fill(activeLights.begin(), activeLights.end(), nullptr);
+    std::fill(clusters.begin(), clusters.end(), nullptr);
+}
+
 DeferredPipeline::DeferredPipeline(RenderEngine &engine, VulkanDevice &device, ExecutionController &controller)
     : device(device), engine(engine), controller(controller) {
     defaultMaterial = engine.getMaterialManager().getDefault();
 
-    geometryCommandBuffer = controller.acquireSecondaryGraphicsCommandBuffer();
-    lightingCommandBuffer = controller.acquireSecondaryGraphicsCommandBuffer();
+    std::vector<Vertex> vertices;
+    std::vector<uint16_t> indices;
+    generateLightSphere(vertices, indices);
+    lightSphere = engine.createStaticMesh<Vertex>("internal.light_sphere")
+        .withVertices(vertices)
+        .withIndices(indices)
+        .build();
+
+    generateLightCone(vertices, indices);
+    lightCone = engine.createStaticMesh<Vertex>("internal.light_cone")
+        .withVertices(vertices)
+        .withIndices(indices)
+        .build();
+
+    geometryCommandBuffers = controller.acquireSecondaryGraphicsCommandBuffers();
+    lightingCommandBuffers = controller.acquireSecondaryGraphicsCommandBuffers();
+    instanceBuffers.resize(geometryCommandBuffers.size());
+    culling.resize(geometryCommandBuffers.size());
+    lightClusters.resize(lightingCommandBuffers.size());
+    geometryDescriptors.resize(geometryCommandBuffers.size());
+    depthPrepassDescriptors.resize(geometryCommandBuffers.size());
+    prepassGeometryDescriptors.resize(geometryCommandBuffers.size());
+    fullScreenLightDescriptors.resize(lightingCommandBuffers.size());
+    worldLightDescriptors.resize(lightingCommandBuffers.size());
+    clusteredLightDescriptors.resize(lightingCommandBuffers.size());
+
+    reducedLightingCommandBuffers = controller.acquireSecondaryGraphicsCommandBuffers();
+    upsampleCommandBuffers = controller.acquireSecondaryGraphicsCommandBuffers();
+    reducedFullScreenLightDescriptors.resize(reducedLightingCommandBuffers.size());
+    reducedWorldLightDescriptors.resize(reducedLightingCommandBuffers.size());
+    reducedClusteredLightDescriptors.resize(reducedLightingCommandBuffers.size());
+
+    // The G-buffer is only ever read with texelFetch
+    vk::SamplerCreateInfo samplerInfo = {
+        {},
+        vk::Filter::eNearest,
+        vk::Filter::eNearest,
+        vk::SamplerMipmapMode::eNearest,
+        vk::SamplerAddressMode::eClampToEdge,
+        vk::SamplerAddressMode::eClampToEdge,
+        vk::SamplerAddressMode::eClampToEdge
+    };
+    gBufferSampler = device.device.createSampler(samplerInfo);
 }
 
 DeferredPipeline::~DeferredPipeline() {
     cleanupSwapChain();
+    device.device.destroy(gBufferSampler);
 
     attachmentDiffuseOcclusion.reset();
     attachmentNormalRoughness.reset();
@@ -62,27 +187,31 @@ void DeferredPipeline::createAttachments() {
         .withMipLevels(1)
         .withFormat(vk::Format::eR8G8B8A8Unorm)
         .withMemoryUsage(vk::MemoryUsage::eGPUOnly)
-        .withUsage(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eInputAttachment)
+        .withUsage(
+            vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eInputAttachment |
+                vk::ImageUsageFlagBits::eSampled
+        )
         .withImageTiling(vk::ImageTiling::eOptimal)
         .withSampleCount(vk::SampleCountFlagBits::e1);
 
     attachmentDiffuseOcclusion = attachmentBuilder.build();
 
-    auto highPBuilder = engine.createImage(framebufferSize.width, framebufferSize.height)
+    // Octahedral normal in RG and roughness in B. Position is rebuilt from depth so is not stored
+    attachmentNormalRoughness = engine.createImage(framebufferSize.width, framebufferSize.height)
         .withMipLevels(1)
-            // TODO: Verify that we can use this format. Find alternative if not
-        .withFormat(vk::Format::eR16G16B16A16Sfloat)
+        .withFormat(NormalRoughnessFormat)
         .withMemoryUsage(vk::MemoryUsage::eGPUOnly)
-        .withUsage(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eInputAttachment)
+        .withUsage(
+            vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eInputAttachment |
+                vk::ImageUsageFlagBits::eSampled
+        )
         .withImageTiling(vk::ImageTiling::eOptimal)
-        .withSampleCount(vk::SampleCountFlagBits::e1);
-
-    attachmentNormalRoughness = highPBuilder.build();
-    attachmentPosition = highPBuilder.build();
+        .withSampleCount(vk::SampleCountFlagBits::e1)
+        .build();
 }
 
 void DeferredPipeline::createRenderPass() {
-    std::array<vk::AttachmentDescription, 5> attachments;
+    std::array<vk::AttachmentDescription, 4> attachments;
 
     attachments[DeferredAttachments::CombinedOutput] = {
         {},
@@ -95,20 +224,9 @@ void DeferredPipeline::createRenderPass() {
         vk::ImageLayout::eUndefined,
         vk::ImageLayout::eColorAttachmentOptimal
     };
-    attachments[DeferredAttachments::Position] = {
-        {},
-        vk::Format::eR16G16B16A16Sfloat,
-        vk::SampleCountFlagBits::e1,
-        vk::AttachmentLoadOp::eClear,
-        vk::AttachmentStoreOp::eStore,
-        vk::AttachmentLoadOp::eDontCare,
-        vk::AttachmentStoreOp::eDontCare,
-        vk::ImageLayout::eUndefined,
-        vk::ImageLayout::eColorAttachmentOptimal
-    };
     attachments[DeferredAttachments::NormalRoughness] = {
         {},
-        vk::Format::eR16G16B16A16Sfloat,
+        NormalRoughnessFormat,
         vk::SampleCountFlagBits::e1,
         vk::AttachmentLoadOp::eClear,
         vk::AttachmentStoreOp::eStore,
@@ -143,9 +261,6 @@ void DeferredPipeline::createRenderPass() {
     vk::AttachmentReference combinedOutputRef(
         DeferredAttachments::CombinedOutput, vk::ImageLayout::eColorAttachmentOptimal
     );
-    vk::AttachmentReference positionOutputRef(
-        DeferredAttachments::Position, vk::ImageLayout::eColorAttachmentOptimal
-    );
     vk::AttachmentReference normalRoughnessOutputRef(
         DeferredAttachments::NormalRoughness, vk::ImageLayout::eColorAttachmentOptimal
     );
@@ -156,24 +271,21 @@ void DeferredPipeline::createRenderPass() {
         DeferredAttachments::Depth, vk::ImageLayout::eDepthStencilAttachmentOptimal
     );
 
-    vk::AttachmentReference positionInputRef(
-        DeferredAttachments::Position, vk::ImageLayout::eShaderReadOnlyOptimal
-    );
     vk::AttachmentReference normalRoughnessInputRef(
         DeferredAttachments::NormalRoughness, vk::ImageLayout::eShaderReadOnlyOptimal
     );
     vk::AttachmentReference diffuseOcclusionInputRef(
         DeferredAttachments::DiffuseOcclusion, vk::ImageLayout::eShaderReadOnlyOptimal
     );
+    // Read only so that light volumes can depth test against it while it is also an input
     vk::AttachmentReference depthInputRef(
-        DeferredAttachments::Depth, vk::ImageLayout::eShaderReadOnlyOptimal
+        DeferredAttachments::Depth, vk::ImageLayout::eDepthStencilReadOnlyOptimal
     );
 
     std::array<vk::SubpassDescription, 2> subpasses;
-    std::array<vk::SubpassDependency, 2> dependencies;
+    std::array<vk::SubpassDependency, 3> dependencies;
 
-    std::array<vk::AttachmentReference, 3> geometryColorAttachments {
-        positionOutputRef,
+    std::array<vk::AttachmentReference, 2> geometryColorAttachments {
         normalRoughnessOutputRef,
         diffuseOcclusionOutputRef,
     };
@@ -197,8 +309,7 @@ void DeferredPipeline::createRenderPass() {
         vk::DependencyFlagBits::eByRegion
     };
 
-    std::array<vk::AttachmentReference, 4> lightingInputAttachments {
-        positionInputRef,
+    std::array<vk::AttachmentReference, 3> lightingInputAttachments {
         normalRoughnessInputRef,
         diffuseOcclusionInputRef,
         depthInputRef
@@ -209,7 +320,7 @@ void DeferredPipeline::createRenderPass() {
         vkUseArray(lightingInputAttachments),
         1, &combinedOutputRef,
         nullptr,
-        nullptr
+        &depthInputRef
     };
 
     dependencies[1] = {
@@ -218,12 +329,27 @@ void DeferredPipeline::createRenderPass() {
         vk::PipelineStageFlagBits::eColorAttachmentOutput |
             vk::PipelineStageFlagBits::eEarlyFragmentTests |
             vk::PipelineStageFlagBits::eLateFragmentTests,
-        vk::PipelineStageFlagBits::eFragmentShader,
+        vk::PipelineStageFlagBits::eFragmentShader |
+            vk::PipelineStageFlagBits::eEarlyFragmentTests |
+            vk::PipelineStageFlagBits::eLateFragmentTests,
         vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite,
-        vk::AccessFlagBits::eInputAttachmentRead,
+        vk::AccessFlagBits::eInputAttachmentRead | vk::AccessFlagBits::eDepthStencilAttachmentRead,
         vk::DependencyFlagBits::eByRegion
     };
 
+    // Only needed by the reduced lighting passes, but both render passes must match to be compatible
+    dependencies[2] = {
+        DeferredPasses::LightingPass,
+        VK_SUBPASS_EXTERNAL,
+        vk::PipelineStageFlagBits::eColorAttachmentOutput |
+            vk::PipelineStageFlagBits::eEarlyFragmentTests |
+            vk::PipelineStageFlagBits::eLateFragmentTests,
+        vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eColorAttachmentOutput,
+        vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+        vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eColorAttachmentRead |
+            vk::AccessFlagBits::eColorAttachmentWrite
+    };
+
     vk::RenderPassCreateInfo renderPassInfo(
         {},
         vkUseArray(attachments),
@@ -232,15 +358,133 @@ void DeferredPipeline::createRenderPass() {
     );
 
     renderPass = device.device.createRenderPass(renderPassInfo);
+
+    // Store ops and layouts can differ without breaking compatibility
+    attachments[DeferredAttachments::NormalRoughness].finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    attachments[DeferredAttachments::DiffuseOcclusion].finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    attachments[DeferredAttachments::Depth].storeOp = vk::AttachmentStoreOp::eStore;
+    attachments[DeferredAttachments::Depth].finalLayout = vk::ImageLayout::eDepthStencilReadOnlyOptimal;
+
+    sampledGBufferRenderPass = device.device.createRenderPass(renderPassInfo);
+
+    createReducedLightingRenderPasses();
+}
+
+/**
+ * The reduced lighting pass shades into its own smaller target. The upsample pass then adds
+ * that onto the output and returns the depth attachment to the layout the main layer expects.
+ */
+void DeferredPipeline::createReducedLightingRenderPasses() {
+    vk::AttachmentDescription reducedLightAttachment {
+        {},
+        ReducedLightFormat,
+        vk::SampleCountFlagBits::e1,
+        vk::AttachmentLoadOp::eClear,
+        vk::AttachmentStoreOp::eStore,
+        vk::AttachmentLoadOp::eDontCare,
+        vk::AttachmentStoreOp::eDontCare,
+        vk::ImageLayout::eUndefined,
+        vk::ImageLayout::eShaderReadOnlyOptimal
+    };
+    vk::AttachmentReference reducedLightRef(0, vk::ImageLayout::eColorAttachmentOptimal);
+
+    vk::SubpassDescription reducedSubpass {
+        {},
+        vk::PipelineBindPoint::eGraphics,
+        0, nullptr,
+        1, &reducedLightRef
+    };
+
+    std::array<vk::SubpassDependency, 2> reducedDependencies;
+    // Waits for the G-buffer
+    reducedDependencies[0] = {
+        VK_SUBPASS_EXTERNAL,
+        0,
+        vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eLateFragmentTests,
+        vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eColorAttachmentOutput,
+        vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+        vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eColorAttachmentWrite
+    };
+    reducedDependencies[1] = {
+        0,
+        VK_SUBPASS_EXTERNAL,
+        vk::PipelineStageFlagBits::eColorAttachmentOutput,
+        vk::PipelineStageFlagBits::eFragmentShader,
+        vk::AccessFlagBits::eColorAttachmentWrite,
+        vk::AccessFlagBits::eShaderRead
+    };
+
+    vk::RenderPassCreateInfo reducedInfo(
+        {},
+        1, &reducedLightAttachment,
+        1, &reducedSubpass,
+        vkUseArray(reducedDependencies)
+    );
+    reducedLightingRenderPass = device.device.createRenderPass(reducedInfo);
+
+    std::array<vk::AttachmentDescription, 2> upsampleAttachments;
+    upsampleAttachments[0] = {
+        {},
+        swapChainFormat,
+        vk::SampleCountFlagBits::e1,
+        vk::AttachmentLoadOp::eLoad,
+        vk::AttachmentStoreOp::eStore,
+        vk::AttachmentLoadOp::eDontCare,
+        vk::AttachmentStoreOp::eDontCare,
+        vk::ImageLayout::eColorAttachmentOptimal,
+        vk::ImageLayout::eColorAttachmentOptimal
+    };
+    // Sampled while attached read only. Nothing after this reads the depth so it is not stored
+    upsampleAttachments[1] = {
+        {},
+        depthFormat,
+        vk::SampleCountFlagBits::e1,
+        vk::AttachmentLoadOp::eLoad,
+        vk::AttachmentStoreOp::eDontCare,
+        vk::AttachmentLoadOp::eLoad,
+        vk::AttachmentStoreOp::eDontCare,
+        vk::ImageLayout::eDepthStencilReadOnlyOptimal,
+        vk::ImageLayout::eDepthStencilAttachmentOptimal
+    };
+
+    vk::AttachmentReference outputRef(0, vk::ImageLayout::eColorAttachmentOptimal);
+    vk::AttachmentReference depthRef(1, vk::ImageLayout::eDepthStencilReadOnlyOptimal);
+
+    vk::SubpassDescription upsampleSubpass {
+        {},
+        vk::PipelineBindPoint::eGraphics,
+        0, nullptr,
+        1, &outputRef,
+        nullptr,
+        &depthRef
+    };
+
+    vk::SubpassDependency upsampleDependency {
+        VK_SUBPASS_EXTERNAL,
+        0,
+        vk::PipelineStageFlagBits::eColorAttachmentOutput,
+        vk::PipelineStageFlagBits::eFragmentShader | vk::PipelineStageFlagBits::eColorAttachmentOutput,
+        vk::AccessFlagBits::eColorAttachmentWrite,
+        vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eColorAttachmentRead |
+            vk::AccessFlagBits::eColorAttachmentWrite
+    };
+
+    vk::RenderPassCreateInfo upsampleInfo(
+        {},
+        vkUseArray(upsampleAttachments),
+        1, &upsampleSubpass,
+        1, &upsampleDependency
+    );
+    upsampleRenderPass = device.device.createRenderPass(upsampleInfo);
 }
 
 void DeferredPipeline::createFramebuffers(const Image *depthImage) {
     framebuffers.reserve(passOutputImages.size());
+    upsampleFramebuffers.reserve(passOutputImages.size());
 
     for (auto &image : passOutputImages) {
-        std::array<vk::ImageView, 5> mainAttachments = {
+        std::array<vk::ImageView, 4> mainAttachments = {
             image,
-            attachmentPosition->imageView(),
             attachmentNormalRoughness->imageView(),
             attachmentDiffuseOcclusion->imageView(),
             depthImage->imageView()
@@ -256,12 +500,27 @@ void DeferredPipeline::createFramebuffers(const Image *depthImage) {
         );
 
         framebuffers.emplace_back(device.device.createFramebuffer(mainFramebufferInfo));
+
+        std::array<vk::ImageView, 2> upsampleAttachments = {
+            image,
+            depthImage->imageView()
+        };
+
+        vk::FramebufferCreateInfo upsampleFramebufferInfo(
+            {},
+            upsampleRenderPass,
+            vkUseArray(upsampleAttachments),
+            framebufferSize.width,
+            framebufferSize.height,
+            1
+        );
+
+        upsampleFramebuffers.emplace_back(device.device.createFramebuffer(upsampleFramebufferInfo));
     }
 }
 
 void DeferredPipeline::createLightingPipeline(const std::shared_ptr<Image> &depth) {
     fullScreenLightingPipeline = engine.createPipeline(renderPass, 1)
-        .withInputAttachment(0, DeferredBindings::PositionBinding, attachmentPosition)
         .withInputAttachment(0, DeferredBindings::NormalRoughnessBinding, attachmentNormalRoughness)
         .withInputAttachment(0, DeferredBindings::DiffuseOcclusionBinding, attachmentDiffuseOcclusion)
         .withInputAttachment(0, DeferredBindings::DepthBinding, depth)
@@ -271,40 +530,279 @@ void DeferredPipeline::createLightingPipeline(const std::shared_ptr<Image> &dept
         .withoutFaceCulling()
         .withVertexShader(EFFECTS_SCREEN_GEN_VERTEX_GLSL, EFFECTS_SCREEN_GEN_VERTEX_GLSL_SIZE)
         .withFragmentShader(BUILTIN_DEFERRED_LIGHTING_FRAG_GLSL, BUILTIN_DEFERRED_LIGHTING_FRAG_GLSL_SIZE)
-        .bindUniformBufferDynamic(1, DeferredBindings::LightingUniformBinding, vk::ShaderStageFlagBits::eFragment)
+        .bindCamera(0, DeferredBindings::CameraBinding, vk::ShaderStageFlagBits::eFragment)
+        .bindStorageBufferPerImage(1, DeferredBindings::LightStorageBinding, vk::ShaderStageFlagBits::eFragment)
+        .bindStorageBufferPerImage(1, DeferredBindings::ActiveLightsBinding, vk::ShaderStageFlagBits::eFragment)
+        .bindStorageBufferPerImage(1, DeferredBindings::ClustersBinding, vk::ShaderStageFlagBits::eFragment)
+        .withPushConstants<LightPushConstants>(vk::ShaderStageFlagBits::eFragment)
         .withColorBlend(vk::BlendOp::eAdd, vk::BlendFactor::eOne, vk::BlendFactor::eOne)
         .build();
 
-    worldLightingPipeline = engine.createPipeline(renderPass, 1)
-        .withInputAttachment(0, DeferredBindings::PositionBinding, attachmentPosition)
+    clusteredLightingPipeline = engine.createPipeline(renderPass, 1)
         .withInputAttachment(0, DeferredBindings::NormalRoughnessBinding, attachmentNormalRoughness)
         .withInputAttachment(0, DeferredBindings::DiffuseOcclusionBinding, attachmentDiffuseOcclusion)
         .withInputAttachment(0, DeferredBindings::DepthBinding, depth)
         .withSubpass(DeferredPasses::LightingPass)
         .withoutDepthWrite()
+        .withoutDepthTest()
+        .withoutFaceCulling()
+        .withVertexShader(EFFECTS_SCREEN_GEN_VERTEX_GLSL, EFFECTS_SCREEN_GEN_VERTEX_GLSL_SIZE)
+        .withFragmentShader(BUILTIN_DEFERRED_LIGHTING_FRAG_GLSL, BUILTIN_DEFERRED_LIGHTING_FRAG_GLSL_SIZE)
+        .withShaderConstant(0, vk::ShaderStageFlagBits::eFragment, true)
+        .bindCamera(0, DeferredBindings::CameraBinding, vk::ShaderStageFlagBits::eFragment)
+        .bindStorageBufferPerImage(1, DeferredBindings::LightStorageBinding, vk::ShaderStageFlagBits::eFragment)
+        .bindStorageBufferPerImage(1, DeferredBindings::ActiveLightsBinding, vk::ShaderStageFlagBits::eFragment)
+        .bindStorageBufferPerImage(1, DeferredBindings::ClustersBinding, vk::ShaderStageFlagBits::eFragment)
+        .withPushConstants<LightPushConstants>(vk::ShaderStageFlagBits::eFragment)
+        .withColorBlend(vk::BlendOp::eAdd, vk::BlendFactor::eOne, vk::BlendFactor::eOne)
+        .build();
+
+    // Front faces in front of the scene, so surfaces hidden from the volume are skipped
+    auto worldLightingBuilder = engine.createPipeline(renderPass, 1)
+        .withInputAttachment(0, DeferredBindings::NormalRoughnessBinding, attachmentNormalRoughness)
+        .withInputAttachment(0, DeferredBindings::DiffuseOcclusionBinding, attachmentDiffuseOcclusion)
+        .withInputAttachment(0, DeferredBindings::DepthBinding, depth)
+        .withSubpass(DeferredPasses::LightingPass)
+        .withoutDepthWrite()
+        .withDepthCompare(vk::CompareOp::eLessOrEqual)
         .withVertexShader(BUILTIN_DEFERRED_LIGHTING_VERT_GLSL, BUILTIN_DEFERRED_LIGHTING_VERT_GLSL_SIZE)
         .withFragmentShader(BUILTIN_DEFERRED_LIGHTING_FRAG_GLSL, BUILTIN_DEFERRED_LIGHTING_FRAG_GLSL_SIZE)
-        .bindCamera(0, DeferredBindings::CameraBinding)
-        .bindUniformBufferDynamic(1, DeferredBindings::LightingUniformBinding, vk::ShaderStageFlagBits::eFragment)
-        .bindUniformBufferDynamic(1, DeferredBindings::EntityBinding)
+        .bindCamera(
+            0, DeferredBindings::CameraBinding, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment
+        )
+        .bindStorageBufferPerImage(1, DeferredBindings::LightStorageBinding, vk::ShaderStageFlagBits::eFragment)
+        .bindStorageBufferPerImage(1, DeferredBindings::ActiveLightsBinding, vk::ShaderStageFlagBits::eFragment)
+        .bindStorageBufferPerImage(1, DeferredBindings::ClustersBinding, vk::ShaderStageFlagBits::eFragment)
+        .withPushConstants<LightPushConstants>(vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment)
         .withVertexAttributeDescriptions(Vertex::getAttributeDescriptions())
         .withVertexBindingDescriptions(Vertex::getBindingDescription())
+        .withColorBlend(vk::BlendOp::eAdd, vk::BlendFactor::eOne, vk::BlendFactor::eOne);
+
+    // Also skips surfaces beyond the light's range
+    if (device.supportsDepthBounds) {
+        worldLightingBuilder.withDepthBoundsTest();
+    }
+    worldLightingPipeline = worldLightingBuilder.build();
+
+    // The new descriptors need pointing at the light storage again
+    fullScreenLightDescriptors.reset();
+    worldLightDescriptors.reset();
+    clusteredLightDescriptors.reset();
+}
+
+/**
+ * The lighting pipelines drawn into the reduced lighting target. They sample the G-buffer
+ * instead of reading it as input attachments. The viewport follows the target's size.
+ */
+void DeferredPipeline::createReducedLightingPipeline(const std::shared_ptr<Image> &depth) {
+    reducedFullScreenLightingPipeline = engine.createPipeline(reducedLightingRenderPass, 1)
+        .bindSampledImage(
+            0, DeferredBindings::NormalRoughnessBinding, attachmentNormalRoughness, vk::ShaderStageFlagBits::eFragment,
+            vk::ImageLayout::eShaderReadOnlyOptimal, gBufferSampler
+        )
+        .bindSampledImage(
+            0, DeferredBindings::DepthBinding, depth, vk::ShaderStageFlagBits::eFragment,
+            vk::ImageLayout::eDepthStencilReadOnlyOptimal, gBufferSampler
+        )
+        .withDynamicState(vk::DynamicState::eViewport)
+        .withDynamicState(vk::DynamicState::eScissor)
+        .withoutDepthWrite()
+        .withoutDepthTest()
+        .withoutFaceCulling()
+        .withVertexShader(EFFECTS_SCREEN_GEN_VERTEX_GLSL, EFFECTS_SCREEN_GEN_VERTEX_GLSL_SIZE)
+        .withFragmentShader(
+            BUILTIN_DEFERRED_LIGHTING_REDUCED_FRAG_GLSL, BUILTIN_DEFERRED_LIGHTING_REDUCED_FRAG_GLSL_SIZE
+        )
+        .bindCamera(0, DeferredBindings::CameraBinding, vk::ShaderStageFlagBits::eFragment)
+        .bindStorageBufferPerImage(1, DeferredBindings::LightStorageBinding, vk::ShaderStageFlagBits::eFragment)
+        .bindStorageBufferPerImage(1, DeferredBindings::ActiveLightsBinding, vk::ShaderStageFlagBits::eFragment)
+        .bindStorageBufferPerImage(1, DeferredBindings::ClustersBinding, vk::ShaderStageFlagBits::eFragment)
+        .withPushConstants<LightPushConstants>(vk::ShaderStageFlagBits::eFragment)
+        .withColorBlend(vk::BlendOp::eAdd, vk::BlendFactor::eOne, vk::BlendFactor::eOne)
+        .build();
+
+    reducedClusteredLightingPipeline = engine.createPipeline(reducedLightingRenderPass, 1)
+        .bindSampledImage(
+            0, DeferredBindings::NormalRoughnessBinding, attachmentNormalRoughness, vk::ShaderStageFlagBits::eFragment,
+            vk::ImageLayout::eShaderReadOnlyOptimal, gBufferSampler
+        )
+        .bindSampledImage(
+            0, DeferredBindings::DepthBinding, depth, vk::ShaderStageFlagBits::eFragment,
+            vk::ImageLayout::eDepthStencilReadOnlyOptimal, gBufferSampler
+        )
+        .withDynamicState(vk::DynamicState::eViewport)
+        .withDynamicState(vk::DynamicState::eScissor)
+        .withoutDepthWrite()
+        .withoutDepthTest()
+        .withoutFaceCulling()
+        .withVertexShader(EFFECTS_SCREEN_GEN_VERTEX_GLSL, EFFECTS_SCREEN_GEN_VERTEX_GLSL_SIZE)
+        .withFragmentShader(
+            BUILTIN_DEFERRED_LIGHTING_REDUCED_FRAG_GLSL, BUILTIN_DEFERRED_LIGHTING_REDUCED_FRAG_GLSL_SIZE
+        )
+        .withShaderConstant(0, vk::ShaderStageFlagBits::eFragment, true)
+        .bindCamera(0, DeferredBindings::CameraBinding, vk::ShaderStageFlagBits::eFragment)
+        .bindStorageBufferPerImage(1, DeferredBindings::LightStorageBinding, vk::ShaderStageFlagBits::eFragment)
+        .bindStorageBufferPerImage(1, DeferredBindings::ActiveLightsBinding, vk::ShaderStageFlagBits::eFragment)
+        .bindStorageBufferPerImage(1, DeferredBindings::ClustersBinding, vk::ShaderStageFlagBits::eFragment)
+        .withPushConstants<LightPushConstants>(vk::ShaderStageFlagBits::eFragment)
         .withColorBlend(vk::BlendOp::eAdd, vk::BlendFactor::eOne, vk::BlendFactor::eOne)
         .build();
+
+    // There is no depth to test against, so the volume only limits the pixels to its outline
+    reducedWorldLightingPipeline = engine.createPipeline(reducedLightingRenderPass, 1)
+        .bindSampledImage(
+            0, DeferredBindings::NormalRoughnessBinding, attachmentNormalRoughness, vk::ShaderStageFlagBits::eFragment,
+            vk::ImageLayout::eShaderReadOnlyOptimal, gBufferSampler
+        )
+        .bindSampledImage(
+            0, DeferredBindings::DepthBinding, depth, vk::ShaderStageFlagBits::eFragment,
+            vk::ImageLayout::eDepthStencilReadOnlyOptimal, gBufferSampler
+        )
+        .withDynamicState(vk::DynamicState::eViewport)
+        .withDynamicState(vk::DynamicState::eScissor)
+        .withoutDepthWrite()
+        .withoutDepthTest()
+        .withVertexShader(BUILTIN_DEFERRED_LIGHTING_VERT_GLSL, BUILTIN_DEFERRED_LIGHTING_VERT_GLSL_SIZE)
+        .withFragmentShader(
+            BUILTIN_DEFERRED_LIGHTING_REDUCED_FRAG_GLSL, BUILTIN_DEFERRED_LIGHTING_REDUCED_FRAG_GLSL_SIZE
+        )
+        .bindCamera(
+            0, DeferredBindings::CameraBinding, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment
+        )
+        .bindStorageBufferPerImage(1, DeferredBindings::LightStorageBinding, vk::ShaderStageFlagBits::eFragment)
+        .bindStorageBufferPerImage(1, DeferredBindings::ActiveLightsBinding, vk::ShaderStageFlagBits::eFragment)
+        .bindStorageBufferPerImage(1, DeferredBindings::ClustersBinding, vk::ShaderStageFlagBits::eFragment)
+        .withPushConstants<LightPushConstants>(vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment)
+        .withVertexAttributeDescriptions(Vertex::getAttributeDescriptions())
+        .withVertexBindingDescriptions(Vertex::getBindingDescription())
+        .withColorBlend(vk::BlendOp::eAdd, vk::BlendFactor::eOne, vk::BlendFactor::eOne)
+        .build();
+
+    reducedFullScreenLightDescriptors.reset();
+    reducedWorldLightDescriptors.reset();
+    reducedClusteredLightDescriptors.reset();
+}
+
+/**
+ * The target the reduced lighting is shaded into, and the pipeline that upsamples it.
+ * Only exists below full resolution.
+ */
+void DeferredPipeline::createReducedLightingTarget() {
+    if (!isReducedLighting()) {
+        return;
+    }
+
+    auto divisor = getLightingDivisor();
+    reducedLightingSize = vk::Extent2D {
+        (framebufferSize.width + divisor - 1) / divisor,
+        (framebufferSize.height + divisor - 1) / divisor
+    };
+
+    attachmentReducedLight = engine.createImage(reducedLightingSize.width, reducedLightingSize.height)
+        .withMipLevels(1)
+        .withFormat(ReducedLightFormat)
+        .withMemoryUsage(vk::MemoryUsage::eGPUOnly)
+        .withUsage(vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled)
+        .withImageTiling(vk::ImageTiling::eOptimal)
+        .withSampleCount(vk::SampleCountFlagBits::e1)
+        .build();
+
+    auto reducedLightView = attachmentReducedLight->imageView();
+    vk::FramebufferCreateInfo framebufferInfo(
+        {},
+        reducedLightingRenderPass,
+        1, &reducedLightView,
+        reducedLightingSize.width,
+        reducedLightingSize.height,
+        1
+    );
+    reducedLightingFramebuffer = device.device.createFramebuffer(framebufferInfo);
+
+    upsamplePipeline = engine.createPipeline(upsampleRenderPass, 1)
+        .bindSampledImage(
+            0, DeferredBindings::ReducedLightBinding, attachmentReducedLight, vk::ShaderStageFlagBits::eFragment,
+            vk::ImageLayout::eShaderReadOnlyOptimal, gBufferSampler
+        )
+        .bindSampledImage(
+            0, DeferredBindings::NormalRoughnessBinding, attachmentNormalRoughness, vk::ShaderStageFlagBits::eFragment,
+            vk::ImageLayout::eShaderReadOnlyOptimal, gBufferSampler
+        )
+        .bindSampledImage(
+            0, DeferredBindings::DiffuseOcclusionBinding, attachmentDiffuseOcclusion,
+            vk::ShaderStageFlagBits::eFragment, vk::ImageLayout::eShaderReadOnlyOptimal, gBufferSampler
+        )
+        .bindSampledImage(
+            0, DeferredBindings::DepthBinding, depthAttachment, vk::ShaderStageFlagBits::eFragment,
+            vk::ImageLayout::eDepthStencilReadOnlyOptimal, gBufferSampler
+        )
+        .withoutDepthWrite()
+        .withoutDepthTest()
+        .withoutFaceCulling()
+        .withVertexShader(EFFECTS_SCREEN_GEN_VERTEX_GLSL, EFFECTS_SCREEN_GEN_VERTEX_GLSL_SIZE)
+        .withFragmentShader(BUILTIN_DEFERRED_UPSAMPLE_FRAG_GLSL, BUILTIN_DEFERRED_UPSAMPLE_FRAG_GLSL_SIZE)
+        .bindCamera(0, DeferredBindings::CameraBinding, vk::ShaderStageFlagBits::eFragment)
+        .withPushConstants<UpsamplePushConstants>(vk::ShaderStageFlagBits::eFragment)
+        .withColorBlend(vk::BlendOp::eAdd, vk::BlendFactor::eOne, vk::BlendFactor::eOne)
+        .build();
+}
+
+void DeferredPipeline::cleanupReducedLightingTarget() {
+    upsamplePipeline.reset();
+
+    if (reducedLightingFramebuffer) {
+        device.device.destroy(reducedLightingFramebuffer);
+        reducedLightingFramebuffer = nullptr;
+    }
+
+    attachmentReducedLight.reset();
 }
 
 void DeferredPipeline::createGeometryPipeline() {
-    geometryPipeline = engine.createPipeline(renderPass, 3)
+    geometryPipeline = engine.createPipeline(renderPass, 2)
+        .withVertexShader(BUILTIN_STANDARD_VERT_GLSL, BUILTIN_STANDARD_VERT_GLSL_SIZE)
+        .withFragmentShader(BUILTIN_DEFERRED_GEOM_FRAG_GLSL, BUILTIN_DEFERRED_GEOM_FRAG_GLSL_SIZE)
+        .withSubpass(DeferredPasses::GeometryPass)
+        .withVertexAttributeDescriptions(Vertex::getAttributeDescriptions())
+        .withVertexBindingDescriptions(Vertex::getBindingDescription())
+        .bindCamera(0, Internal::StandardBindings::CameraUniform)
+        .bindStorageBufferPerImage(1, Internal::StandardBindings::EntityStorage)
+        .bindStorageBufferPerImage(1, Internal::StandardBindings::InstanceStorage)
+        .bindMaterial(2, Internal::StandardBindings::AlbedoTexture, MaterialBindPoint::Albedo)
+        .bindMaterial(3, Internal::StandardBindings::NormalTexture, MaterialBindPoint::Normal)
+        .build();
+
+    // Only the positions are read, straight out of the interleaved vertices
+    depthPrepassPipeline = engine.createPipeline(renderPass, 2)
+        .withVertexShader(BUILTIN_DEPTH_PREPASS_VERT_GLSL, BUILTIN_DEPTH_PREPASS_VERT_GLSL_SIZE)
+        .withFragmentShader(BUILTIN_DEPTH_PREPASS_FRAG_GLSL, BUILTIN_DEPTH_PREPASS_FRAG_GLSL_SIZE)
+        .withSubpass(DeferredPasses::GeometryPass)
+        .withVertexAttributeDescription(Vertex::getAttributeDescriptions()[0])
+        .withVertexBindingDescriptions(Vertex::getBindingDescription())
+        .withColorMask({})
+        .bindCamera(0, Internal::StandardBindings::CameraUniform)
+        .bindStorageBufferPerImage(1, Internal::StandardBindings::EntityStorage)
+        .bindStorageBufferPerImage(1, Internal::StandardBindings::InstanceStorage)
+        .build();
+
+    prepassGeometryPipeline = engine.createPipeline(renderPass, 2)
         .withVertexShader(BUILTIN_STANDARD_VERT_GLSL, BUILTIN_STANDARD_VERT_GLSL_SIZE)
         .withFragmentShader(BUILTIN_DEFERRED_GEOM_FRAG_GLSL, BUILTIN_DEFERRED_GEOM_FRAG_GLSL_SIZE)
         .withSubpass(DeferredPasses::GeometryPass)
         .withVertexAttributeDescriptions(Vertex::getAttributeDescriptions())
         .withVertexBindingDescriptions(Vertex::getBindingDescription())
+        .withoutDepthWrite()
+        .withDepthCompare(vk::CompareOp::eEqual)
         .bindCamera(0, Internal::StandardBindings::CameraUniform)
-        .bindUniformBufferDynamic(1, Internal::StandardBindings::EntityUniform)
+        .bindStorageBufferPerImage(1, Internal::StandardBindings::EntityStorage)
+        .bindStorageBufferPerImage(1, Internal::StandardBindings::InstanceStorage)
         .bindMaterial(2, Internal::StandardBindings::AlbedoTexture, MaterialBindPoint::Albedo)
         .bindMaterial(3, Internal::StandardBindings::NormalTexture, MaterialBindPoint::Normal)
         .build();
+
+    // The new descriptors need pointing at the storage buffers again
+    geometryDescriptors.reset();
+    depthPrepassDescriptors.reset();
+    prepassGeometryDescriptors.reset();
 }
 
 void DeferredPipeline::cleanupSwapChain() {
@@ -314,16 +812,43 @@ void DeferredPipeline::cleanupSwapChain() {
 
     framebuffers.clear();
 
+    for (auto framebuffer: upsampleFramebuffers) {
+        device.device.destroy(framebuffer);
+    }
+
+    upsampleFramebuffers.clear();
+
+    cleanupReducedLightingTarget();
+
     fullScreenLightingPipeline.reset();
     worldLightingPipeline.reset();
+    clusteredLightingPipeline.reset();
+    reducedFullScreenLightingPipeline.reset();
+    reducedWorldLightingPipeline.reset();
+    reducedClusteredLightingPipeline.reset();
     geometryPipeline.reset();
+    depthPrepassPipeline.reset();
+    prepassGeometryPipeline.reset();
 
-    attachmentPosition.reset();
     attachmentNormalRoughness.reset();
     attachmentDiffuseOcclusion.reset();
+    depthAttachment.reset();
 
     if (renderPass) {
         device.device.destroy(renderPass);
+        renderPass = nullptr;
+    }
+    if (sampledGBufferRenderPass) {
+        device.device.destroy(sampledGBufferRenderPass);
+        sampledGBufferRenderPass = nullptr;
+    }
+    if (reducedLightingRenderPass) {
+        device.device.destroy(reducedLightingRenderPass);
+        reducedLightingRenderPass = nullptr;
+    }
+    if (upsampleRenderPass) {
+        device.device.destroy(upsampleRenderPass);
+        upsampleRenderPass = nullptr;
     }
 }
 
@@ -334,25 +859,89 @@ void DeferredPipeline::recreateSwapChain(
     swapChainFormat = format;
     framebufferSize = size;
     depthFormat = depth->getFormat();
+    depthAttachment = depth;
 
     createAttachments();
     createRenderPass();
     createFramebuffers(depth.get());
     createGeometryPipeline();
     createLightingPipeline(depth);
+    createReducedLightingPipeline(depth);
+    createReducedLightingTarget();
+}
+
+void DeferredPipeline::setGpuCulling(bool enabled) {
+    // Each group is drawn from its offset into the visible instances using firstInstance
+    gpuCulling = enabled && device.supportsDrawIndirectFirstInstance;
+}
+
+void DeferredPipeline::setLightingResolution(LightingResolution resolution) {
+    if (resolution == lightingResolution) {
+        return;
+    }
+
+    lightingResolution = resolution;
+
+    // Without a swap chain the target is made along with everything else
+    if (!framebuffers.empty()) {
+        // The target may still be in use by frames in flight
+        device.waitIdle();
+        cleanupReducedLightingTarget();
+        createReducedLightingTarget();
+    }
+}
+
+uint32_t DeferredPipeline::getLightingDivisor() const {
+    switch (lightingResolution) {
+        case LightingResolution::Half:
+            return 2;
+        case LightingResolution::Quarter:
+            return 4;
+        default:
+            return 1;
+    }
 }
 
 void DeferredPipeline::begin(uint32_t imageIndex) {
     if (framebuffers.size() > 1) {
         // Rendering to swapchain directly
         activeFramebuffer = framebuffers[imageIndex];
+        activeUpsampleFramebuffer = upsampleFramebuffers[imageIndex];
     } else {
         // Rendering to intermediate
         activeFramebuffer = framebuffers[0];
+        activeUpsampleFramebuffer = upsampleFramebuffers[0];
     }
     activeImage = imageIndex;
-    lastMesh = nullptr;
-    controller.beginRenderPass(renderPass, activeFramebuffer, framebufferSize, { 0, 0, 0, 0 }, 3);
+    geometryCommandBuffer = geometryCommandBuffers[imageIndex];
+    lightingCommandBuffer = lightingCommandBuffers[imageIndex];
+    lastMaterial = nullptr;
+    geometryState.resetStats();
+    lightingState.resetStats();
+    depthPrepassStats = {};
+
+    fullScreenLights.clear();
+    worldLights.clear();
+    reducedLights.clear();
+    clusteredLights.clear();
+
+    // The previous frame using this image is complete so its culling results can be read
+    auto &counters = culling[imageIndex].counters;
+    if (counters) {
+        auto visibleInstances = static_cast<uint32_t *>(counters->getMappedData());
+        counters->invalidateRange(0, sizeof(uint32_t));
+        gpuVisibleInstances = *visibleInstances;
+
+        *visibleInstances = 0;
+        counters->flushRange(0, sizeof(uint32_t));
+    }
+}
+
+void DeferredPipeline::bindSceneStorage(
+    const std::shared_ptr<Buffer> &entities, const std::shared_ptr<Buffer> &lights
+) {
+    entityStorage = entities;
+    lightStorage = lights;
 }
 
 void DeferredPipeline::beginGeometry() {
@@ -367,44 +956,403 @@ void DeferredPipeline::beginGeometry() {
         &mainCbInheritance
     );
     geometryCommandBuffer.begin(renderBeginInfo);
+    geometryState.begin(geometryCommandBuffer);
+
+    geometryDraws.clear();
+}
+
+uint64_t DeferredPipeline::getDrawKey(const Mesh *mesh, const Material *material) const {
+    if (!material) {
+        material = defaultMaterial;
+    }
+
+    auto meshId = mesh ? mesh->getSortId() : 0;
+    auto materialId = material ? material->getSortId() : 0;
+
+    // Only the one geometry pipeline exists for now
+    return DrawKey::make(0, materialId, meshId);
+}
+
+void DeferredPipeline::renderGeometry(const MeshRenderer &renderer, uint32_t entitySlot, uint64_t sortKey) {
+    geometryDraws.push_back({ sortKey, renderer.getMesh(), renderer.getMaterial(), entitySlot });
+}
+
+/**
+ * Replaces the buffer with a larger one when it cannot hold the size.
+ * The buffer must only be used by the active swap chain image.
+ * @returns true if the buffer was replaced
+ */
+bool DeferredPipeline::reserveBuffer(
+    std::shared_ptr<Buffer> &buffer, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryUsage memoryUsage
+) {
+    if (buffer && buffer->getSize() >= size) {
+        return false;
+    }
+
+    // Grow by doubling so that a slowly growing scene does not reallocate every frame
+    vk::DeviceSize capacity = buffer ? buffer->getSize() : size;
+    while (capacity < size) {
+        capacity *= 2;
+    }
+
+    // The previous frame using this image is complete so the old buffer can go immediately
+    buffer = engine.getBufferManager().aquireShared(capacity, usage, memoryUsage);
+    return true;
+}
 
-    geometryPipeline->bind(geometryCommandBuffer, activeImage);
-    geometryPipeline->bindCamera(0, Internal::StandardBindings::CameraUniform, engine);
+/**
+ * Points the pipeline's descriptor for the active image at the buffer unless it already is.
+ * The tracker holds on to the bound buffer so that it cannot be freed and its address reused
+ * by another buffer while the descriptor still points at it.
+ */
+void DeferredPipeline::bindPerImage(
+    Pipeline &pipeline, std::vector<std::shared_ptr<Buffer>> &bound, uint32_t set, uint32_t binding,
+    const std::shared_ptr<Buffer> &buffer
+) {
+    if (bound[activeImage] != buffer) {
+        pipeline.bindBuffer(set, binding, activeImage, *buffer);
+        bound[activeImage] = buffer;
+    }
+}
+
+/**
+ * Splits the sorted draws into runs of the same mesh and material
+ */
+void DeferredPipeline::findDrawRuns() {
+    drawRuns.clear();
+
+    uint32_t first = 0;
+    auto count = static_cast<uint32_t>(geometryDraws.size());
+    while (first < count) {
+        auto &draw = geometryDraws[first];
+        auto stateKey = draw.key & ~DrawKey::DepthMask;
+
+        uint32_t end = first + 1;
+        while (end < count && (geometryDraws[end].key & ~DrawKey::DepthMask) == stateKey) {
+            // Ids are truncated in the key so it can only rule draws out
+            auto &other = geometryDraws[end];
+            if (other.mesh != draw.mesh || other.material != draw.material) {
+                break;
+            }
+            ++end;
+        }
+
+        drawRuns.emplace_back(first, end);
+        first = end;
+    }
 }
 
-void DeferredPipeline::renderGeometry(const Entity *entity) {
-    Engine::IsComponent auto &renderData = entity->get<MeshRenderer>();
-    Engine::IsComponent auto &plannerData = entity->get<PlannerData>();
-    auto mesh = renderData.getMesh();
+void DeferredPipeline::writeInstances() {
+    auto &buffer = instanceBuffers[activeImage];
+    reserveBuffer(
+        buffer,
+        std::max(geometryDraws.size(), MinInstanceCapacity) * sizeof(InstanceData),
+        vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryUsage::eCPUToGPU
+    );
+
+    auto instances = static_cast<InstanceData *>(buffer->getMappedData());
+    for (size_t index = 0; index < geometryDraws.size(); ++index) {
+        instances[index].entitySlot = geometryDraws[index].entitySlot;
+    }
+    buffer->flushRange(0, geometryDraws.size() * sizeof(InstanceData));
+}
+
+/**
+ * Records the compute pass that culls every instance and fills in the indirect draws.
+ * The visible instances of each run are packed into the visible buffer from the run's first instance.
+ */
+void DeferredPipeline::cullInstances() {
+    auto &resources = culling[activeImage];
+    if (!resources.task) {
+        resources.task = engine.createComputeTask()
+            .fromBytes(BUILTIN_INSTANCE_CULL_COMP_GLSL, BUILTIN_INSTANCE_CULL_COMP_GLSL_SIZE)
+            .withPushConstant<CullParameters>()
+            .withStorageBuffer(CullBindings::CullCandidates, UsageType::Input)
+            .withStorageBuffer(CullBindings::CullGroups, UsageType::Input)
+            .withStorageBuffer(CullBindings::CullDraws, UsageType::InputOutput)
+            .withStorageBuffer(CullBindings::CullVisible, UsageType::Output)
+            .withStorageBuffer(CullBindings::CullCounters, UsageType::InputOutput)
+            .withStorageBuffer(CullBindings::CullEntities, UsageType::Input)
+            .withWorkgroups(CullGroupSize)
+            .build();
+
+        resources.counters = engine.getBufferManager().aquireShared(
+            sizeof(uint32_t), vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryUsage::eCPUToGPU
+        );
+        *static_cast<uint32_t *>(resources.counters->getMappedData()) = 0;
+        resources.counters->flushRange(0, sizeof(uint32_t));
+    }
+
+    auto instanceCount = static_cast<uint32_t>(geometryDraws.size());
+    reserveBuffer(
+        resources.groupIds,
+        std::max<size_t>(instanceCount, MinInstanceCapacity) * sizeof(uint32_t),
+        vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryUsage::eCPUToGPU
+    );
+    reserveBuffer(
+        resources.draws,
+        std::max(drawRuns.size(), MinDrawGroupCapacity) * sizeof(DrawGroup),
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+        vk::MemoryUsage::eCPUToGPU
+    );
+    reserveBuffer(
+        resources.visible,
+        std::max<size_t>(instanceCount, MinInstanceCapacity) * sizeof(InstanceData),
+        vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryUsage::eGPUOnly
+    );
+
+    auto groupIds = static_cast<uint32_t *>(resources.groupIds->getMappedData());
+    auto draws = static_cast<DrawGroup *>(resources.draws->getMappedData());
+    for (uint32_t run = 0; run < drawRuns.size(); ++run) {
+        auto [first, end] = drawRuns[run];
+        auto mesh = geometryDraws[first].mesh;
+
+        // Runs without a mesh are left with no indices and are skipped by the shader
+        auto &draw = draws[run];
+        draw.command = vk::DrawIndexedIndirectCommand(mesh ? mesh->getIndexCount() : 0, 0, 0, 0, first);
+
+        auto bounds = mesh ? mesh->getBounds() : nullptr;
+        if (bounds) {
+            draw.boundsMin = { bounds->xMin, bounds->yMin, bounds->zMin, 1 };
+            draw.boundsMax = { bounds->xMax, bounds->yMax, bounds->zMax, 1 };
+        } else {
+            draw.boundsMin = {};
+            draw.boundsMax = {};
+        }
+
+        std::fill(groupIds + first, groupIds + end, run);
+    }
+    resources.groupIds->flushRange(0, instanceCount * sizeof(uint32_t));
+    resources.draws->flushRange(0, drawRuns.size() * sizeof(DrawGroup));
+
+    // Buffers may have been replaced. This image's descriptor set is not in use so it is safe to rewrite
+    resources.task->bindBuffer(CullBindings::CullCandidates, instanceBuffers[activeImage]);
+    resources.task->bindBuffer(CullBindings::CullGroups, resources.groupIds);
+    resources.task->bindBuffer(CullBindings::CullDraws, resources.draws);
+    resources.task->bindBuffer(CullBindings::CullVisible, resources.visible);
+    resources.task->bindBuffer(CullBindings::CullCounters, resources.counters);
+    resources.task->bindBuffer(CullBindings::CullEntities, entityStorage);
+
+    CullParameters parameters {};
+    auto camera = engine.getCamera();
+    if (camera) {
+        std::copy_n(camera->getFrustum().getPlanes(), 6, parameters.planes);
+    } else {
+        // Nothing is rejected without a camera
+        std::fill(std::begin(parameters.planes), std::end(parameters.planes), glm::vec4 { 0, 0, 0, 1 });
+    }
+    parameters.instanceCount = instanceCount;
+
+    if (instanceCount > 0) {
+        // Round up so that the last partial workgroup is dispatched
+        auto elements = (instanceCount + CullGroupSize - 1) / CullGroupSize * CullGroupSize;
+        resources.task->executeBeforeRender(parameters, elements);
+    }
+}
+
+void DeferredPipeline::bindGeometryStorage(
+    Pipeline &pipeline, GeometryDescriptors &descriptors, const std::shared_ptr<Buffer> &instances
+) {
+    bindPerImage(pipeline, descriptors.entities, 1, Internal::StandardBindings::EntityStorage, entityStorage);
+    bindPerImage(pipeline, descriptors.instances, 1, Internal::StandardBindings::InstanceStorage, instances);
+}
+
+/**
+ * Draws every instance of the run. The mesh must already be bound
+ */
+void DeferredPipeline::recordDraw(uint32_t run, const Mesh *mesh) {
+    auto [first, end] = drawRuns[run];
+
+    if (gpuCulling) {
+        // The instance count was filled in by the culling pass
+        geometryCommandBuffer.drawIndexedIndirect(
+            culling[activeImage].draws->buffer(), run * sizeof(DrawGroup), 1, sizeof(DrawGroup)
+        );
+    } else {
+        geometryCommandBuffer.drawIndexed(mesh->getIndexCount(), end - first, 0, 0, first);
+    }
+}
+
+void DeferredPipeline::recordDepth(uint32_t run) {
+    auto [first, end] = drawRuns[run];
+    auto mesh = geometryDraws[first].mesh;
 
     if (!mesh) {
         return;
     }
 
-    if (mesh != lastMesh) {
-        mesh->bind(geometryCommandBuffer);
-        lastMesh = mesh;
+    mesh->bind(geometryState);
+    recordDraw(run, mesh);
+
+    ++depthPrepassStats.draws;
+    // The GPU culled count is not known when recording, so this counts every candidate instance
+    depthPrepassStats.triangles += static_cast<uint64_t>(mesh->getIndexCount() / 3) * (end - first);
+}
+
+void DeferredPipeline::recordGeometry(uint32_t run, Pipeline &pipeline) {
+    auto [first, end] = drawRuns[run];
+    auto &draw = geometryDraws[first];
+    auto mesh = draw.mesh;
+
+    if (!mesh) {
+        return;
     }
 
-    uint32_t dyanmicOffset = plannerData.render.uniformOffset;
+    mesh->bind(geometryState);
 
-    std::array<vk::DescriptorSet, 1> boundDescriptors = {
-        plannerData.render.buffer->set
-    };
+    auto material = draw.material;
+    if (!material) {
+        material = defaultMaterial;
+    }
+
+    // Draws are sorted by material so this mostly skips
+    if (material != lastMaterial) {
+        pipeline.bindMaterial(geometryState, material);
+        lastMaterial = material;
+    }
+
+    recordDraw(run, mesh);
+}
+
+/**
+ * Writes the lights queued for this frame and, when clustering, records the compute pass that
+ * places them into clusters. Every lighting pipeline reads these so they are always kept valid.
+ */
+void DeferredPipeline::prepareLights() {
+    auto &resources = lightClusters[activeImage];
+    auto lightCount = static_cast<uint32_t>(clusteredLights.size());
+
+    reserveBuffer(
+        resources.activeLights,
+        std::max<size_t>(lightCount, MinLightCapacity) * sizeof(uint32_t),
+        vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryUsage::eCPUToGPU
+    );
+    // Only the clustered resolve reads the clusters, the other lighting pipelines just need something bound
+    reserveBuffer(
+        resources.clusters,
+        (clusteredLighting ? ClusterCount : 1) * sizeof(LightCluster),
+        vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryUsage::eGPUOnly
+    );
 
-    geometryPipeline->bindDescriptorSets(geometryCommandBuffer, 1, vkUseArray(boundDescriptors), 1, &dyanmicOffset);
+    if (!clusteredLighting) {
+        directionalLightCount = 0;
+        return;
+    }
+
+    // Directional lights reach every cluster so they are kept at the front and shaded everywhere instead
+    auto activeLights = static_cast<uint32_t *>(resources.activeLights->getMappedData());
+    uint32_t index = 0;
+    for (auto entity : clusteredLights) {
+        if (entity->get<Light>().getType() == LightType::Directional) {
+            activeLights[index++] = entity->get<PlannerData>().light.slot;
+        }
+    }
+    directionalLightCount = index;
+    for (auto entity : clusteredLights) {
+        if (entity->get<Light>().getType() != LightType::Directional) {
+            activeLights[index++] = entity->get<PlannerData>().light.slot;
+        }
+    }
+    resources.activeLights->flushRange(0, lightCount * sizeof(uint32_t));
+
+    if (!resources.task) {
+        resources.task = engine.createComputeTask()
+            .fromBytes(BUILTIN_LIGHT_CLUSTER_COMP_GLSL, BUILTIN_LIGHT_CLUSTER_COMP_GLSL_SIZE)
+            .withPushConstant<ClusterParameters>()
+            .withStorageBuffer(ClusterBindings::ClusterLights, UsageType::Input)
+            .withStorageBuffer(ClusterBindings::ClusterActiveLights, UsageType::Input)
+            .withStorageBuffer(ClusterBindings::ClusterOutput, UsageType::Output)
+            .withWorkgroups(ClusterGroupSize)
+            .build();
+    }
 
-    auto material = renderData.getMaterial();
-    if (material) {
-        geometryPipeline->bindMaterial(geometryCommandBuffer, material);
+    // Buffers may have been replaced. This image's descriptor set is not in use so it is safe to rewrite
+    resources.task->bindBuffer(ClusterBindings::ClusterLights, lightStorage);
+    resources.task->bindBuffer(ClusterBindings::ClusterActiveLights, resources.activeLights);
+    resources.task->bindBuffer(ClusterBindings::ClusterOutput, resources.clusters);
+
+    ClusterParameters parameters {};
+    parameters.firstLight = directionalLightCount;
+    auto camera = engine.getCamera();
+    if (camera) {
+        auto ubo = camera->getUBO();
+        parameters.view = ubo->view;
+        parameters.projectionScale = { ubo->proj[0][0], ubo->proj[1][1] };
+        parameters.nearClip = camera->getNearClip();
+        parameters.farClip = camera->getFarClip();
+        parameters.lightCount = lightCount;
     } else {
-        geometryPipeline->bindMaterial(geometryCommandBuffer, defaultMaterial);
+        // Nothing can be placed without a camera so only the directional lights are shaded
+        parameters.nearClip = 1;
+        parameters.farClip = 1;
+        parameters.lightCount = directionalLightCount;
     }
 
-    geometryCommandBuffer.drawIndexed(mesh->getIndexCount(), 1, 0, 0, 0);
+    // Round up so that the last partial workgroup is dispatched
+    auto elements = (ClusterCount + ClusterGroupSize - 1) / ClusterGroupSize * ClusterGroupSize;
+    resources.task->executeBeforeRender(parameters, elements);
+}
+
+/**
+ * Points the lighting pipeline's storage descriptors for the active image at this frame's buffers
+ */
+void DeferredPipeline::bindLightingStorage(Pipeline &pipeline, LightingDescriptors &descriptors) {
+    auto &resources = lightClusters[activeImage];
+
+    bindPerImage(pipeline, descriptors.lights, 1, DeferredBindings::LightStorageBinding, lightStorage);
+    bindPerImage(
+        pipeline, descriptors.activeLights, 1, DeferredBindings::ActiveLightsBinding, resources.activeLights
+    );
+    bindPerImage(pipeline, descriptors.clusters, 1, DeferredBindings::ClustersBinding, resources.clusters);
 }
 
 void DeferredPipeline::endGeometry() {
+    // Group draws by state so that binds are shared, then front to back within each group
+    sortDraws(geometryDraws, sortScratch);
+
+    // Runs of the same mesh and material become one instanced draw
+    findDrawRuns();
+    writeInstances();
+
+    if (gpuCulling) {
+        cullInstances();
+    }
+
+    // Culling packs the visible instances into a buffer of their own
+    auto &instances = gpuCulling ? culling[activeImage].visible : instanceBuffers[activeImage];
+    auto &pipeline = depthPrepass ? *prepassGeometryPipeline : *geometryPipeline;
+    bindGeometryStorage(pipeline, depthPrepass ? prepassGeometryDescriptors : geometryDescriptors, instances);
+    if (depthPrepass) {
+        bindGeometryStorage(*depthPrepassPipeline, depthPrepassDescriptors, instances);
+    }
+
+    prepareLights();
+
+    // Culling and light clustering must be recorded outside of the render pass
+    controller.beginRenderPass(
+        isReducedLighting() ? sampledGBufferRenderPass : renderPass, activeFramebuffer, framebufferSize,
+        { 0, 0, 0, 0 }, 2
+    );
+
+    // Binding applies any storage descriptor change
+    if (depthPrepass) {
+        depthPrepassPipeline->bind(geometryState, activeImage);
+        for (uint32_t run = 0; run < drawRuns.size(); ++run) {
+            recordDepth(run);
+        }
+    }
+
+    pipeline.bind(geometryState, activeImage);
+    lastMaterial = nullptr;
+    for (uint32_t run = 0; run < drawRuns.size(); ++run) {
+        recordGeometry(run, pipeline);
+    }
+
     geometryCommandBuffer.end();
     controller.addToRender(geometryCommandBuffer);
 }
@@ -421,42 +1369,137 @@ void DeferredPipeline::beginLighting() {
         &mainCbInheritance
     );
     lightingCommandBuffer.begin(renderBeginInfo);
+    lightingState.begin(lightingCommandBuffer);
 
     controller.nextSubpass();
+}
 
-    fullScreenLights.clear();
-    worldLights.clear();
+void DeferredPipeline::renderLight(const Entity *entity, const Light &light) {
+    // Below full resolution, directional lights are still shaded at full resolution on their own
+    bool directional = light.getType() == LightType::Directional;
+
+    if (clusteredLighting) {
+        clusteredLights.emplace_back(entity);
+        if (directional && isReducedLighting()) {
+            fullScreenLights.emplace_back(entity);
+        }
+        return;
+    }
+
+    // Only lights whose volume is entirely in front of the camera can be drawn as one
+    auto camera = engine.getCamera();
+    LightVolume volume;
+    if (camera && placeLightVolume(entity, light, *camera, volume)) {
+        worldLights.push_back(volume);
+    } else if (!directional && isReducedLighting()) {
+        reducedLights.emplace_back(entity);
+    } else {
+        fullScreenLights.emplace_back(entity);
+    }
 }
 
-void DeferredPipeline::renderLight(const Entity *entity) {
-    Engine::IsComponent auto &light = entity->get<Light>();
+/**
+ * Fits a sphere or cone around the reach of the light.
+ * @returns false if the light must be drawn full screen instead
+ */
+bool DeferredPipeline::placeLightVolume(
+    const Entity *entity, const Light &light, const Camera &camera, LightVolume &volume
+) const {
+    if (light.getType() == LightType::Directional) {
+        return false;
+    }
+
+    auto &transform = entity->getTransform();
+    glm::vec3 position = transform.getPosition();
+    float range = light.getRange();
+
+    // The furthest the camera's near plane reaches from the camera
+    auto ubo = camera.getUBO();
+    float nearReach = camera.getNearClip() * std::sqrt(
+        1 + 1 / (ubo->proj[0][0] * ubo->proj[0][0]) + 1 / (ubo->proj[1][1] * ubo->proj[1][1])
+    );
+    glm::vec3 toCamera = camera.getPosition() - position;
+
+    if (light.getType() == LightType::Spot && light.getSpotAngle() <= MaxConeAngle) {
+        glm::vec3 direction = glm::normalize(glm::rotate(transform.getRotation(), glm::vec3(0, 0, 1)));
+        // The rim is pushed out past the round cone
+        float spread = std::tan(glm::radians(light.getSpotAngle())) * lightCone->getBounds()->xMax;
+
+        float along = glm::dot(toCamera, direction);
+        float across = glm::length(toCamera - direction * along);
+        bool inside = along > -nearReach && along < range + nearReach &&
+            across < std::max(along, 0.0f) * spread + nearReach * (1 + spread);
+        if (inside) {
+            return false;
+        }
+
+        // Any axes at right angles to the direction will do
+        glm::vec3 side = glm::normalize(
+            glm::cross(direction, std::abs(direction.z) < 0.9f ? glm::vec3(0, 0, 1) : glm::vec3(1, 0, 0))
+        );
+        glm::vec3 up = glm::cross(direction, side);
+        float radius = range * std::tan(glm::radians(light.getSpotAngle()));
+
+        volume.mesh = lightCone;
+        volume.transform = glm::mat4(
+            glm::vec4(side * radius, 0), glm::vec4(up * radius, 0), glm::vec4(direction * range, 0),
+            glm::vec4(position, 1)
+        );
+    } else {
+        if (glm::length(toCamera) < range * lightSphere->getBounds()->xMax + nearReach) {
+            return false;
+        }
+
+        volume.mesh = lightSphere;
+        volume.transform = glm::mat4(
+            glm::vec4(range, 0, 0, 0), glm::vec4(0, range, 0, 0), glm::vec4(0, 0, range, 0), glm::vec4(position, 1)
+        );
+    }
+
+    // The depths of the nearest and furthest points the light can reach
+    float viewDepth = -(ubo->view * glm::vec4(position, 1)).z;
+    auto toDepth = [&](float depth) {
+        depth = std::max(depth, camera.getNearClip());
+        return std::clamp((ubo->proj[2][2] * -depth + ubo->proj[3][2]) / depth, 0.0f, 1.0f);
+    };
 
-    // TODO: Use the fullscreen one only for lights which cross the near field or directional lights
-    // Use the 3D one for all other lights
-//    if (light.getType() == LightType::Directional) {
-    fullScreenLights.emplace_back(entity);
-//    } else {
-//        worldLights.emplace_back(entity);
-//    }
+    volume.entity = entity;
+    volume.minDepth = toDepth(viewDepth - range);
+    volume.maxDepth = toDepth(viewDepth + range);
+    return true;
 }
 
 void DeferredPipeline::endLighting() {
     // FIXME: Need to render one anyway otherwise we get blank
 
-    fullScreenLightingPipeline->bind(lightingCommandBuffer, activeImage);
-    for (auto entity : fullScreenLights) {
-        Engine::IsComponent auto &plannerData = entity->get<PlannerData>();
-        uint32_t dynamicOffset = plannerData.light.uniformOffset;
-
-        std::array<vk::DescriptorSet, 1> boundDescriptors = {
-            plannerData.light.buffer->set
-        };
+    LightPushConstants base {};
+    base.directionalCount = directionalLightCount;
+    base.pixelSize = {
+        1.0f / static_cast<float>(framebufferSize.width),
+        1.0f / static_cast<float>(framebufferSize.height)
+    };
+    base.divisor = getLightingDivisor();
+
+    auto camera = engine.getCamera();
+    if (clusteredLighting && camera) {
+        // Inverse of the slice depths used when clustering
+        float logDepthRange = std::log(camera->getFarClip() / camera->getNearClip());
+        base.sliceScale = ClustersZ / logDepthRange;
+        base.sliceBias = ClustersZ * std::log(camera->getNearClip()) / logDepthRange;
+    }
 
-        fullScreenLightingPipeline->bindDescriptorSets(
-            lightingCommandBuffer, 1, vkUseArray(boundDescriptors), 1, &dynamicOffset
-        );
+    if (clusteredLighting && !isReducedLighting()) {
+        bindLightingStorage(*clusteredLightingPipeline, clusteredLightDescriptors);
+        clusteredLightingPipeline->bind(lightingState, activeImage);
+        clusteredLightingPipeline->push(lightingState, vk::ShaderStageFlagBits::eFragment, base);
         lightingCommandBuffer.draw(3, 1, 0, 0);
     }
+
+    // Below full resolution these are only the directional lights
+    drawFullScreenLights(*fullScreenLightingPipeline, fullScreenLightDescriptors, fullScreenLights, base);
+    if (!isReducedLighting()) {
+        drawLightVolumes(*worldLightingPipeline, worldLightDescriptors, base, device.supportsDepthBounds);
+    }
     // TODO: Render all lights woo
 
     // Temporary
@@ -465,9 +1508,151 @@ void DeferredPipeline::endLighting() {
 
     lightingCommandBuffer.end();
     controller.addToRender(lightingCommandBuffer);
+
+    // Recorded now but only added in end(), once the render pass has finished with the G-buffer
+    if (isReducedLighting()) {
+        recordReducedLighting(base);
+        recordUpsample();
+    }
+}
+
+void DeferredPipeline::drawFullScreenLights(
+    Pipeline &pipeline, LightingDescriptors &descriptors, const std::vector<const Entity *> &lights,
+    const LightPushConstants &base
+) {
+    if (lights.empty()) {
+        return;
+    }
+
+    // Every light reads from the one storage buffer, so only the slot changes between draws
+    bindLightingStorage(pipeline, descriptors);
+    pipeline.bind(lightingState, activeImage);
+    for (auto entity : lights) {
+        Engine::IsComponent auto &plannerData = entity->get<PlannerData>();
+
+        LightPushConstants constants = base;
+        constants.lightSlot = plannerData.light.slot;
+        pipeline.push(lightingState, vk::ShaderStageFlagBits::eFragment, constants);
+        lightingCommandBuffer.draw(3, 1, 0, 0);
+    }
+}
+
+void DeferredPipeline::drawLightVolumes(
+    Pipeline &pipeline, LightingDescriptors &descriptors, const LightPushConstants &base, bool depthBounds
+) {
+    if (worldLights.empty()) {
+        return;
+    }
+
+    bindLightingStorage(pipeline, descriptors);
+    pipeline.bind(lightingState, activeImage);
+    for (auto &volume : worldLights) {
+        Engine::IsComponent auto &plannerData = volume.entity->get<PlannerData>();
+
+        volume.mesh->bind(lightingState);
+        if (depthBounds) {
+            lightingCommandBuffer.setDepthBounds(volume.minDepth, volume.maxDepth);
+        }
+
+        LightPushConstants constants = base;
+        constants.volume = volume.transform;
+        constants.lightSlot = plannerData.light.slot;
+        pipeline.push(
+            lightingState, vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment, constants
+        );
+        lightingCommandBuffer.drawIndexed(volume.mesh->getIndexCount(), 1, 0, 0, 0);
+    }
+}
+
+/**
+ * Shades the point and spot lights into the reduced lighting target
+ */
+void DeferredPipeline::recordReducedLighting(const LightPushConstants &base) {
+    lightingCommandBuffer = reducedLightingCommandBuffers[activeImage];
+
+    vk::CommandBufferInheritanceInfo inheritance(
+        reducedLightingRenderPass,
+        0,
+        reducedLightingFramebuffer
+    );
+
+    vk::CommandBufferBeginInfo beginInfo(
+        vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+        &inheritance
+    );
+    lightingCommandBuffer.begin(beginInfo);
+    lightingState.begin(lightingCommandBuffer);
+
+    lightingCommandBuffer.setViewport(
+        0, vk::Viewport(
+            0.0f, 0.0f,
+            static_cast<float>(reducedLightingSize.width), static_cast<float>(reducedLightingSize.height),
+            0.0f, 1.0f
+        )
+    );
+    lightingCommandBuffer.setScissor(0, vk::Rect2D({ 0, 0 }, reducedLightingSize));
+
+    if (clusteredLighting) {
+        bindLightingStorage(*reducedClusteredLightingPipeline, reducedClusteredLightDescriptors);
+        reducedClusteredLightingPipeline->bind(lightingState, activeImage);
+        reducedClusteredLightingPipeline->push(lightingState, vk::ShaderStageFlagBits::eFragment, base);
+        lightingCommandBuffer.draw(3, 1, 0, 0);
+    }
+
+    drawFullScreenLights(*reducedFullScreenLightingPipeline, reducedFullScreenLightDescriptors, reducedLights, base);
+    drawLightVolumes(*reducedWorldLightingPipeline, reducedWorldLightDescriptors, base, false);
+
+    lightingCommandBuffer.end();
+}
+
+/**
+ * Adds the reduced lighting onto the output, lit surface colour included
+ */
+void DeferredPipeline::recordUpsample() {
+    auto commandBuffer = upsampleCommandBuffers[activeImage];
+
+    vk::CommandBufferInheritanceInfo inheritance(
+        upsampleRenderPass,
+        0,
+        activeUpsampleFramebuffer
+    );
+
+    vk::CommandBufferBeginInfo beginInfo(
+        vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+        &inheritance
+    );
+    commandBuffer.begin(beginInfo);
+    lightingState.begin(commandBuffer);
+
+    UpsamplePushConstants constants {};
+    constants.divisor = getLightingDivisor();
+
+    upsamplePipeline->bind(lightingState, activeImage);
+    upsamplePipeline->push(lightingState, vk::ShaderStageFlagBits::eFragment, constants);
+    commandBuffer.draw(3, 1, 0, 0);
+
+    commandBuffer.end();
 }
 
 void DeferredPipeline::end() {
     controller.endRenderPass();
+
+    if (isReducedLighting()) {
+        controller.beginRenderPass(
+            reducedLightingRenderPass, reducedLightingFramebuffer, reducedLightingSize, { 0, 0, 0, 0 }
+        );
+        controller.addToRender(reducedLightingCommandBuffers[activeImage]);
+        controller.endRenderPass();
+
+        controller.beginRenderPass(upsampleRenderPass, activeUpsampleFramebuffer, framebufferSize, { 0, 0, 0, 0 });
+        controller.addToRender(upsampleCommandBuffers[activeImage]);
+        controller.endRenderPass();
+    }
+}
+
+CommandStateStats DeferredPipeline::getCommandStats() const {
+    auto stats = geometryState.getStats();
+    stats += lightingState.getStats();
+    return stats;
 }
 }
\ No newline at end of file
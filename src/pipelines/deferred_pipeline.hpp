@@ -2,9 +2,70 @@
 
 #include <vulkan/vulkan.hpp>
 #include "tech-core/forward.hpp"
+#include "tech-core/engine.hpp"
+#include "tech-core/command_state.hpp"
+#include "tech-core/buffer.hpp"
+#include "draw_list.hpp"
+#include <glm/glm.hpp>
+#include <memory>
+#include <utility>
 
 namespace Engine::Internal {
 
+// The entity drawn by one instance. Must match InstanceSSBO in standard-vert.glsl
+struct InstanceData {
+    uint32_t entitySlot;
+};
+
+struct LightPushConstants {
+    // Places the unit light volume around the light
+    glm::mat4 volume;
+    uint32_t lightSlot;
+    // Only used by the clustered resolve
+    uint32_t directionalCount;
+    float sliceScale;
+    float sliceBias;
+    // One over the framebuffer size, for rebuilding positions from depth
+    glm::vec2 pixelSize;
+    // Only used at reduced lighting resolutions. Full resolution pixels across each lighting pixel
+    uint32_t divisor;
+};
+
+struct UpsamplePushConstants {
+    // Full resolution pixels across each reduced lighting pixel
+    uint32_t divisor;
+};
+
+/**
+ * One run of instances sharing a mesh and material, as read by the instance culling shader.
+ * The command is filled in by the CPU with no instances, the shader then adds the visible ones.
+ */
+struct DrawGroup {
+    vk::DrawIndexedIndirectCommand command;
+    uint32_t padding[3];
+    // w is 0 when the mesh has no bounds and must always be drawn
+    glm::vec4 boundsMin;
+    glm::vec4 boundsMax;
+};
+
+static_assert(sizeof(DrawGroup) == 64, "DrawGroup must match the layout in instance_cull_comp.glsl");
+
+struct CullParameters {
+    glm::vec4 planes[6];
+    uint32_t instanceCount;
+};
+
+struct ClusterParameters {
+    glm::mat4 view;
+    // proj[0][0] and proj[1][1]
+    glm::vec2 projectionScale;
+    float nearClip;
+    float farClip;
+    // The directional lights at the start of the active light list are not binned
+    uint32_t firstLight;
+    uint32_t lightCount;
+};
+
 class DeferredPipeline {
 public:
     DeferredPipeline(RenderEngine &engine, VulkanDevice &device, ExecutionController &controller);
@@ -17,16 +78,84 @@ public:
     );
 
     void begin(uint32_t imageIndex);
+    /**
+     * The entity and light storage for this frame, indexed by the entity and light slots.
+     * Must be called after begin()
+     */
+    void bindSceneStorage(const std::shared_ptr<Buffer> &entities, const std::shared_ptr<Buffer> &lights);
+
+    /**
+     * The state part of the sort key for drawing the mesh with the material.
+     * The mesh and material ids are truncated so the key may be shared with other pairs.
+     */
+    uint64_t getDrawKey(const Mesh *, const Material *) const;
 
     void beginGeometry();
-    void renderGeometry(const Entity *);
+    /**
+     * Queues the entity to be drawn. Draws are sorted by key and recorded in endGeometry().
+     * Consecutive draws of the same mesh and material are recorded as one instanced draw.
+     * @param entitySlot Where the entity's transform is in the entity storage
+     */
+    void renderGeometry(const MeshRenderer &, uint32_t entitySlot, uint64_t sortKey);
     void endGeometry();
 
+    /**
+     * Queues the light to be drawn. Lights must be queued before endGeometry() so that
+     * they can be placed into clusters before the render pass starts.
+     * Without clustering, point and spot lights are drawn as volumes covering only their range,
+     * unless the camera is inside the volume.
+     */
+    void renderLight(const Entity *, const Light &);
+
     void beginLighting();
-    void renderLight(const Entity *);
     void endLighting();
 
     void end();
+
+    /**
+     * When enabled, every queued instance is culled against the camera by a compute pass and
+     * the geometry is drawn indirectly using the results. The CPU no longer needs to cull.
+     * Ignored when the device cannot start indirect draws from a non-zero instance.
+     */
+    void setGpuCulling(bool enabled);
+    bool isGpuCulling() const { return gpuCulling; }
+    /**
+     * Instances that passed GPU culling the last time the current swap chain image was rendered
+     */
+    uint32_t getGpuVisibleInstances() const { return gpuVisibleInstances; }
+
+    /**
+     * When enabled, a compute pass sorts the lights into clusters dividing up the view, then
+     * a single full screen pass shades each pixel with only the lights of its cluster.
+     * Otherwise every light is a full screen pass of its own.
+     */
+    void setClusteredLighting(bool enabled) { clusteredLighting = enabled; }
+    bool isClusteredLighting() const { return clusteredLighting; }
+
+    /**
+     * When enabled, the geometry pass first draws depth alone using only vertex positions.
+     * The G-buffer is then drawn testing for equal depth, so hidden surfaces are never shaded.
+     */
+    void setDepthPrepass(bool enabled) { depthPrepass = enabled; }
+    bool isDepthPrepass() const { return depthPrepass; }
+
+    /**
+     * Below full resolution, point and spot lights are shaded into a smaller target after the
+     * render pass, then upsampled onto the output weighted by how closely depth and normals match.
+     * Directional lights are always shaded at full resolution.
+     * Changing the resolution waits for the device to be idle.
+     */
+    void setLightingResolution(LightingResolution);
+    LightingResolution getLightingResolution() const { return lightingResolution; }
+    /**
+     * The work done by the depth pre-pass since begin()
+     */
+    const DepthPrepassStats &getDepthPrepassStats() const { return depthPrepassStats; }
+
+    /**
+     * Binds recorded and skipped by the geometry and lighting passes since begin()
+     */
+    CommandStateStats getCommandStats() const;
 private:
     // External
     VulkanDevice &device;
@@ -36,36 +165,170 @@ private:
     ExecutionController &controller;
     vk::Format depthFormat;
     vk::Extent2D framebufferSize;
+    std::shared_ptr<Image> depthAttachment;
 
     // Cached
     const Material *defaultMaterial;
+    const Mesh *lightSphere;
+    const Mesh *lightCone;
 
     // Owned
     vk::RenderPass renderPass;
+    // Compatible with renderPass, but keeps the G-buffer to be sampled at reduced lighting resolutions
+    vk::RenderPass sampledGBufferRenderPass;
     std::vector<vk::Framebuffer> framebuffers;
     std::shared_ptr<Image> attachmentDiffuseOcclusion;
     std::shared_ptr<Image> attachmentNormalRoughness;
-    std::shared_ptr<Image> attachmentPosition;
+    vk::Sampler gBufferSampler;
+
+    // Shades into attachmentReducedLight, which is then upsampled onto the output
+    vk::RenderPass reducedLightingRenderPass;
+    vk::RenderPass upsampleRenderPass;
+    vk::Framebuffer reducedLightingFramebuffer;
+    std::vector<vk::Framebuffer> upsampleFramebuffers;
+    std::shared_ptr<Image> attachmentReducedLight;
+    vk::Extent2D reducedLightingSize;
 
     std::unique_ptr<Pipeline> geometryPipeline;
+    // Draws depth alone, then the G-buffer only where the depth matches
+    std::unique_ptr<Pipeline> depthPrepassPipeline;
+    std::unique_ptr<Pipeline> prepassGeometryPipeline;
     std::unique_ptr<Pipeline> fullScreenLightingPipeline;
     std::unique_ptr<Pipeline> worldLightingPipeline;
+    std::unique_ptr<Pipeline> clusteredLightingPipeline;
+    std::unique_ptr<Pipeline> reducedFullScreenLightingPipeline;
+    std::unique_ptr<Pipeline> reducedWorldLightingPipeline;
+    std::unique_ptr<Pipeline> reducedClusteredLightingPipeline;
+    std::unique_ptr<Pipeline> upsamplePipeline;
+
+    std::vector<vk::CommandBuffer> geometryCommandBuffers;
+    std::vector<vk::CommandBuffer> lightingCommandBuffers;
+    std::vector<vk::CommandBuffer> reducedLightingCommandBuffers;
+    std::vector<vk::CommandBuffer> upsampleCommandBuffers;
+
+    // Per instance transforms for each swap chain image
+    std::vector<std::shared_ptr<Buffer>> instanceBuffers;
+
+    // GPU culling resources for each swap chain image
+    struct CullingResources {
+        std::unique_ptr<ComputeTask> task;
+        std::shared_ptr<Buffer> groupIds;
+        std::shared_ptr<Buffer> draws;
+        std::shared_ptr<Buffer> visible;
+        std::shared_ptr<Buffer> counters;
+    };
+    std::vector<CullingResources> culling;
+
+    // Light clustering resources for each swap chain image
+    struct ClusterResources {
+        std::unique_ptr<ComputeTask> task;
+        std::shared_ptr<Buffer> activeLights;
+        std::shared_ptr<Buffer> clusters;
+    };
+    std::vector<ClusterResources> lightClusters;
 
     // Transient
     vk::CommandBuffer geometryCommandBuffer;
     vk::CommandBuffer lightingCommandBuffer;
-    const Mesh *lastMesh { nullptr };
+    CommandState geometryState;
+    CommandState lightingState;
+    std::shared_ptr<Buffer> entityStorage;
+    std::shared_ptr<Buffer> lightStorage;
+    const Material *lastMaterial { nullptr };
+    std::vector<DrawItem> geometryDraws;
+    std::vector<DrawItem> sortScratch;
+    // The [first, end) ranges of geometryDraws drawn together
+    std::vector<std::pair<uint32_t, uint32_t>> drawRuns;
     uint32_t activeImage { 0 };
     vk::Framebuffer activeFramebuffer;
+    vk::Framebuffer activeUpsampleFramebuffer;
+
+    // A light drawn as a sphere or cone around the pixels it can reach
+    struct LightVolume {
+        const Entity *entity;
+        const Mesh *mesh;
+        glm::mat4 transform;
+        // Only pixels with depths in this range can be lit
+        float minDepth;
+        float maxDepth;
+    };
 
     std::vector<const Entity *> fullScreenLights;
-    std::vector<const Entity *> worldLights;
+    std::vector<LightVolume> worldLights;
+    // Point and spot lights drawn full screen at the reduced lighting resolution
+    std::vector<const Entity *> reducedLights;
+    std::vector<const Entity *> clusteredLights;
+    uint32_t directionalLightCount { 0 };
+
+    // State
+    bool gpuCulling { false };
+    bool clusteredLighting { false };
+    bool depthPrepass { false };
+    LightingResolution lightingResolution { LightingResolution::Full };
+    DepthPrepassStats depthPrepassStats;
+    uint32_t gpuVisibleInstances { 0 };
+    // What the storage descriptors of a geometry pipeline point at for each swap chain image
+    struct GeometryDescriptors {
+        std::vector<std::shared_ptr<Buffer>> entities;
+        std::vector<std::shared_ptr<Buffer>> instances;
+
+        void resize(size_t);
+        void reset();
+    };
+    GeometryDescriptors geometryDescriptors;
+    GeometryDescriptors depthPrepassDescriptors;
+    GeometryDescriptors prepassGeometryDescriptors;
+
+    // What the storage descriptors of a lighting pipeline point at for each swap chain image
+    struct LightingDescriptors {
+        std::vector<std::shared_ptr<Buffer>> lights;
+        std::vector<std::shared_ptr<Buffer>> activeLights;
+        std::vector<std::shared_ptr<Buffer>> clusters;
+
+        void resize(size_t);
+        void reset();
+    };
+    LightingDescriptors fullScreenLightDescriptors;
+    LightingDescriptors worldLightDescriptors;
+    LightingDescriptors clusteredLightDescriptors;
+    LightingDescriptors reducedFullScreenLightDescriptors;
+    LightingDescriptors reducedWorldLightDescriptors;
+    LightingDescriptors reducedClusteredLightDescriptors;
 
     void createAttachments();
     void createRenderPass();
+    void createReducedLightingRenderPasses();
     void createFramebuffers(const Image *depthImage);
     void createLightingPipeline(const std::shared_ptr<Image> &depth);
+    void createReducedLightingPipeline(const std::shared_ptr<Image> &depth);
+    void createReducedLightingTarget();
+    void cleanupReducedLightingTarget();
     void createGeometryPipeline();
+    bool reserveBuffer(
+        std::shared_ptr<Buffer> &buffer, vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryUsage memoryUsage
+    );
+    void bindPerImage(
+        Pipeline &, std::vector<std::shared_ptr<Buffer>> &bound, uint32_t set, uint32_t binding,
+        const std::shared_ptr<Buffer> &
+    );
+    void findDrawRuns();
+    void writeInstances();
+    void cullInstances();
+    void bindGeometryStorage(Pipeline &, GeometryDescriptors &, const std::shared_ptr<Buffer> &instances);
+    void recordDraw(uint32_t run, const Mesh *);
+    void recordDepth(uint32_t run);
+    void recordGeometry(uint32_t run, Pipeline &);
+    bool placeLightVolume(const Entity *, const Light &, const Camera &, LightVolume &) const;
+    void prepareLights();
+    void bindLightingStorage(Pipeline &, LightingDescriptors &);
+    bool isReducedLighting() const { return lightingResolution != LightingResolution::Full; }
+    uint32_t getLightingDivisor() const;
+    void drawFullScreenLights(
+        Pipeline &, LightingDescriptors &, const std::vector<const Entity *> &, const LightPushConstants &base
+    );
+    void drawLightVolumes(Pipeline &, LightingDescriptors &, const LightPushConstants &base, bool depthBounds);
+    void recordReducedLighting(const LightPushConstants &base);
+    void recordUpsample();
 };
 
 }
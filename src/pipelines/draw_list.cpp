@@ -0,0 +1,50 @@
+#include "draw_list.hpp"
+#include <array>
+
+namespace Engine::Internal {
+
+void sortDraws(std::vector<DrawItem> &draws, std::vector<DrawItem> &scratch) {
+    if (draws.size() < 2) {
+        return;
+    }
+
+    // Count every byte in one pass
+    std::array<std::array<uint32_t, 256>, 8> counts {};
+    for (auto &draw : draws) {
+        for (uint32_t byte = 0; byte < 8; ++byte) {
+            ++counts[byte][(draw.key >> (byte * 8)) & 0xFF];
+        }
+    }
+
+    scratch.resize(draws.size());
+    auto *source = &draws;
+    auto *target = &scratch;
+
+    for (uint32_t byte = 0; byte < 8; ++byte) {
+        auto &count = counts[byte];
+
+        // Every key has the same value here so the order would not change
+        if (count[(draws.front().key >> (byte * 8)) & 0xFF] == draws.size()) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (auto &bucket : count) {
+            auto size = bucket;
+            bucket = offset;
+            offset += size;
+        }
+
+        for (auto &draw : *source) {
+            (*target)[count[(draw.key >> (byte * 8)) & 0xFF]++] = draw;
+        }
+
+        std::swap(source, target);
+    }
+
+    if (source != &draws) {
+        draws.swap(scratch);
+    }
+}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "tech-core/forward.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace Engine::Internal {
+
+/**
+ * Draw sort keys, from most to least significant:
+ *  4 bits pipeline, 20 bits material, 20 bits mesh, 20 bits depth
+ */
+namespace DrawKey {
+const uint32_t DepthBits = 20;
+const uint32_t MeshBits = 20;
+const uint32_t MaterialBits = 20;
+const uint32_t PipelineBits = 4;
+
+const uint32_t DepthShift = 0;
+const uint32_t MeshShift = DepthShift + DepthBits;
+const uint32_t MaterialShift = MeshShift + MeshBits;
+const uint32_t PipelineShift = MaterialShift + MaterialBits;
+
+const uint64_t DepthMask = (1ull << DepthBits) - 1;
+
+/**
+ * Builds the state part of a key. The depth is filled in each frame
+ */
+inline uint64_t make(uint32_t pipeline, uint32_t material, uint32_t mesh) {
+    return (static_cast<uint64_t>(pipeline & ((1u << PipelineBits) - 1)) << PipelineShift) |
+        (static_cast<uint64_t>(material & ((1u << MaterialBits) - 1)) << MaterialShift) |
+        (static_cast<uint64_t>(mesh & ((1u << MeshBits) - 1)) << MeshShift);
+}
+
+/**
+ * Quantises a view depth so that nearer draws sort first
+ */
+inline uint64_t depth(float viewDepth, float farClip) {
+    float normalised = (farClip > 0) ? viewDepth / farClip : 0;
+    normalised = normalised < 0 ? 0 : (normalised > 1 ? 1 : normalised);
+    return static_cast<uint64_t>(normalised * static_cast<float>(DepthMask)) << DepthShift;
+}
+}
+
+struct DrawItem {
+    uint64_t key;
+    // Taken from the MeshRenderer when queued so that recording needs no component lookups
+    const Mesh *mesh;
+    const Material *material;
+    // Where the entity's data is in the entity storage
+    uint32_t entitySlot;
+};
+
+/**
+ * Sorts the draws by key using a least significant byte first radix sort.
+ * Bytes which are the same in every key are skipped.
+ * @param scratch Reused storage of the same size
+ */
+void sortDraws(std::vector<DrawItem> &draws, std::vector<DrawItem> &scratch);
+
+}
@@ -0,0 +1,90 @@
+#include "light_volumes.hpp"
+#include <glm/gtc/constants.hpp>
+#include <cmath>
+
+namespace Engine::Internal {
+
+const uint32_t SphereRings = 8;
+const uint32_t SphereSegments = 12;
+const uint32_t ConeSegments = 12;
+
+Vertex makeVolumeVertex(const glm::vec3 &position) {
+    return { position, glm::normalize(position), {}, { 1, 1, 1, 1 }, {} };
+}
+
+void generateLightSphere(std::vector<Vertex> &vertices, std::vector<uint16_t> &indices) {
+    // Pushing the vertices out this far keeps every face outside of the round surface
+    float extent = 1.0f / (std::cos(glm::pi<float>() / SphereRings) * std::cos(glm::pi<float>() / SphereSegments));
+
+    vertices.clear();
+    indices.clear();
+
+    // Poles, then each ring from the top down
+    vertices.push_back(makeVolumeVertex({ 0, 0, extent }));
+    vertices.push_back(makeVolumeVertex({ 0, 0, -extent }));
+    for (uint32_t ring = 1; ring < SphereRings; ++ring) {
+        float theta = glm::pi<float>() * ring / SphereRings;
+        for (uint32_t segment = 0; segment < SphereSegments; ++segment) {
+            float phi = glm::two_pi<float>() * segment / SphereSegments;
+            vertices.push_back(
+                makeVolumeVertex(
+                    glm::vec3(std::sin(theta) * std::cos(phi), std::sin(theta) * std::sin(phi), std::cos(theta)) *
+                        extent
+                )
+            );
+        }
+    }
+
+    auto ringVertex = [](uint32_t ring, uint32_t segment) {
+        return static_cast<uint16_t>(2 + (ring - 1) * SphereSegments + segment % SphereSegments);
+    };
+
+    // Counter clockwise when seen from outside
+    for (uint32_t segment = 0; segment < SphereSegments; ++segment) {
+        indices.insert(indices.end(), { 0, ringVertex(1, segment), ringVertex(1, segment + 1) });
+    }
+    for (uint32_t ring = 1; ring < SphereRings - 1; ++ring) {
+        for (uint32_t segment = 0; segment < SphereSegments; ++segment) {
+            auto upperLeft = ringVertex(ring, segment);
+            auto upperRight = ringVertex(ring, segment + 1);
+            auto lowerLeft = ringVertex(ring + 1, segment);
+            auto lowerRight = ringVertex(ring + 1, segment + 1);
+
+            indices.insert(indices.end(), { upperLeft, lowerLeft, lowerRight });
+            indices.insert(indices.end(), { upperLeft, lowerRight, upperRight });
+        }
+    }
+    for (uint32_t segment = 0; segment < SphereSegments; ++segment) {
+        indices.insert(
+            indices.end(), { ringVertex(SphereRings - 1, segment), 1, ringVertex(SphereRings - 1, segment + 1) }
+        );
+    }
+}
+
+void generateLightCone(std::vector<Vertex> &vertices, std::vector<uint16_t> &indices) {
+    // Pushing the rim out this far keeps every side outside of the round surface
+    float extent = 1.0f / std::cos(glm::pi<float>() / ConeSegments);
+
+    vertices.clear();
+    indices.clear();
+
+    // Tip, centre of the base, then the base's rim
+    vertices.push_back({ {}, { 0, 0, -1 }, {}, { 1, 1, 1, 1 }, {} });
+    vertices.push_back(makeVolumeVertex({ 0, 0, 1 }));
+    for (uint32_t segment = 0; segment < ConeSegments; ++segment) {
+        float phi = glm::two_pi<float>() * segment / ConeSegments;
+        vertices.push_back(makeVolumeVertex({ std::cos(phi) * extent, std::sin(phi) * extent, 1 }));
+    }
+
+    auto rimVertex = [](uint32_t segment) {
+        return static_cast<uint16_t>(2 + segment % ConeSegments);
+    };
+
+    // Counter clockwise when seen from outside
+    for (uint32_t segment = 0; segment < ConeSegments; ++segment) {
+        indices.insert(indices.end(), { rimVertex(segment), 0, rimVertex(segment + 1) });
+        indices.insert(indices.end(), { 1, rimVertex(segment), rimVertex(segment + 1) });
+    }
+}
+
+}
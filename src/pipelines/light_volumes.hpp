@@ -0,0 +1,21 @@
+#pragma once
+
+#include "tech-core/vertex.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace Engine::Internal {
+
+/**
+ * A low poly sphere of radius 1 around the origin.
+ * The vertices are pushed out so that the flat faces still contain the whole round sphere.
+ */
+void generateLightSphere(std::vector<Vertex> &vertices, std::vector<uint16_t> &indices);
+
+/**
+ * A low poly cone with its tip at the origin, opening along +Z to a base of radius 1 at z = 1.
+ * The base is pushed out so that the flat sides still contain the whole round cone.
+ */
+void generateLightCone(std::vector<Vertex> &vertices, std::vector<uint16_t> &indices);
+
+}
@@ -123,13 +123,14 @@ void Effect::bindCamera(uint32_t set, uint32_t binding, RenderEngine &engine) {
     pipeline->bindCamera(set, binding, engine);
 }
 
-void Effect::fillFrameCommands() {
-    pipeline->bind(buffer);
+void Effect::fillFrameCommands(uint32_t activeImage) {
+    auto buffer = buffers[activeImage];
+    pipeline->bind(buffer, activeImage);
     vkCmdDraw(buffer, 3, 1, 0, 0);
 }
 
-void Effect::applyCommandBuffer(vk::CommandBuffer newBuffer) {
-    buffer = newBuffer;
+void Effect::applyCommandBuffers(const std::vector<vk::CommandBuffer> &newBuffers) {
+    buffers = newBuffers;
 }
 
 void Effect::onSwapChainRecreate(vk::RenderPass renderPass, vk::Extent2D windowSize, uint32_t subpass) {
@@ -4,9 +4,10 @@ namespace Engine::Internal {
 
 enum StandardBindings {
     CameraUniform = 0,
-    EntityUniform,
-    LightUniform,
+    EntityStorage,
+    LightStorage,
     AlbedoTexture,
-    NormalTexture
+    NormalTexture,
+    InstanceStorage
 };
 }
@@ -0,0 +1,398 @@
+#include "bounding_tree.hpp"
+#include "tech-core/shapes/frustum.hpp"
+#include <cassert>
+
+namespace Engine::Internal {
+
+inline BoundingBox combine(const BoundingBox &a, const BoundingBox &b) {
+    return {
+        std::min(a.xMin, b.xMin),
+        std::min(a.yMin, b.yMin),
+        std::min(a.zMin, b.zMin),
+        std::max(a.xMax, b.xMax),
+        std::max(a.yMax, b.yMax),
+        std::max(a.zMax, b.zMax)
+    };
+}
+
+BoundingTree::BoundingTree(float margin)
+    : margin(margin) {
+}
+
+ProxyId BoundingTree::createProxy(const BoundingBox &bounds, Entity *entity) {
+    auto proxy = allocateNode();
+
+    auto &node = nodes[proxy];
+    node.bounds = bounds.expand(margin);
+    node.entity = entity;
+    node.height = 0;
+
+    insertLeaf(proxy);
+    ++proxyCount;
+
+    return proxy;
+}
+
+void BoundingTree::destroyProxy(ProxyId proxy) {
+    assert(proxy >= 0 && proxy < static_cast<ProxyId>(nodes.size()));
+    assert(nodes[proxy].isLeaf());
+
+    removeLeaf(proxy);
+    freeNode(proxy);
+    --proxyCount;
+}
+
+bool BoundingTree::moveProxy(ProxyId proxy, const BoundingBox &bounds) {
+    assert(proxy >= 0 && proxy < static_cast<ProxyId>(nodes.size()));
+    assert(nodes[proxy].isLeaf());
+
+    if (nodes[proxy].bounds.contains(bounds)) {
+        return false;
+    }
+
+    removeLeaf(proxy);
+    nodes[proxy].bounds = bounds.expand(margin);
+    insertLeaf(proxy);
+
+    return true;
+}
+
+void BoundingTree::query(const Frustum &frustum, std::vector<Entity *> &outEntities) const {
+    if (root == NullProxy) {
+        return;
+    }
+
+    stack.clear();
+    stack.push_back(root);
+
+    while (!stack.empty()) {
+        auto nodeId = stack.back();
+        stack.pop_back();
+
+        auto &node = nodes[nodeId];
+        glm::vec3 minPoint { node.bounds.xMin, node.bounds.yMin, node.bounds.zMin };
+        glm::vec3 maxPoint { node.bounds.xMax, node.bounds.yMax, node.bounds.zMax };
+
+        if (!frustum.intersects(minPoint, maxPoint)) {
+            continue;
+        }
+
+        if (node.isLeaf()) {
+            outEntities.push_back(node.entity);
+        } else if (frustum.contains(minPoint, maxPoint)) {
+            // Everything below here is visible, no need to test it
+            collectLeaves(nodeId, outEntities);
+        } else {
+            stack.push_back(node.child1);
+            stack.push_back(node.child2);
+        }
+    }
+}
+
+void BoundingTree::clear() {
+    nodes.clear();
+    root = NullProxy;
+    freeList = NullProxy;
+    proxyCount = 0;
+}
+
+BoundingBox BoundingTree::transformBounds(const BoundingBox &bounds, const glm::mat4 &transform) {
+    // Transforms the center and projects the extents onto each world axis
+    glm::vec3 center = bounds.center();
+    glm::vec3 extents {
+        (bounds.xMax - bounds.xMin) * 0.5f,
+        (bounds.yMax - bounds.yMin) * 0.5f,
+        (bounds.zMax - bounds.zMin) * 0.5f
+    };
+
+    glm::vec3 worldCenter = glm::vec3(transform * glm::vec4(center, 1));
+    glm::mat3 absolute {
+        glm::abs(glm::vec3(transform[0])),
+        glm::abs(glm::vec3(transform[1])),
+        glm::abs(glm::vec3(transform[2]))
+    };
+    glm::vec3 worldExtents = absolute * extents;
+
+    return {
+        worldCenter - worldExtents,
+        worldCenter + worldExtents
+    };
+}
+
+ProxyId BoundingTree::allocateNode() {
+    if (freeList == NullProxy) {
+        nodes.emplace_back();
+        return static_cast<ProxyId>(nodes.size() - 1);
+    }
+
+    auto nodeId = freeList;
+    auto &node = nodes[nodeId];
+    freeList = node.next;
+
+    node.parent = NullProxy;
+    node.child1 = NullProxy;
+    node.child2 = NullProxy;
+    node.height = 0;
+    node.entity = nullptr;
+
+    return nodeId;
+}
+
+void BoundingTree::freeNode(ProxyId nodeId) {
+    auto &node = nodes[nodeId];
+    node.next = freeList;
+    node.height = -1;
+    node.entity = nullptr;
+    freeList = nodeId;
+}
+
+void BoundingTree::insertLeaf(ProxyId leaf) {
+    if (root == NullProxy) {
+        root = leaf;
+        nodes[root].parent = NullProxy;
+        return;
+    }
+
+    // Find the best sibling by descending towards the lowest cost
+    auto leafBounds = nodes[leaf].bounds;
+    auto index = root;
+    while (!nodes[index].isLeaf()) {
+        auto &node = nodes[index];
+        auto child1 = node.child1;
+        auto child2 = node.child2;
+
+        float area = surfaceArea(node.bounds);
+        float combinedArea = surfaceArea(combine(node.bounds, leafBounds));
+
+        // Cost of creating a new parent for this node and the new leaf
+        float cost = 2.0f * combinedArea;
+
+        // Minimum cost of pushing the leaf further down the tree
+        float inheritanceCost = 2.0f * (combinedArea - area);
+
+        auto descendCost = [&](ProxyId child) {
+            float newArea = surfaceArea(combine(leafBounds, nodes[child].bounds));
+            if (nodes[child].isLeaf()) {
+                return newArea + inheritanceCost;
+            } else {
+                return (newArea - surfaceArea(nodes[child].bounds)) + inheritanceCost;
+            }
+        };
+
+        float cost1 = descendCost(child1);
+        float cost2 = descendCost(child2);
+
+        if (cost < cost1 && cost < cost2) {
+            break;
+        }
+
+        index = (cost1 < cost2) ? child1 : child2;
+    }
+
+    auto sibling = index;
+
+    // Create a new parent
+    auto oldParent = nodes[sibling].parent;
+    auto newParent = allocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].entity = nullptr;
+    nodes[newParent].bounds = combine(leafBounds, nodes[sibling].bounds);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].child1 = sibling;
+    nodes[newParent].child2 = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if (oldParent != NullProxy) {
+        if (nodes[oldParent].child1 == sibling) {
+            nodes[oldParent].child1 = newParent;
+        } else {
+            nodes[oldParent].child2 = newParent;
+        }
+    } else {
+        root = newParent;
+    }
+
+    // Walk back up the tree fixing heights and bounds
+    index = nodes[leaf].parent;
+    while (index != NullProxy) {
+        index = balance(index);
+
+        auto &node = nodes[index];
+        auto &child1 = nodes[node.child1];
+        auto &child2 = nodes[node.child2];
+
+        node.height = 1 + std::max(child1.height, child2.height);
+        node.bounds = combine(child1.bounds, child2.bounds);
+
+        index = node.parent;
+    }
+}
+
+void BoundingTree::removeLeaf(ProxyId leaf) {
+    if (leaf == root) {
+        root = NullProxy;
+        return;
+    }
+
+    auto parent = nodes[leaf].parent;
+    auto grandParent = nodes[parent].parent;
+    auto sibling = (nodes[parent].child1 == leaf) ? nodes[parent].child2 : nodes[parent].child1;
+
+    if (grandParent != NullProxy) {
+        // Replace the parent with the sibling
+        if (nodes[grandParent].child1 == parent) {
+            nodes[grandParent].child1 = sibling;
+        } else {
+            nodes[grandParent].child2 = sibling;
+        }
+        nodes[sibling].parent = grandParent;
+        freeNode(parent);
+
+        auto index = grandParent;
+        while (index != NullProxy) {
+            index = balance(index);
+
+            auto &node = nodes[index];
+            auto &child1 = nodes[node.child1];
+            auto &child2 = nodes[node.child2];
+
+            node.bounds = combine(child1.bounds, child2.bounds);
+            node.height = 1 + std::max(child1.height, child2.height);
+
+            index = node.parent;
+        }
+    } else {
+        root = sibling;
+        nodes[sibling].parent = NullProxy;
+        freeNode(parent);
+    }
+}
+
+/**
+ * Performs a left or right rotation if the node is imbalanced.
+ * Returns the new root of the subtree.
+ */
+ProxyId BoundingTree::balance(ProxyId iA) {
+    auto &A = nodes[iA];
+    if (A.isLeaf() || A.height < 2) {
+        return iA;
+    }
+
+    auto iB = A.child1;
+    auto iC = A.child2;
+    auto &B = nodes[iB];
+    auto &C = nodes[iC];
+
+    int32_t balance = C.height - B.height;
+
+    // Rotate C up
+    if (balance > 1) {
+        auto iF = C.child1;
+        auto iG = C.child2;
+        auto &F = nodes[iF];
+        auto &G = nodes[iG];
+
+        C.child1 = iA;
+        C.parent = A.parent;
+        A.parent = iC;
+
+        if (C.parent != NullProxy) {
+            if (nodes[C.parent].child1 == iA) {
+                nodes[C.parent].child1 = iC;
+            } else {
+                nodes[C.parent].child2 = iC;
+            }
+        } else {
+            root = iC;
+        }
+
+        if (F.height > G.height) {
+            C.child2 = iF;
+            A.child2 = iG;
+            G.parent = iA;
+            A.bounds = combine(B.bounds, G.bounds);
+            C.bounds = combine(A.bounds, F.bounds);
+
+            A.height = 1 + std::max(B.height, G.height);
+            C.height = 1 + std::max(A.height, F.height);
+        } else {
+            C.child2 = iG;
+            A.child2 = iF;
+            F.parent = iA;
+            A.bounds = combine(B.bounds, F.bounds);
+            C.bounds = combine(A.bounds, G.bounds);
+
+            A.height = 1 + std::max(B.height, F.height);
+            C.height = 1 + std::max(A.height, G.height);
+        }
+
+        return iC;
+    }
+
+    // Rotate B up
+    if (balance < -1) {
+        auto iD = B.child1;
+        auto iE = B.child2;
+        auto &D = nodes[iD];
+        auto &E = nodes[iE];
+
+        B.child1 = iA;
+        B.parent = A.parent;
+        A.parent = iB;
+
+        if (B.parent != NullProxy) {
+            if (nodes[B.parent].child1 == iA) {
+                nodes[B.parent].child1 = iB;
+            } else {
+                nodes[B.parent].child2 = iB;
+            }
+        } else {
+            root = iB;
+        }
+
+        if (D.height > E.height) {
+            B.child2 = iD;
+            A.child1 = iE;
+            E.parent = iA;
+            A.bounds = combine(C.bounds, E.bounds);
+            B.bounds = combine(A.bounds, D.bounds);
+
+            A.height = 1 + std::max(C.height, E.height);
+            B.height = 1 + std::max(A.height, D.height);
+        } else {
+            B.child2 = iE;
+            A.child1 = iD;
+            D.parent = iA;
+            A.bounds = combine(C.bounds, D.bounds);
+            B.bounds = combine(A.bounds, E.bounds);
+
+            A.height = 1 + std::max(C.height, D.height);
+            B.height = 1 + std::max(A.height, E.height);
+        }
+
+        return iB;
+    }
+
+    return iA;
+}
+
+void BoundingTree::collectLeaves(ProxyId nodeId, std::vector<Entity *> &outEntities) const {
+    auto &node = nodes[nodeId];
+    if (node.isLeaf()) {
+        outEntities.push_back(node.entity);
+    } else {
+        collectLeaves(node.child1, outEntities);
+        collectLeaves(node.child2, outEntities);
+    }
+}
+
+float BoundingTree::surfaceArea(const BoundingBox &bounds) {
+    float width = bounds.xMax - bounds.xMin;
+    float depth = bounds.yMax - bounds.yMin;
+    float height = bounds.zMax - bounds.zMin;
+
+    return 2.0f * (width * depth + width * height + depth * height);
+}
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "tech-core/forward.hpp"
+#include "tech-core/shapes/bounding_box.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+
+namespace Engine::Internal {
+
+typedef int32_t ProxyId;
+
+const ProxyId NullProxy = -1;
+
+/**
+ * A dynamic bounding volume hierarchy of entity bounds.
+ * Leaves store a slightly enlarged version of the entity bounds so that
+ * small movements do not require the tree to be restructured.
+ */
+class BoundingTree {
+public:
+    explicit BoundingTree(float margin = 0.5f);
+
+    ProxyId createProxy(const BoundingBox &bounds, Entity *entity);
+    void destroyProxy(ProxyId proxy);
+
+    /**
+     * Updates the bounds of a proxy.
+     * @returns true if the proxy had to be re-inserted into the tree
+     */
+    bool moveProxy(ProxyId proxy, const BoundingBox &bounds);
+
+    /**
+     * Collects all entities whose bounds intersect the frustum
+     */
+    void query(const Frustum &frustum, std::vector<Entity *> &outEntities) const;
+
+    void clear();
+
+    size_t size() const { return proxyCount; }
+
+    /**
+     * Transforms a local space bounding box into a world space axis aligned bounding box
+     */
+    static BoundingBox transformBounds(const BoundingBox &bounds, const glm::mat4 &transform);
+
+private:
+    struct Node {
+        BoundingBox bounds;
+        Entity *entity { nullptr };
+
+        union {
+            ProxyId parent;
+            ProxyId next;
+        };
+
+        ProxyId child1 { NullProxy };
+        ProxyId child2 { NullProxy };
+
+        // Leaves are 0, free nodes are -1
+        int32_t height { -1 };
+
+        bool isLeaf() const { return child1 == NullProxy; }
+    };
+
+    // Provided
+    const float margin;
+
+    // State
+    std::vector<Node> nodes;
+    ProxyId root { NullProxy };
+    ProxyId freeList { NullProxy };
+    size_t proxyCount { 0 };
+
+    // Transient
+    mutable std::vector<ProxyId> stack;
+
+    ProxyId allocateNode();
+    void freeNode(ProxyId);
+
+    void insertLeaf(ProxyId leaf);
+    void removeLeaf(ProxyId leaf);
+    ProxyId balance(ProxyId node);
+
+    void collectLeaves(ProxyId node, std::vector<Entity *> &outEntities) const;
+
+    static float surfaceArea(const BoundingBox &);
+};
+
+}
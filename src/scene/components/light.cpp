@@ -1,5 +1,6 @@
 #include "tech-core/scene/components/light.hpp"
 #include "tech-core/scene/entity.hpp"
+#include <algorithm>
 
 namespace Engine {
 
@@ -28,4 +29,9 @@ void Light::setColor(const glm::vec3 &newColor) {
     owner.invalidate(EntityInvalidateType::Light);
 }
 
+void Light::setSpotAngle(float newAngle) {
+    spotAngle = std::clamp(newAngle, 0.0f, 90.0f);
+    owner.invalidate(EntityInvalidateType::Light);
+}
+
 }
\ No newline at end of file
@@ -1,8 +1,9 @@
 #pragma once
 
 #include "tech-core/scene/components/base.hpp"
-#include "../internal.hpp"
-#include <glm/mat4x4.hpp>
+#include "../storage_slots.hpp"
+#include "../bounding_tree.hpp"
+#include "../transform_hierarchy.hpp"
 
 namespace Engine::Internal {
 
@@ -11,16 +12,19 @@ public:
     explicit PlannerData(Entity &entity) : Component(entity) {};
 
     struct {
-        EntityBuffer *buffer { nullptr };
-        vk::DeviceSize uniformOffset { 0 };
+        // The entity's record in the entity storage
+        StorageSlot slot { NoStorageSlot };
+        ProxyId boundsProxy { NullProxy };
+        // The state part of the draw sort key
+        uint64_t drawKey { 0 };
     } render;
 
     struct {
-        LightBuffer *buffer { nullptr };
-        vk::DeviceSize uniformOffset { 0 };
+        // The entity's record in the light storage
+        StorageSlot slot { NoStorageSlot };
     } light;
 
-    glm::mat4 absoluteTransform { 1 };
+    TransformNode transformNode { NoTransformNode };
 };
 
 }
@@ -9,6 +9,18 @@ Transform::Transform(Entity &entity)
     updateTransform();
 }
 
+const glm::mat4 &Transform::getTransform() const {
+    if (transformDirty) {
+        transform = glm::mat4(1.0f);
+        transform = glm::translate(transform, position);
+        transform *= glm::mat4_cast(rotation);
+        transform = glm::scale(transform, scale);
+        transformDirty = false;
+    }
+
+    return transform;
+}
+
 void Transform::setPosition(const glm::vec3 &newPosition) {
     position = newPosition;
     updateTransform();
@@ -31,14 +43,15 @@ void Transform::setScale(float newScale) {
 
 void Transform::setTransform(const glm::mat4 &newTransform) {
     transform = newTransform;
+    transformDirty = false;
+    matrixOverride = true;
     owner.invalidate(EntityInvalidateType::Transform);
 }
 
 void Transform::updateTransform() {
-    transform = glm::mat4(1.0f);
-    transform = glm::translate(transform, position);
-    transform *= glm::mat4_cast(rotation);
-    transform = glm::scale(transform, scale);
+    // The scene composes these in batches, so the matrix is only built here if asked for
+    transformDirty = true;
+    matrixOverride = false;
     owner.invalidate(EntityInvalidateType::Transform);
 }
 }
@@ -104,18 +104,21 @@ void showEntityInformation(Entity *entity) {
     if (entity->has<Internal::PlannerData>() && ImGui::CollapsingHeader("PlannerData")) {
         auto &data = entity->get<Internal::PlannerData>();
 
-        ImGui::Text("Absolute transform:");
-        displayMatrix(data.absoluteTransform);
-
-        ImGui::Text("Renderable? %d", data.render.buffer != nullptr);
+        // World transforms live in the planner, so rebuild it from the local transforms
+        glm::mat4 absoluteTransform = entity->getTransform().getTransform();
+        for (auto parent = entity->getParent(); parent; parent = parent->getParent()) {
+            absoluteTransform = parent->getTransform().getTransform() * absoluteTransform;
+        }
 
-        ImGui::Text("Render Buffer: %d", data.render.buffer ? data.render.buffer->id : -1);
-        ImGui::Text("Render Offset: %lu", data.render.buffer ? data.render.uniformOffset : 0);
+        ImGui::Text("Transform node: %u", data.transformNode);
+        ImGui::Text("Absolute transform:");
+        displayMatrix(absoluteTransform);
 
-        ImGui::Text("Light Emitter? %d", data.light.buffer != nullptr);
+        ImGui::Text("Renderable? %d", data.render.slot != Internal::NoStorageSlot);
+        ImGui::Text("Render Slot: %d", static_cast<int32_t>(data.render.slot));
 
-        ImGui::Text("Light Buffer: %d", data.light.buffer ? data.light.buffer->id : -1);
-        ImGui::Text("Light Offset: %lu", data.light.buffer ? data.light.uniformOffset : 0);
+        ImGui::Text("Light Emitter? %d", data.light.slot != Internal::NoStorageSlot);
+        ImGui::Text("Light Slot: %d", static_cast<int32_t>(data.light.slot));
     }
 
     if (entity->has<MeshRenderer>() && ImGui::CollapsingHeader("MeshRenderer")) {
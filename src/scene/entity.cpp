@@ -1,16 +1,47 @@
 #include "tech-core/scene/entity.hpp"
 #include "render_planner.hpp"
+#include <stdexcept>
 
 namespace Engine {
 
+namespace Internal {
+
+// Indexed by component type id
+std::array<ComponentPoolBase *, MaxComponentTypes> componentPools {};
+uint32_t componentTypeCount { 0 };
+
+ComponentTypeId registerComponentType(ComponentPoolBase *pool) {
+    if (componentTypeCount >= MaxComponentTypes) {
+        throw std::runtime_error("Too many component types");
+    }
+
+    componentPools[componentTypeCount] = pool;
+    return componentTypeCount++;
+}
+
+ComponentPoolBase *getComponentPool(ComponentTypeId typeId) {
+    assert(typeId < componentTypeCount);
+    return componentPools[typeId];
+}
+
+void updateComponentSlot(Entity *owner, ComponentTypeId typeId, uint32_t slot) {
+    owner->componentSlots[typeId] = slot;
+}
+
+}
+
 Entity::Entity(EntityId id)
     : id(id),
     transform(*this) {
-
+    componentSlots.fill(Internal::NoComponentSlot);
 }
 
 Entity::~Entity() {
-
+    for (Internal::ComponentTypeId typeId = 0; typeId < Internal::MaxComponentTypes; ++typeId) {
+        if (componentSlots[typeId] != Internal::NoComponentSlot) {
+            Internal::getComponentPool(typeId)->erase(componentSlots[typeId]);
+        }
+    }
 }
 
 void Entity::setScene(Badge<Scene>, Scene *newScene) {
@@ -54,7 +85,7 @@ void Entity::addChild(const std::shared_ptr<Entity> &entity) {
 void Entity::removeChildById(EntityId childId) {
     auto it = children.begin();
     while (it != children.end()) {
-        auto &child = *it;
+        auto child = *it;
         if (child->id == childId) {
             children.erase(it);
             child->parent = nullptr;
@@ -4,6 +4,7 @@
 #include "tech-core/scene/components/light.hpp"
 #include "tech-core/buffer.hpp"
 #include "tech-core/engine.hpp"
+#include "tech-core/camera.hpp"
 #include "tech-core/device.hpp"
 #include "components/planner_data.hpp"
 #include "tech-core/mesh.hpp"
@@ -20,6 +21,10 @@ namespace Engine::Internal {
 
 const Subsystem::SubsystemID<RenderPlanner> RenderPlanner::ID;
 
+// Slots reserved up front. The storage doubles in size whenever it runs out
+const uint32_t InitialEntityCapacity = 1024;
+const uint32_t InitialLightCapacity = 64;
+
 void RenderPlanner::addEntity(Entity *entity) {
     // An internal component used for storing data against the entity
     if (!entity->has<PlannerData>()) {
@@ -28,6 +33,15 @@ void RenderPlanner::addEntity(Entity *entity) {
         ignoreComponentUpdates = false;
     }
 
+    // Parents are always added before their children
+    auto &data = entity->get<PlannerData>();
+    auto parent = entity->getParent();
+    data.transformNode = transforms.add(
+        entity,
+        parent ? parent->get<PlannerData>().transformNode : NoTransformNode,
+        entity->getTransform()
+    );
+
     if (entity->has<MeshRenderer>()) {
         addToRender(entity);
     }
@@ -43,29 +57,27 @@ void RenderPlanner::removeEntity(Entity *entity) {
     if (entity->has<Light>()) {
         removeLight(entity);
     }
+
+    auto &data = entity->get<PlannerData>();
+    if (data.transformNode != NoTransformNode) {
+        transforms.remove(data.transformNode);
+        data.transformNode = NoTransformNode;
+    }
 }
 
 void RenderPlanner::updateEntity(Entity *entity, EntityUpdateType update) {
     if (update == EntityUpdateType::Transform) {
-        updateTransforms(entity, true);
-        updateEntityUniform(entity);
-        if (entity->has<Light>()) {
-            updateLightUniform(entity);
+        auto &data = entity->get<PlannerData>();
+        if (data.transformNode != NoTransformNode) {
+            transforms.setLocal(data.transformNode, entity->getTransform());
+        }
+        // Otherwise every change made this frame is propagated at once in prepareFrame
+        if (eagerTransforms) {
+            updateTransforms();
         }
-        entity->forEachChild(
-            true, [this](Entity *entity) {
-                if (entity->get<PlannerData>().render.buffer) {
-                    updateEntityUniform(entity);
-                }
-
-                if (entity->has<Light>()) {
-                    updateLightUniform(entity);
-                }
-            }
-        );
     } else if (update == EntityUpdateType::Light) {
         if (entity->has<Light>()) {
-            updateLightUniform(entity);
+            updateLightData(entity);
         }
     } else if (update == EntityUpdateType::ComponentAdd && !ignoreComponentUpdates) {
         if (entity->has<MeshRenderer>() && !renderableEntities.contains(entity)) {
@@ -74,6 +86,12 @@ void RenderPlanner::updateEntity(Entity *entity, EntityUpdateType update) {
         if (entity->has<Light>() && !lightEntities.contains(entity)) {
             addLight(entity);
         }
+    } else if (update == EntityUpdateType::Other) {
+        // The mesh or material may have changed
+        if (renderableEntities.contains(entity)) {
+            updateEntityBounds(entity);
+            updateDrawKey(entity);
+        }
     } else if (update == EntityUpdateType::ComponentRemove && !ignoreComponentUpdates) {
         if (!entity->has<MeshRenderer>() && renderableEntities.contains(entity)) {
             removeFromRender(entity);
@@ -88,88 +106,27 @@ void RenderPlanner::addToRender(Entity *entity) {
     renderableEntities.insert(entity);
     auto &data = entity->get<PlannerData>();
 
-    auto pair = allocateEntityUniform();
-    data.render.buffer = pair.first;
-    data.render.uniformOffset = pair.second;
+    data.render.slot = entityStorage->allocate();
 
     updateEntity(entity, EntityUpdateType::Transform);
+    updateEntityBounds(entity);
+    updateDrawKey(entity);
 }
 
 void RenderPlanner::removeFromRender(Entity *entity) {
     renderableEntities.erase(entity);
+    unboundedEntities.erase(entity);
+    dynamicBoundsEntities.erase(entity);
 
     auto &data = entity->get<PlannerData>();
-    if (data.render.buffer) {
-        data.render.buffer->buffer->freeSection(data.render.uniformOffset, uboBufferAlignment);
-        data.render.buffer = nullptr;
-    }
-}
-
-EntityBuffer &RenderPlanner::newEntityBuffer() {
-    auto uboBuffer = engine->getBufferManager().aquireDivisible(
-        uboBufferMaxSize,
-        vk::BufferUsageFlagBits::eUniformBuffer,
-        vk::MemoryUsage::eCPUToGPU
-    );
-
-    auto descriptorSets = device.allocateDescriptorSets(
-        {
-            objectDSPool,
-            1,
-            &objectDSL
-        }
-    );
-
-    auto objectDS = descriptorSets[0];
-
-    // Assign buffer to DS
-    vk::DescriptorBufferInfo bufferInfo(
-        uboBuffer->buffer(),
-        0,
-        sizeof(EntityUBO)
-    );
-
-    std::array<vk::WriteDescriptorSet, 1> descriptorWrites = {{
-        { // Object UBO
-            objectDS,
-            Internal::StandardBindings::EntityUniform,
-            0, // Array element
-            1, // Count
-            vk::DescriptorType::eUniformBufferDynamic,
-            nullptr,
-            &bufferInfo
-        }
-    }};
-
-    device.updateDescriptorSets(descriptorWrites, {});
-
-    auto &buffer = entityBuffers.emplace_back();
-    buffer.id = entityBuffers.size() - 1;
-    buffer.buffer = std::move(uboBuffer);
-    buffer.set = objectDS;
-
-    return buffer;
-}
-
-std::pair<EntityBuffer *, uint32_t> RenderPlanner::allocateEntityUniform() {
-    // Find the next available slot
-
-    // TODO: Need a way to have the allocator consider the alignment requirements
-    for (auto &buffer : entityBuffers) {
-        auto offset = buffer.buffer->allocateSection(uboBufferAlignment);
-        if (offset != ALLOCATION_FAILED) {
-            return { &buffer, offset };
-        }
+    if (data.render.boundsProxy != NullProxy) {
+        renderTree.destroyProxy(data.render.boundsProxy);
+        data.render.boundsProxy = NullProxy;
     }
-
-    auto &buffer = newEntityBuffer();
-    auto offset = buffer.buffer->allocateSection(uboBufferAlignment);
-    // Sanity check
-    if (offset == ALLOCATION_FAILED) {
-        throw std::runtime_error("Out of object slots");
+    if (data.render.slot != NoStorageSlot) {
+        entityStorage->free(data.render.slot);
+        data.render.slot = NoStorageSlot;
     }
-
-    return { &buffer, offset };
 }
 
 void RenderPlanner::initialiseResources(
@@ -186,31 +143,13 @@ void RenderPlanner::initialiseResources(
 
     cameraAndModelDSL = device.createDescriptorSetLayout({{}, 1, &cameraBinding });
 
-    // Holds the object information
-    vk::DescriptorSetLayoutBinding objectBinding {
-        Internal::StandardBindings::EntityUniform,
-        vk::DescriptorType::eUniformBufferDynamic,
-        1, // count
-        vk::ShaderStageFlagBits::eVertex
-    };
-
-    objectDSL = device.createDescriptorSetLayout({{}, 1, &objectBinding });
-
-    // Holds the light information
-    vk::DescriptorSetLayoutBinding lightBinding {
-        Internal::StandardBindings::LightUniform,
-        vk::DescriptorType::eUniformBufferDynamic,
-        1, // count
-        vk::ShaderStageFlagBits::eFragment
-    };
-
-    lightDSL = device.createDescriptorSetLayout({{}, 1, &lightBinding });
-
-    size_t minimumAlignment = physicalDevice.getProperties().limits.minUniformBufferOffsetAlignment;
-    uboBufferAlignment = sizeof(EntityUBO);
-
-    uboBufferAlignment = (uboBufferAlignment + minimumAlignment - 1) & ~(minimumAlignment - 1);
-    uboBufferMaxSize = physicalDevice.getProperties().limits.maxUniformBufferRange;
+    // Copies are added once the number of swap chain images is known
+    entityStorage = std::make_unique<StorageSlots>(
+        engine.getBufferManager(), sizeof(EntityData), InitialEntityCapacity, swapChainImages
+    );
+    lightStorage = std::make_unique<StorageSlots>(
+        engine.getBufferManager(), sizeof(LightData), InitialLightCapacity, swapChainImages
+    );
 
     this->device = device;
     this->engine = &engine;
@@ -221,6 +160,7 @@ void RenderPlanner::initialiseResources(
 void RenderPlanner::initialiseSwapChainResources(
     vk::Device device, RenderEngine &engine, uint32_t swapChainImages
 ) {
+    this->swapChainImages = swapChainImages;
 
     // Descriptor pool for allocating the descriptors
     vk::DescriptorPoolSize cameraBinding = {
@@ -265,28 +205,15 @@ void RenderPlanner::initialiseSwapChainResources(
         device.updateDescriptorSets(descriptorWrites, {});
     }
 
-    // Descriptor pool for allocating the descriptors
-    std::array<vk::DescriptorPoolSize, 1> poolSizes = {{
-        {
-            vk::DescriptorType::eUniformBufferDynamic,
-            2000
-        }
-    }};
-
-    objectDSPool = device.createDescriptorPool(
-        {
-            {},
-            2000,
-            vkUseArray(poolSizes)
-        }
-    );
-
     auto builder = engine.createPipeline()
         .withVertexShader(BUILTIN_STANDARD_VERT_GLSL, BUILTIN_STANDARD_VERT_GLSL_SIZE)
         .withFragmentShader(BUILTIN_STANDARD_FRAG_GLSL, BUILTIN_STANDARD_FRAG_GLSL_SIZE)
         .bindCamera(0, Internal::StandardBindings::CameraUniform)
-        .bindUniformBufferDynamic(1, Internal::StandardBindings::EntityUniform)
-        .bindUniformBufferDynamic(2, Internal::StandardBindings::LightUniform)
+        .bindStorageBufferPerImage(1, Internal::StandardBindings::EntityStorage)
+        .bindStorageBufferPerImage(1, Internal::StandardBindings::InstanceStorage)
+        .bindStorageBufferPerImage(
+            2, Internal::StandardBindings::LightStorage, vk::ShaderStageFlagBits::eFragment
+        )
         .bindMaterial(3, Internal::StandardBindings::AlbedoTexture, MaterialBindPoint::Albedo)
         .bindMaterial(4, Internal::StandardBindings::NormalTexture, MaterialBindPoint::Normal)
         .withVertexBindingDescription(Vertex::getBindingDescription())
@@ -294,115 +221,67 @@ void RenderPlanner::initialiseSwapChainResources(
 
     pipelineNormal = builder.build();
 
-    // Re-allocate descriptor sets
-    if (!entityBuffers.empty()) {
-
-        std::vector<vk::DescriptorSetLayout> entityLayouts(entityBuffers.size(), objectDSL);
-
-        auto sets = device.allocateDescriptorSets(
-            {
-                objectDSPool,
-                vkUseArray(entityLayouts)
-            }
-        );
-
-        // Assign buffers to DS'
-        for (uint32_t bufferIndex = 0; bufferIndex < entityBuffers.size(); ++bufferIndex) {
-            auto buf = entityBuffers[bufferIndex].buffer.get();
-
-            vk::DescriptorBufferInfo objectUbo(
-                buf->buffer(),
-                0,
-                sizeof(EntityUBO)
-            );
-
-            std::array<vk::WriteDescriptorSet, 1> descriptorWrites = {
-                vk::WriteDescriptorSet(
-                    sets[bufferIndex],
-                    Internal::StandardBindings::EntityUniform,
-                    0, // Array element
-                    1, // Count
-                    vk::DescriptorType::eUniformBufferDynamic,
-                    nullptr,
-                    &objectUbo
-                )
-            };
-
-            device.updateDescriptorSets(descriptorWrites, {});
-            entityBuffers[bufferIndex].set = sets[bufferIndex];
-        }
-    }
-
-    if (!lightBuffers.empty()) {
-        std::vector<vk::DescriptorSetLayout> lightLayouts(lightBuffers.size(), lightDSL);
-
-        auto sets = device.allocateDescriptorSets(
-            {
-                objectDSPool,
-                vkUseArray(lightLayouts)
-            }
-        );
-
-        // Assign buffers to DS'
-        for (uint32_t bufferIndex = 0; bufferIndex < lightBuffers.size(); ++bufferIndex) {
-            auto buf = lightBuffers[bufferIndex].buffer.get();
-
-            vk::DescriptorBufferInfo objectUbo(
-                buf->buffer(),
-                0,
-                sizeof(LightUBO)
-            );
-
-            std::array<vk::WriteDescriptorSet, 1> descriptorWrites = {
-                vk::WriteDescriptorSet(
-                    sets[bufferIndex],
-                    Internal::StandardBindings::LightUniform,
-                    0, // Array element
-                    1, // Count
-                    vk::DescriptorType::eUniformBufferDynamic,
-                    nullptr,
-                    &objectUbo
-                )
-            };
-
-            device.updateDescriptorSets(descriptorWrites, {});
-            lightBuffers[bufferIndex].set = sets[bufferIndex];
-        }
-    }
+    entityStorage->setCopyCount(swapChainImages);
+    lightStorage->setCopyCount(swapChainImages);
 }
 
 void RenderPlanner::cleanupResources(vk::Device device, RenderEngine &engine) {
     renderableEntities.clear();
-    entityBuffers.clear();
+    unboundedEntities.clear();
+    dynamicBoundsEntities.clear();
+    renderTree.clear();
+    transforms.clear();
+    entityStorage.reset();
     lightEntities.clear();
-    lightBuffers.clear();
+    lightStorage.reset();
     device.destroyDescriptorSetLayout(cameraAndModelDSL);
-    device.destroyDescriptorSetLayout(objectDSL);
-    device.destroyDescriptorSetLayout(lightDSL);
 }
 
 void RenderPlanner::cleanupSwapChainResources(vk::Device device, RenderEngine &engine) {
 
     pipelineNormal.reset();
     device.destroyDescriptorPool(descriptorPool);
-    device.destroyDescriptorPool(objectDSPool);
 }
 
 void RenderPlanner::writeFrameCommands(vk::CommandBuffer, uint32_t activeImage) {
     const Mesh *lastMesh = nullptr;
 
     deferredPipeline->begin(activeImage);
+    deferredPipeline->bindSceneStorage(entityStorage->getBuffer(activeImage), lightStorage->getBuffer(activeImage));
+
+    // Lights are queued first so that they can be clustered before the geometry is drawn.
+    // Only entities in this planner's scene have a slot
+    Entity::forEachWith<Light, PlannerData>([this](Entity &entity, Light &light, PlannerData &data) {
+        if (data.light.slot != NoStorageSlot) {
+            deferredPipeline->renderLight(&entity, light);
+        }
+    });
 
     deferredPipeline->beginGeometry();
-    for (auto entity : renderableEntities) {
-        deferredPipeline->renderGeometry(entity);
+    auto camera = engine->getCamera();
+    if (camera && !deferredPipeline->isGpuCulling()) {
+        visibleEntities.clear();
+        renderTree.query(camera->getFrustum(), visibleEntities);
+
+        for (auto entity : visibleEntities) {
+            queueGeometry(camera, entity->get<MeshRenderer>(), entity->get<PlannerData>());
+        }
+        for (auto entity : unboundedEntities) {
+            queueGeometry(camera, entity->get<MeshRenderer>(), entity->get<PlannerData>());
+        }
+    } else {
+        // Everything is drawn when there is no camera, or culled later when culling is done on the GPU
+        Entity::forEachWith<MeshRenderer, PlannerData>(
+            [this, camera](Entity &, MeshRenderer &renderer, PlannerData &data) {
+                if (data.render.slot != NoStorageSlot) {
+                    queueGeometry(camera, renderer, data);
+                }
+            }
+        );
     }
     deferredPipeline->endGeometry();
 
     deferredPipeline->beginLighting();
-    for (auto entity : lightEntities) {
-        deferredPipeline->renderLight(entity);
-    }
     deferredPipeline->endLighting();
 
     deferredPipeline->end();
@@ -454,60 +333,112 @@ void RenderPlanner::writeFrameCommands(vk::CommandBuffer, uint32_t activeImage)
 
 void RenderPlanner::prepareFrame(uint32_t activeImage) {
     Subsystem::prepareFrame(activeImage);
+
+    // This must happen before the uniforms are copied to the GPU
+    updateTransforms();
+
+    // Bring this image's copy of the storage up to date. Its previous frame is complete by now
+    entityStorage->update(activeImage);
+    lightStorage->update(activeImage);
+
+    for (auto entity : dynamicBoundsEntities) {
+        refitEntityBounds(entity);
+    }
 }
 
-void RenderPlanner::updateEntityUniform(Entity *entity) {
+void RenderPlanner::updateEntityData(Entity *entity) {
     auto &data = entity->get<PlannerData>();
-    if (!data.render.buffer) {
+    if (data.render.slot == NoStorageSlot) {
         return;
     }
 
-    auto &buffer = data.render.buffer;
-    buffer->buffer->copyIn(
-        &data.absoluteTransform,
-        data.render.uniformOffset + offsetof(EntityUBO, transform),
+    entityStorage->write(
+        data.render.slot,
+        &transforms.getWorld(data.transformNode),
+        offsetof(EntityData, transform),
         sizeof(glm::mat4)
     );
 }
 
-glm::mat4 RenderPlanner::getRelativeTransform(const glm::mat4 &parent, const glm::mat4 &child) {
-    return parent * child;
+void RenderPlanner::updateEntityBounds(Entity *entity) {
+    auto mesh = entity->get<MeshRenderer>().getMesh();
+    if (mesh && mesh->hasDynamicBounds()) {
+        dynamicBoundsEntities.insert(entity);
+    } else {
+        dynamicBoundsEntities.erase(entity);
+    }
+
+    refitEntityBounds(entity);
 }
 
-void RenderPlanner::updateTransforms(Entity *entity, bool includeSelf) {
-    auto &rootData = entity->get<PlannerData>();
-    if (includeSelf && !entity->getParent()) {
-        rootData.absoluteTransform = entity->getTransform().getTransform();
+void RenderPlanner::updateDrawKey(Entity *entity) {
+    auto &renderer = entity->get<MeshRenderer>();
+    entity->get<PlannerData>().render.drawKey = deferredPipeline->getDrawKey(
+        renderer.getMesh(), renderer.getMaterial()
+    );
+}
+
+uint64_t RenderPlanner::getSortKey(const Camera *camera, const PlannerData &data) const {
+    if (!camera) {
+        return data.render.drawKey;
     }
 
-    struct Data {
-        PlannerData &parentData;
-        Entity *entity;
-    };
+    auto position = glm::vec3(transforms.getWorld(data.transformNode)[3]);
+    float viewDepth = glm::dot(position - camera->getPosition(), camera->getForward());
 
-    std::list<Data> toVisit;
+    return data.render.drawKey | DrawKey::depth(viewDepth, camera->getFarClip());
+}
 
-    if (includeSelf && entity->getParent()) {
-        toVisit.emplace_back(entity->getParent()->get<PlannerData>(), entity);
-    } else {
-        for (auto &child : entity->getChildren()) {
-            toVisit.emplace_back(rootData, child.get());
+void RenderPlanner::queueGeometry(const Camera *camera, const MeshRenderer &renderer, const PlannerData &data) {
+    deferredPipeline->renderGeometry(renderer, data.render.slot, getSortKey(camera, data));
+}
+
+void RenderPlanner::refitEntityBounds(Entity *entity) {
+    auto &data = entity->get<PlannerData>();
+    if (data.render.slot == NoStorageSlot) {
+        return;
+    }
+
+    auto mesh = entity->get<MeshRenderer>().getMesh();
+    const BoundingBox *bounds = nullptr;
+    if (mesh) {
+        bounds = mesh->getBounds();
+    }
+
+    if (!bounds) {
+        if (data.render.boundsProxy != NullProxy) {
+            renderTree.destroyProxy(data.render.boundsProxy);
+            data.render.boundsProxy = NullProxy;
+        }
+
+        // Without a mesh there is nothing to draw. Without bounds we cannot cull it
+        if (mesh) {
+            unboundedEntities.insert(entity);
+        } else {
+            unboundedEntities.erase(entity);
         }
+        return;
     }
 
-    while (!toVisit.empty()) {
-        auto data = toVisit.front();
-        toVisit.pop_front();
-        auto &plannerData = data.entity->get<PlannerData>();
+    unboundedEntities.erase(entity);
 
-        // FIXME: This breaks the components...
-        plannerData.absoluteTransform = getRelativeTransform(
-            data.parentData.absoluteTransform,
-            data.entity->getTransform().getTransform()
-        );
+    auto worldBounds = BoundingTree::transformBounds(*bounds, transforms.getWorld(data.transformNode));
+    if (data.render.boundsProxy == NullProxy) {
+        data.render.boundsProxy = renderTree.createProxy(worldBounds, entity);
+    } else {
+        renderTree.moveProxy(data.render.boundsProxy, worldBounds);
+    }
+}
 
-        for (auto &child : data.entity->getChildren()) {
-            toVisit.emplace_back(plannerData, child.get());
+void RenderPlanner::updateTransforms() {
+    for (auto entity : transforms.update()) {
+        auto &data = entity->get<PlannerData>();
+        if (data.render.slot != NoStorageSlot) {
+            updateEntityData(entity);
+            refitEntityBounds(entity);
+        }
+        if (data.light.slot != NoStorageSlot) {
+            updateLightData(entity);
         }
     }
 }
@@ -524,9 +455,7 @@ void RenderPlanner::addLight(Entity *entity) {
     lightEntities.insert(entity);
     auto &data = entity->get<PlannerData>();
 
-    auto pair = allocateLightUniform();
-    data.light.buffer = pair.first;
-    data.light.uniformOffset = pair.second;
+    data.light.slot = lightStorage->allocate();
 
     updateEntity(entity, EntityUpdateType::Light);
 }
@@ -535,105 +464,41 @@ void RenderPlanner::removeLight(Entity *entity) {
     lightEntities.erase(entity);
 
     auto &data = entity->get<PlannerData>();
-    if (data.light.buffer) {
-        data.light.buffer->buffer->freeSection(data.light.uniformOffset, uboBufferAlignment);
-        data.light.buffer = nullptr;
-    }
-}
-
-LightBuffer &RenderPlanner::newLightBuffer() {
-    auto uboBuffer = engine->getBufferManager().aquireDivisible(
-        uboBufferMaxSize,
-        vk::BufferUsageFlagBits::eUniformBuffer,
-        vk::MemoryUsage::eCPUToGPU
-    );
-
-    auto descriptorSets = device.allocateDescriptorSets(
-        {
-            objectDSPool,
-            1,
-            &lightDSL
-        }
-    );
-
-    auto objectDS = descriptorSets[0];
-
-    // Assign buffer to DS
-    vk::DescriptorBufferInfo bufferInfo(
-        uboBuffer->buffer(),
-        0,
-        sizeof(LightUBO)
-    );
-
-    std::array<vk::WriteDescriptorSet, 1> descriptorWrites = {{
-        {
-            objectDS,
-            Internal::StandardBindings::LightUniform,
-            0, // Array element
-            1, // Count
-            vk::DescriptorType::eUniformBufferDynamic,
-            nullptr,
-            &bufferInfo
-        }
-    }};
-
-    device.updateDescriptorSets(descriptorWrites, {});
-
-    auto &buffer = lightBuffers.emplace_back();
-    buffer.id = lightBuffers.size() - 1;
-    buffer.buffer = std::move(uboBuffer);
-    buffer.set = objectDS;
-
-    return buffer;
-}
-
-std::pair<LightBuffer *, uint32_t> RenderPlanner::allocateLightUniform() {
-    // Find the next available slot
-
-    // TODO: Need a way to have the allocator consider the alignment requirements
-    for (auto &buffer : lightBuffers) {
-        auto offset = buffer.buffer->allocateSection(uboBufferAlignment);
-        if (offset != ALLOCATION_FAILED) {
-            return { &buffer, offset };
-        }
-    }
-
-    auto &buffer = newLightBuffer();
-    auto offset = buffer.buffer->allocateSection(uboBufferAlignment);
-    // Sanity check
-    if (offset == ALLOCATION_FAILED) {
-        throw std::runtime_error("Out of object slots");
+    if (data.light.slot != NoStorageSlot) {
+        lightStorage->free(data.light.slot);
+        data.light.slot = NoStorageSlot;
     }
-
-    return { &buffer, offset };
 }
 
-void RenderPlanner::updateLightUniform(Entity *entity) {
+void RenderPlanner::updateLightData(Entity *entity) {
     auto &data = entity->get<PlannerData>();
     auto &light = entity->get<Light>();
-    assert(data.light.buffer);
+    assert(data.light.slot != NoStorageSlot);
 
-    auto &buffer = data.light.buffer;
-    LightUBO uniform {};
-    uniform.position = entity->getTransform().getPosition();
+    LightData lightData {};
+    lightData.position = entity->getTransform().getPosition();
     if (light.getType() == LightType::Directional || light.getType() == LightType::Spot) {
-        uniform.direction = glm::normalize(glm::rotate(entity->getTransform().getRotation(), glm::vec3(0, 0, 1)));
+        lightData.direction = glm::normalize(glm::rotate(entity->getTransform().getRotation(), glm::vec3(0, 0, 1)));
     }
 
-    uniform.color = light.getColor();
-    uniform.intensity = light.getIntensity();
-    uniform.range = light.getRange();
-    uniform.type = static_cast<uint32_t>(light.getType());
+    lightData.color = light.getColor();
+    lightData.intensity = light.getIntensity();
+    lightData.range = light.getRange();
+    lightData.type = static_cast<uint32_t>(light.getType());
+    lightData.spotCosine = glm::cos(glm::radians(light.getSpotAngle()));
 
-    buffer->buffer->copyIn(
-        &uniform,
-        data.light.uniformOffset,
-        sizeof(LightUBO)
-    );
+    lightStorage->write(data.light.slot, lightData);
 }
 
 void RenderPlanner::init(DeferredPipeline &pipeline) {
     deferredPipeline = &pipeline;
 }
 
+void RenderPlanner::setEagerTransforms(bool eager) {
+    eagerTransforms = eager;
+    if (eager) {
+        updateTransforms();
+    }
+}
+
 }
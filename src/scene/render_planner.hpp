@@ -2,24 +2,33 @@
 
 #include "tech-core/scene/entity.hpp"
 #include "tech-core/subsystem/base.hpp"
-#include "internal.hpp"
+#include "storage_slots.hpp"
+#include "bounding_tree.hpp"
+#include "transform_hierarchy.hpp"
+#include "worker_pool.hpp"
 #include "pipelines/deferred_pipeline.hpp"
 #include <vulkan/vulkan.hpp>
 #include <unordered_set>
 
 namespace Engine::Internal {
 
-struct EntityUBO {
+class PlannerData;
+
+// One record of the entity storage. Must match EntityData in the shaders
+struct EntityData {
     alignas(16) glm::mat4 transform;
 };
 
-struct LightUBO {
+// One record of the light storage. Must match LightData in the shaders
+struct LightData {
     alignas(16) glm::vec3 position;
     alignas(16) glm::vec3 direction;
     alignas(16) glm::vec3 color;
     float intensity;
     float range;
     uint32_t type;
+    // Cosine of the spot cone's angle
+    float spotCosine;
 };
 
 enum class EntityUpdateType {
@@ -45,6 +54,12 @@ public:
     void prepareFrame(uint32_t activeImage) override;
     void prepareEntity(Entity *);
 
+    /**
+     * When enabled, transform changes are propagated to children and uploaded immediately
+     * instead of once per frame.
+     */
+    void setEagerTransforms(bool);
+
     void addEntity(Entity *);
     void removeEntity(Entity *);
     void updateEntity(Entity *, EntityUpdateType);
@@ -54,40 +69,47 @@ private:
     DeferredPipeline *deferredPipeline { nullptr };
 
     bool ignoreComponentUpdates { false };
+    bool eagerTransforms { false };
 
-    // TODO: Eventually replace this with a QuadTree or other spacial partitioning structure
     std::unordered_set<Entity *> renderableEntities;
     std::unordered_set<Entity *> lightEntities;
+
+    // World transforms of every entity in the scene
+    WorkerPool workers;
+    TransformHierarchy transforms { workers };
+
+    // Visibility
+    BoundingTree renderTree;
+    // Entities whose mesh has no known bounds. These are always rendered
+    std::unordered_set<Entity *> unboundedEntities;
+    // Entities whose mesh bounds may change without notice
+    std::unordered_set<Entity *> dynamicBoundsEntities;
+    std::vector<Entity *> visibleEntities;
     std::unique_ptr<Pipeline> pipelineNormal;
 
-    vk::DeviceSize uboBufferAlignment;
-    vk::DeviceSize uboBufferMaxSize;
-    std::vector<EntityBuffer> entityBuffers;
-    std::vector<LightBuffer> lightBuffers;
+    uint32_t swapChainImages { 0 };
+    // Per entity and per light data, indexed by the slots in PlannerData
+    std::unique_ptr<StorageSlots> entityStorage;
+    std::unique_ptr<StorageSlots> lightStorage;
 
     vk::DescriptorSetLayout cameraAndModelDSL;
     vk::DescriptorPool descriptorPool;
     std::vector<vk::DescriptorSet> cameraAndModelDS;
 
-    vk::DescriptorSetLayout objectDSL;
-    vk::DescriptorPool objectDSPool;
-
-    vk::DescriptorSetLayout lightDSL;
-
     const Material *defaultMaterial;
 
     void addToRender(Entity *);
     void removeFromRender(Entity *);
     void addLight(Entity *);
     void removeLight(Entity *);
-    EntityBuffer &newEntityBuffer();
-    std::pair<EntityBuffer *, uint32_t> allocateEntityUniform();
-    void updateEntityUniform(Entity *);
-    LightBuffer &newLightBuffer();
-    std::pair<LightBuffer *, uint32_t> allocateLightUniform();
-    void updateLightUniform(Entity *);
-    static glm::mat4 getRelativeTransform(const glm::mat4 &parent, const glm::mat4 &child);
-    void updateTransforms(Entity *, bool includeSelf);
+    void updateEntityData(Entity *);
+    void updateEntityBounds(Entity *);
+    void updateDrawKey(Entity *);
+    uint64_t getSortKey(const Camera *, const PlannerData &) const;
+    void queueGeometry(const Camera *, const MeshRenderer &, const PlannerData &);
+    void refitEntityBounds(Entity *);
+    void updateLightData(Entity *);
+    void updateTransforms();
 };
 
 }
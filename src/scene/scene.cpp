@@ -49,7 +49,7 @@ std::shared_ptr<Entity> Scene::getChildByIndex(uint32_t index) const {
 void Scene::removeChildById(EntityId id) {
     auto it = childrenById.find(id);
     if (it != childrenById.end()) {
-        auto &child = it->second;
+        auto child = it->second;
         auto childIt = children.begin();
         while (childIt != children.end()) {
             auto &other = *childIt;
@@ -64,12 +64,21 @@ void Scene::removeChildById(EntityId id) {
         if (renderPlanner) {
             renderPlanner->removeEntity(child.get());
         }
+        child->forEachChild(
+            true,
+            [this](Entity *grandChild) {
+                grandChild->setScene({}, nullptr);
+                if (renderPlanner) {
+                    renderPlanner->removeEntity(grandChild);
+                }
+            }
+        );
     }
 }
 
 void Scene::removeChildByIndex(uint32_t index) {
     assert(index < children.size());
-    auto &entity = children[index];
+    auto entity = children[index];
     children.erase(children.begin() + index);
     entity->setScene({}, nullptr);
 
@@ -80,6 +89,15 @@ void Scene::removeChildByIndex(uint32_t index) {
     if (renderPlanner) {
         renderPlanner->removeEntity(entity.get());
     }
+    entity->forEachChild(
+        true,
+        [this](Entity *child) {
+            child->setScene({}, nullptr);
+            if (renderPlanner) {
+                renderPlanner->removeEntity(child);
+            }
+        }
+    );
 }
 
 void Scene::onAdd(Badge<Entity>, const std::shared_ptr<Entity> &entity) {
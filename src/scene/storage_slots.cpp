@@ -0,0 +1,56 @@
+#include "storage_slots.hpp"
+#include "tech-core/buffer.hpp"
+#include <cassert>
+
+namespace Engine::Internal {
+
+StorageSlots::StorageSlots(BufferManager &manager, vk::DeviceSize stride, uint32_t initialCapacity, uint32_t copies)
+    : stride(stride), capacity(initialCapacity) {
+    buffer = manager.aquireReplicated(
+        stride * capacity,
+        vk::BufferUsageFlagBits::eStorageBuffer,
+        vk::MemoryUsage::eCPUToGPU,
+        copies
+    );
+}
+
+StorageSlots::~StorageSlots() = default;
+
+StorageSlot StorageSlots::allocate() {
+    if (!freeSlots.empty()) {
+        auto slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+
+    if (nextSlot == capacity) {
+        capacity *= 2;
+        buffer->resize(stride * capacity);
+    }
+
+    return nextSlot++;
+}
+
+void StorageSlots::free(StorageSlot slot) {
+    assert(slot < nextSlot);
+    freeSlots.push_back(slot);
+}
+
+void StorageSlots::write(StorageSlot slot, const void *data, vk::DeviceSize offset, vk::DeviceSize size) {
+    assert(slot < nextSlot && offset + size <= stride);
+    buffer->copyIn(data, slot * stride + offset, size);
+}
+
+bool StorageSlots::update(uint32_t copy) {
+    return buffer->update(copy);
+}
+
+void StorageSlots::setCopyCount(uint32_t count) {
+    buffer->setCopyCount(count);
+}
+
+const std::shared_ptr<Buffer> &StorageSlots::getBuffer(uint32_t copy) const {
+    return buffer->getCopy(copy);
+}
+
+}
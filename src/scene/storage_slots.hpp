@@ -0,0 +1,61 @@
+#pragma once
+
+#include "tech-core/forward.hpp"
+#include <vulkan/vulkan.hpp>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace Engine::Internal {
+
+typedef uint32_t StorageSlot;
+
+const StorageSlot NoStorageSlot = std::numeric_limits<StorageSlot>::max();
+
+/**
+ * Fixed size records in a storage buffer with a copy for each swap chain image.
+ * Shaders find records by their slot index so nothing needs rebinding per draw,
+ * and the buffer grows whenever it runs out of slots.
+ */
+class StorageSlots {
+public:
+    StorageSlots(BufferManager &, vk::DeviceSize stride, uint32_t initialCapacity, uint32_t copies);
+    ~StorageSlots();
+
+    StorageSlot allocate();
+    void free(StorageSlot);
+
+    void write(StorageSlot, const void *data, vk::DeviceSize offset, vk::DeviceSize size);
+    template<typename T>
+    void write(StorageSlot slot, const T &data) {
+        write(slot, &data, 0, sizeof(T));
+    }
+
+    /**
+     * Brings the copy up to date. Only call this once the copy is no longer in use by the GPU
+     * @returns true if the copy was replaced by a larger buffer
+     */
+    bool update(uint32_t copy);
+
+    void setCopyCount(uint32_t count);
+
+    const std::shared_ptr<Buffer> &getBuffer(uint32_t copy) const;
+
+    uint32_t getCapacity() const { return capacity; }
+    uint32_t getUsedCount() const { return nextSlot - static_cast<uint32_t>(freeSlots.size()); }
+
+private:
+    // Provided
+    vk::DeviceSize stride;
+
+    // Owned
+    std::unique_ptr<ReplicatedBuffer> buffer;
+
+    // State
+    uint32_t capacity;
+    StorageSlot nextSlot { 0 };
+    std::vector<StorageSlot> freeSlots;
+};
+
+}
@@ -0,0 +1,266 @@
+#include "transform_hierarchy.hpp"
+#include "transform_kernels.hpp"
+#include "tech-core/scene/entity.hpp"
+#include "components/planner_data.hpp"
+#include "worker_pool.hpp"
+#include <algorithm>
+#include <cassert>
+
+namespace Engine::Internal {
+
+template<typename T>
+void gatherNodes(std::vector<T> &values, const std::vector<TransformNode> &order) {
+    std::vector<T> sorted;
+    sorted.reserve(order.size());
+    for (auto node : order) {
+        sorted.push_back(values[node]);
+    }
+
+    values.swap(sorted);
+}
+
+TransformHierarchy::TransformHierarchy(WorkerPool &workers)
+    : workers(workers) {
+}
+
+TransformNode TransformHierarchy::add(Entity *entity, TransformNode parent, const Transform &localTransform) {
+    assert(parent == NoTransformNode || (parent < entities.size() && entities[parent]));
+
+    auto node = static_cast<TransformNode>(entities.size());
+    uint32_t depth = (parent == NoTransformNode) ? 0 : depths[parent] + 1;
+
+    positions.emplace_back();
+    rotations.emplace_back();
+    scales.emplace_back();
+    local.emplace_back();
+    world.emplace_back();
+    parents.push_back(parent);
+    depths.push_back(depth);
+    entities.push_back(entity);
+    dirty.push_back(false);
+    needsCompose.push_back(false);
+
+    // Keep the levels contiguous where possible, otherwise sort them out on the next update
+    if (!needsReorder) {
+        if (depth == levelStarts.size()) {
+            levelStarts.push_back(node);
+        } else if (depth + 1 != levelStarts.size()) {
+            needsReorder = true;
+        }
+    }
+
+    setLocalData(node, localTransform);
+    if (needsCompose[node]) {
+        composeTransforms(&node, 1, positions.data(), rotations.data(), scales.data(), local.data());
+        needsCompose[node] = false;
+    }
+
+    if (parent == NoTransformNode) {
+        world[node] = local[node];
+    } else {
+        multiplyTransform(world[parent], local[node], world[node]);
+        if (dirty[parent]) {
+            markDirty(node);
+        }
+    }
+
+    return node;
+}
+
+void TransformHierarchy::remove(TransformNode node) {
+    assert(node < entities.size() && entities[node]);
+
+    entities[node] = nullptr;
+    dirty[node] = false;
+    needsCompose[node] = false;
+    ++removedCount;
+    needsReorder = true;
+}
+
+void TransformHierarchy::setLocal(TransformNode node, const Transform &transform) {
+    assert(node < entities.size() && entities[node]);
+
+    setLocalData(node, transform);
+    markDirty(node);
+}
+
+const std::vector<Entity *> &TransformHierarchy::update() {
+    if (needsReorder) {
+        reorder();
+    }
+
+    changed.clear();
+    if (firstDirty == NoTransformNode) {
+        return changed;
+    }
+
+    // Each level only depends on the one before it, so the nodes within a level can be done in parallel
+    auto count = static_cast<TransformNode>(entities.size());
+    for (size_t level = 0; level < levelStarts.size(); ++level) {
+        TransformNode begin = std::max(levelStarts[level], firstDirty);
+        TransformNode end = (level + 1 < levelStarts.size()) ? levelStarts[level + 1] : count;
+        if (begin >= end) {
+            continue;
+        }
+
+        workers.parallelFor(
+            end - begin, GrainSize, [this, begin](size_t rangeBegin, size_t rangeEnd) {
+                updateRange(
+                    begin + static_cast<TransformNode>(rangeBegin),
+                    begin + static_cast<TransformNode>(rangeEnd)
+                );
+            }
+        );
+    }
+
+    // Flags can only be cleared once all children have seen them
+    for (auto node = firstDirty; node < count; ++node) {
+        if (dirty[node]) {
+            changed.push_back(entities[node]);
+            dirty[node] = false;
+        }
+    }
+    firstDirty = NoTransformNode;
+
+    return changed;
+}
+
+void TransformHierarchy::clear() {
+    positions.clear();
+    rotations.clear();
+    scales.clear();
+    local.clear();
+    world.clear();
+    parents.clear();
+    depths.clear();
+    entities.clear();
+    dirty.clear();
+    needsCompose.clear();
+    levelStarts.clear();
+    firstDirty = NoTransformNode;
+    removedCount = 0;
+    needsReorder = false;
+}
+
+void TransformHierarchy::setLocalData(TransformNode node, const Transform &transform) {
+    if (transform.hasMatrixOverride()) {
+        local[node] = transform.getTransform();
+        needsCompose[node] = false;
+    } else {
+        positions[node] = transform.getPosition();
+        rotations[node] = transform.getRotation();
+        scales[node] = transform.getScale();
+        needsCompose[node] = true;
+    }
+}
+
+void TransformHierarchy::markDirty(TransformNode node) {
+    dirty[node] = true;
+    if (firstDirty == NoTransformNode || node < firstDirty) {
+        firstDirty = node;
+    }
+}
+
+/**
+ * Brings the world transforms of one range within a level up to date.
+ * Safe to run concurrently with other ranges of the same level.
+ */
+void TransformHierarchy::updateRange(TransformNode begin, TransformNode end) {
+    TransformNode batch[ComposeBatchSize];
+    size_t batchSize = 0;
+
+    for (auto node = begin; node < end; ++node) {
+        if (!needsCompose[node]) {
+            continue;
+        }
+
+        needsCompose[node] = false;
+        batch[batchSize++] = node;
+        if (batchSize == ComposeBatchSize) {
+            composeTransforms(batch, batchSize, positions.data(), rotations.data(), scales.data(), local.data());
+            batchSize = 0;
+        }
+    }
+
+    if (batchSize > 0) {
+        composeTransforms(batch, batchSize, positions.data(), rotations.data(), scales.data(), local.data());
+    }
+
+    for (auto node = begin; node < end; ++node) {
+        auto parent = parents[node];
+        if (parent == NoTransformNode) {
+            if (dirty[node]) {
+                world[node] = local[node];
+            }
+        } else if (dirty[node] || dirty[parent]) {
+            dirty[node] = true;
+            multiplyTransform(world[parent], local[node], world[node]);
+        }
+    }
+}
+
+/**
+ * Closes the gaps left by removed nodes and sorts the nodes by depth.
+ * Relative order within a level is kept.
+ */
+void TransformHierarchy::reorder() {
+    auto count = static_cast<TransformNode>(entities.size());
+
+    uint32_t levelCount = 0;
+    for (TransformNode node = 0; node < count; ++node) {
+        if (entities[node]) {
+            levelCount = std::max(levelCount, depths[node] + 1);
+        }
+    }
+
+    // Counting sort by depth
+    levelStarts.assign(levelCount, 0);
+    for (TransformNode node = 0; node < count; ++node) {
+        if (entities[node] && depths[node] + 1 < levelCount) {
+            ++levelStarts[depths[node] + 1];
+        }
+    }
+    for (uint32_t level = 1; level < levelCount; ++level) {
+        levelStarts[level] += levelStarts[level - 1];
+    }
+
+    auto cursors = levelStarts;
+    order.resize(count - removedCount);
+    remap.assign(count, NoTransformNode);
+    for (TransformNode node = 0; node < count; ++node) {
+        if (entities[node]) {
+            auto target = cursors[depths[node]]++;
+            order[target] = node;
+            remap[node] = target;
+        }
+    }
+
+    gatherNodes(positions, order);
+    gatherNodes(rotations, order);
+    gatherNodes(scales, order);
+    gatherNodes(local, order);
+    gatherNodes(world, order);
+    gatherNodes(parents, order);
+    gatherNodes(depths, order);
+    gatherNodes(entities, order);
+    gatherNodes(dirty, order);
+    gatherNodes(needsCompose, order);
+
+    firstDirty = NoTransformNode;
+    for (TransformNode node = 0; node < order.size(); ++node) {
+        if (parents[node] != NoTransformNode) {
+            parents[node] = remap[parents[node]];
+        }
+        if (order[node] != node) {
+            entities[node]->get<PlannerData>().transformNode = node;
+        }
+        if (dirty[node] && firstDirty == NoTransformNode) {
+            firstDirty = node;
+        }
+    }
+
+    removedCount = 0;
+    needsReorder = false;
+}
+
+}
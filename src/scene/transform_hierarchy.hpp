@@ -0,0 +1,92 @@
+#pragma once
+
+#include "tech-core/forward.hpp"
+#include "tech-core/scene/components/transform.hpp"
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace Engine::Internal {
+
+class WorkerPool;
+
+typedef uint32_t TransformNode;
+
+const TransformNode NoTransformNode = std::numeric_limits<TransformNode>::max();
+
+/**
+ * The local and world transforms of every entity in the scene, stored in flat arrays.
+ * Nodes are ordered by their depth in the hierarchy so parents always come before their
+ * children, and every level is one contiguous range that can be split across threads.
+ */
+class TransformHierarchy {
+public:
+    explicit TransformHierarchy(WorkerPool &workers);
+
+    /**
+     * Appends a node for the entity. The parent must already be in the hierarchy.
+     */
+    TransformNode add(Entity *entity, TransformNode parent, const Transform &localTransform);
+
+    /**
+     * Removes a node. Its children must be removed as well.
+     * The space is reclaimed during the next update.
+     */
+    void remove(TransformNode);
+
+    void setLocal(TransformNode, const Transform &);
+
+    const glm::mat4 &getWorld(TransformNode node) const { return world[node]; }
+
+    /**
+     * Recomputes the world transform of every modified node and all of its descendants.
+     * @returns The entities whose world transform changed
+     */
+    const std::vector<Entity *> &update();
+
+    void clear();
+
+    size_t size() const { return entities.size() - removedCount; }
+
+private:
+    // Nodes in each range given to a worker
+    static constexpr size_t GrainSize = 1024;
+    // Nodes gathered before composing their local matrices
+    static constexpr size_t ComposeBatchSize = 64;
+
+    // Provided
+    WorkerPool &workers;
+
+    // State
+    std::vector<glm::vec3> positions;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<glm::mat4> local;
+    std::vector<glm::mat4> world;
+    std::vector<TransformNode> parents;
+    std::vector<uint32_t> depths;
+    std::vector<Entity *> entities;
+    std::vector<uint8_t> dirty;
+    std::vector<uint8_t> needsCompose;
+
+    // The first node of each depth
+    std::vector<TransformNode> levelStarts;
+    TransformNode firstDirty { NoTransformNode };
+    uint32_t removedCount { 0 };
+    bool needsReorder { false };
+
+    // Transient
+    std::vector<Entity *> changed;
+    std::vector<TransformNode> remap;
+    std::vector<TransformNode> order;
+
+    void setLocalData(TransformNode, const Transform &);
+    void markDirty(TransformNode);
+    void updateRange(TransformNode begin, TransformNode end);
+    void reorder();
+};
+
+}
@@ -0,0 +1,109 @@
+#include "transform_kernels.hpp"
+
+namespace Engine::Internal {
+
+/**
+ * Equivalent to translate(position) * mat4_cast(rotation) * scale(scale)
+ */
+inline void composeTransform(
+    const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale, glm::mat4 &out
+) {
+    float xx = rotation.x * rotation.x;
+    float yy = rotation.y * rotation.y;
+    float zz = rotation.z * rotation.z;
+    float xy = rotation.x * rotation.y;
+    float xz = rotation.x * rotation.z;
+    float yz = rotation.y * rotation.z;
+    float wx = rotation.w * rotation.x;
+    float wy = rotation.w * rotation.y;
+    float wz = rotation.w * rotation.z;
+
+    out[0] = glm::vec4(1 - 2 * (yy + zz), 2 * (xy + wz), 2 * (xz - wy), 0) * scale.x;
+    out[1] = glm::vec4(2 * (xy - wz), 1 - 2 * (xx + zz), 2 * (yz + wx), 0) * scale.y;
+    out[2] = glm::vec4(2 * (xz + wy), 2 * (yz - wx), 1 - 2 * (xx + yy), 0) * scale.z;
+    out[3] = glm::vec4(position, 1);
+}
+
+void composeTransforms(
+    const TransformNode *nodes,
+    size_t count,
+    const glm::vec3 *positions,
+    const glm::quat *rotations,
+    const glm::vec3 *scales,
+    glm::mat4 *out
+) {
+    size_t index = 0;
+
+#ifdef TECH_TRANSFORM_SSE
+    const __m128 one = _mm_set1_ps(1);
+    const __m128 two = _mm_set1_ps(2);
+    const __m128 zero = _mm_setzero_ps();
+
+    for (; index + 4 <= count; index += 4) {
+        auto n0 = nodes[index];
+        auto n1 = nodes[index + 1];
+        auto n2 = nodes[index + 2];
+        auto n3 = nodes[index + 3];
+
+        // Gather each component of the four nodes into one register
+        __m128 qx = _mm_setr_ps(rotations[n0].x, rotations[n1].x, rotations[n2].x, rotations[n3].x);
+        __m128 qy = _mm_setr_ps(rotations[n0].y, rotations[n1].y, rotations[n2].y, rotations[n3].y);
+        __m128 qz = _mm_setr_ps(rotations[n0].z, rotations[n1].z, rotations[n2].z, rotations[n3].z);
+        __m128 qw = _mm_setr_ps(rotations[n0].w, rotations[n1].w, rotations[n2].w, rotations[n3].w);
+
+        __m128 sx = _mm_setr_ps(scales[n0].x, scales[n1].x, scales[n2].x, scales[n3].x);
+        __m128 sy = _mm_setr_ps(scales[n0].y, scales[n1].y, scales[n2].y, scales[n3].y);
+        __m128 sz = _mm_setr_ps(scales[n0].z, scales[n1].z, scales[n2].z, scales[n3].z);
+
+        __m128 xx = _mm_mul_ps(qx, qx);
+        __m128 yy = _mm_mul_ps(qy, qy);
+        __m128 zz = _mm_mul_ps(qz, qz);
+        __m128 xy = _mm_mul_ps(qx, qy);
+        __m128 xz = _mm_mul_ps(qx, qz);
+        __m128 yz = _mm_mul_ps(qy, qz);
+        __m128 wx = _mm_mul_ps(qw, qx);
+        __m128 wy = _mm_mul_ps(qw, qy);
+        __m128 wz = _mm_mul_ps(qw, qz);
+
+        __m128 c0x = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+        __m128 c0y = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+        __m128 c0z = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+
+        __m128 c1x = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+        __m128 c1y = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+        __m128 c1z = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+
+        __m128 c2x = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+        __m128 c2y = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+        __m128 c2z = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+
+        // Turn the component registers back into one column per node
+        __m128 c0w = zero;
+        __m128 c1w = zero;
+        __m128 c2w = zero;
+        _MM_TRANSPOSE4_PS(c0x, c0y, c0z, c0w);
+        _MM_TRANSPOSE4_PS(c1x, c1y, c1z, c1w);
+        _MM_TRANSPOSE4_PS(c2x, c2y, c2z, c2w);
+
+        const __m128 column0[4] = { c0x, c0y, c0z, c0w };
+        const __m128 column1[4] = { c1x, c1y, c1z, c1w };
+        const __m128 column2[4] = { c2x, c2y, c2z, c2w };
+        const TransformNode lanes[4] = { n0, n1, n2, n3 };
+
+        for (int lane = 0; lane < 4; ++lane) {
+            float *matrix = &out[lanes[lane]][0][0];
+            _mm_storeu_ps(matrix, column0[lane]);
+            _mm_storeu_ps(matrix + 4, column1[lane]);
+            _mm_storeu_ps(matrix + 8, column2[lane]);
+            out[lanes[lane]][3] = glm::vec4(positions[lanes[lane]], 1);
+        }
+    }
+#endif
+
+    for (; index < count; ++index) {
+        auto node = nodes[index];
+        composeTransform(positions[node], rotations[node], scales[node], out[node]);
+    }
+}
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "transform_hierarchy.hpp"
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define TECH_TRANSFORM_SSE
+#include <immintrin.h>
+#endif
+
+namespace Engine::Internal {
+
+/**
+ * Builds translation * rotation * scale matrices for the listed nodes.
+ * Four nodes are composed at once, one per SIMD lane.
+ */
+void composeTransforms(
+    const TransformNode *nodes,
+    size_t count,
+    const glm::vec3 *positions,
+    const glm::quat *rotations,
+    const glm::vec3 *scales,
+    glm::mat4 *out
+);
+
+/**
+ * out = parent * child
+ */
+inline void multiplyTransform(const glm::mat4 &parent, const glm::mat4 &child, glm::mat4 &out) {
+#ifdef TECH_TRANSFORM_SSE
+    const float *p = &parent[0][0];
+    const float *c = &child[0][0];
+    float *o = &out[0][0];
+
+    __m128 p0 = _mm_loadu_ps(p);
+    __m128 p1 = _mm_loadu_ps(p + 4);
+    __m128 p2 = _mm_loadu_ps(p + 8);
+    __m128 p3 = _mm_loadu_ps(p + 12);
+
+    // Each result column is the parent columns weighted by the child column
+    for (int column = 0; column < 4; ++column) {
+        const float *cc = c + column * 4;
+        __m128 result = _mm_mul_ps(p0, _mm_set1_ps(cc[0]));
+        result = _mm_add_ps(result, _mm_mul_ps(p1, _mm_set1_ps(cc[1])));
+        result = _mm_add_ps(result, _mm_mul_ps(p2, _mm_set1_ps(cc[2])));
+        result = _mm_add_ps(result, _mm_mul_ps(p3, _mm_set1_ps(cc[3])));
+        _mm_storeu_ps(o + column * 4, result);
+    }
+#else
+    out = parent * child;
+#endif
+}
+
+}
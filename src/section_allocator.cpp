@@ -0,0 +1,365 @@
+#include "tech-core/section_allocator.hpp"
+
+#include <bit>
+#include <cassert>
+#include <stdexcept>
+
+namespace Engine {
+
+// Limits how many blocks are checked for one that is already aligned
+const uint32_t AlignedSearchLimit = 8;
+
+SectionAllocator::SectionAllocator(vk::DeviceSize size) {
+    reset(size);
+}
+
+void SectionAllocator::reset(vk::DeviceSize size) {
+    blocks.clear();
+    unusedBlocks.clear();
+    allocatedBlocks.clear();
+
+    firstLevelMap = 0;
+    secondLevelMap.fill(0);
+    freeLists.fill(NoBlock);
+
+    totalSize = size;
+    usedSize = 0;
+    freeBlockCount = 0;
+
+    if (size > 0) {
+        insertFree(createBlock(0, size));
+    }
+}
+
+vk::DeviceSize SectionAllocator::allocate(vk::DeviceSize size, vk::DeviceSize alignment) {
+    assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+    if (size == 0) {
+        size = 1;
+    }
+
+    if (size > totalSize || alignment > totalSize) {
+        return ALLOCATION_FAILED;
+    }
+
+    uint32_t block = NoBlock;
+    if (alignment > 1) {
+        block = findAlignedBlock(size, alignment);
+    }
+
+    if (block == NoBlock) {
+        // Make sure there is enough room to align the block no matter where it starts
+        uint32_t firstLevel, secondLevel;
+        if (mappingSearch(size + alignment - 1, firstLevel, secondLevel)) {
+            block = findFreeBlock(firstLevel, secondLevel);
+        }
+    }
+
+    if (block == NoBlock) {
+        // The search skips the lists holding blocks that are only sometimes large enough
+        block = findFittingBlock(size, alignment);
+        if (block == NoBlock) {
+            return ALLOCATION_FAILED;
+        }
+    }
+
+    removeFree(block);
+
+    // Give back any space needed for alignment
+    auto offset = blocks[block].offset;
+    auto alignedOffset = (offset + alignment - 1) & ~(alignment - 1);
+    if (alignedOffset != offset) {
+        auto padding = splitBefore(block, alignedOffset - offset);
+        insertFree(padding);
+    }
+
+    if (blocks[block].size > size) {
+        splitAfter(block, size);
+    }
+
+    allocatedBlocks[alignedOffset] = block;
+    usedSize += blocks[block].size;
+
+    return alignedOffset;
+}
+
+void SectionAllocator::free(vk::DeviceSize offset) {
+    auto it = allocatedBlocks.find(offset);
+    if (it == allocatedBlocks.end()) {
+        throw std::runtime_error("Section was not allocated");
+    }
+
+    auto block = it->second;
+    allocatedBlocks.erase(it);
+    usedSize -= blocks[block].size;
+
+    // Coalesce with neighbouring free space
+    auto prev = blocks[block].prevPhysical;
+    if (prev != NoBlock && blocks[prev].isFree) {
+        removeFree(prev);
+        block = merge(prev, block);
+    }
+
+    auto next = blocks[block].nextPhysical;
+    if (next != NoBlock && blocks[next].isFree) {
+        removeFree(next);
+        block = merge(block, next);
+    }
+
+    insertFree(block);
+}
+
+SectionAllocatorStats SectionAllocator::getStats() const {
+    SectionAllocatorStats stats;
+    stats.totalSize = totalSize;
+    stats.usedSize = usedSize;
+    stats.freeSize = totalSize - usedSize;
+    stats.allocationCount = static_cast<uint32_t>(allocatedBlocks.size());
+    stats.freeBlockCount = freeBlockCount;
+
+    if (firstLevelMap) {
+        // The largest block must be in the highest non-empty list
+        uint32_t firstLevel = 63 - std::countl_zero(firstLevelMap);
+        uint32_t secondLevel = 31 - std::countl_zero(secondLevelMap[firstLevel]);
+
+        auto block = freeLists[firstLevel * SubdivisionCount + secondLevel];
+        while (block != NoBlock) {
+            stats.largestFreeBlock = std::max(stats.largestFreeBlock, blocks[block].size);
+            block = blocks[block].nextFree;
+        }
+    }
+
+    return stats;
+}
+
+void SectionAllocator::mapping(vk::DeviceSize size, uint32_t &firstLevel, uint32_t &secondLevel) {
+    if (size < SubdivisionCount) {
+        // Small sizes are linearly subdivided
+        firstLevel = 0;
+        secondLevel = static_cast<uint32_t>(size);
+    } else {
+        uint32_t mostSignificant = std::bit_width(size) - 1;
+        firstLevel = mostSignificant - SubdivisionLog2 + 1;
+        secondLevel = static_cast<uint32_t>(size >> (mostSignificant - SubdivisionLog2)) ^ SubdivisionCount;
+    }
+}
+
+bool SectionAllocator::mappingSearch(vk::DeviceSize size, uint32_t &firstLevel, uint32_t &secondLevel) {
+    // Round up to the next list so that any block found is large enough
+    if (size >= SubdivisionCount) {
+        uint32_t mostSignificant = std::bit_width(size) - 1;
+        vk::DeviceSize round = (vk::DeviceSize(1) << (mostSignificant - SubdivisionLog2)) - 1;
+        if (size > std::numeric_limits<vk::DeviceSize>::max() - round) {
+            return false;
+        }
+
+        size += round;
+    }
+
+    mapping(size, firstLevel, secondLevel);
+    return true;
+}
+
+uint32_t SectionAllocator::findFreeBlock(uint32_t &firstLevel, uint32_t &secondLevel) const {
+    uint32_t secondLevelBits = secondLevelMap[firstLevel] & (~0u << secondLevel);
+    if (!secondLevelBits) {
+        // Nothing left at this level, move to the next non-empty one
+        if (firstLevel + 1 >= FirstLevelCount) {
+            return NoBlock;
+        }
+
+        uint64_t firstLevelBits = firstLevelMap & (~0ull << (firstLevel + 1));
+        if (!firstLevelBits) {
+            return NoBlock;
+        }
+
+        firstLevel = std::countr_zero(firstLevelBits);
+        secondLevelBits = secondLevelMap[firstLevel];
+    }
+
+    secondLevel = std::countr_zero(secondLevelBits);
+    return freeLists[firstLevel * SubdivisionCount + secondLevel];
+}
+
+uint32_t SectionAllocator::findAlignedBlock(vk::DeviceSize size, vk::DeviceSize alignment) const {
+    uint32_t firstLevel, secondLevel;
+    if (!mappingSearch(size, firstLevel, secondLevel)) {
+        return NoBlock;
+    }
+
+    // Sections are often freed in the same size and alignment they were allocated in
+    // so there is a good chance of finding one that needs no padding.
+    auto block = findFreeBlock(firstLevel, secondLevel);
+    for (uint32_t i = 0; i < AlignedSearchLimit && block != NoBlock; ++i) {
+        auto &candidate = blocks[block];
+        auto alignedOffset = (candidate.offset + alignment - 1) & ~(alignment - 1);
+        if (alignedOffset + size <= candidate.offset + candidate.size) {
+            return block;
+        }
+
+        block = candidate.nextFree;
+    }
+
+    return NoBlock;
+}
+
+uint32_t SectionAllocator::findFittingBlock(vk::DeviceSize size, vk::DeviceSize alignment) const {
+    uint32_t firstLevel, secondLevel, lastFirstLevel, lastSecondLevel;
+    mapping(size, firstLevel, secondLevel);
+    mapping(size + alignment - 1, lastFirstLevel, lastSecondLevel);
+
+    auto first = firstLevel * SubdivisionCount + secondLevel;
+    auto last = lastFirstLevel * SubdivisionCount + lastSecondLevel;
+
+    // Every list from the one the size maps to up to where the rounded search started.
+    // These can hold blocks both too small and large enough, so each is walked in full
+    for (auto list = first; list <= last; ++list) {
+        if (!(secondLevelMap[list / SubdivisionCount] & (1u << (list % SubdivisionCount)))) {
+            continue;
+        }
+
+        auto block = freeLists[list];
+        while (block != NoBlock) {
+            auto &candidate = blocks[block];
+            auto alignedOffset = (candidate.offset + alignment - 1) & ~(alignment - 1);
+            if (alignedOffset + size <= candidate.offset + candidate.size) {
+                return block;
+            }
+
+            block = candidate.nextFree;
+        }
+    }
+
+    return NoBlock;
+}
+
+uint32_t SectionAllocator::createBlock(vk::DeviceSize offset, vk::DeviceSize size) {
+    uint32_t index;
+    if (unusedBlocks.empty()) {
+        index = static_cast<uint32_t>(blocks.size());
+        blocks.emplace_back();
+    } else {
+        index = unusedBlocks.back();
+        unusedBlocks.pop_back();
+    }
+
+    blocks[index] = {
+        offset,
+        size,
+        NoBlock,
+        NoBlock,
+        NoBlock,
+        NoBlock,
+        false
+    };
+
+    return index;
+}
+
+void SectionAllocator::releaseBlock(uint32_t block) {
+    unusedBlocks.push_back(block);
+}
+
+void SectionAllocator::insertFree(uint32_t block) {
+    uint32_t firstLevel, secondLevel;
+    mapping(blocks[block].size, firstLevel, secondLevel);
+
+    auto &head = freeLists[firstLevel * SubdivisionCount + secondLevel];
+
+    blocks[block].isFree = true;
+    blocks[block].prevFree = NoBlock;
+    blocks[block].nextFree = head;
+    if (head != NoBlock) {
+        blocks[head].prevFree = block;
+    }
+    head = block;
+
+    firstLevelMap |= (1ull << firstLevel);
+    secondLevelMap[firstLevel] |= (1u << secondLevel);
+    ++freeBlockCount;
+}
+
+void SectionAllocator::removeFree(uint32_t block) {
+    uint32_t firstLevel, secondLevel;
+    mapping(blocks[block].size, firstLevel, secondLevel);
+
+    auto &head = freeLists[firstLevel * SubdivisionCount + secondLevel];
+    auto prev = blocks[block].prevFree;
+    auto next = blocks[block].nextFree;
+
+    if (prev != NoBlock) {
+        blocks[prev].nextFree = next;
+    }
+    if (next != NoBlock) {
+        blocks[next].prevFree = prev;
+    }
+
+    if (head == block) {
+        head = next;
+        if (head == NoBlock) {
+            secondLevelMap[firstLevel] &= ~(1u << secondLevel);
+            if (!secondLevelMap[firstLevel]) {
+                firstLevelMap &= ~(1ull << firstLevel);
+            }
+        }
+    }
+
+    blocks[block].isFree = false;
+    --freeBlockCount;
+}
+
+/**
+ * Splits the end off the block leaving it with the given size.
+ * The remainder is returned to the free lists.
+ */
+void SectionAllocator::splitAfter(uint32_t block, vk::DeviceSize size) {
+    auto remainder = createBlock(blocks[block].offset + size, blocks[block].size - size);
+    auto next = blocks[block].nextPhysical;
+
+    blocks[remainder].prevPhysical = block;
+    blocks[remainder].nextPhysical = next;
+    if (next != NoBlock) {
+        blocks[next].prevPhysical = remainder;
+    }
+
+    blocks[block].nextPhysical = remainder;
+    blocks[block].size = size;
+
+    insertFree(remainder);
+}
+
+/**
+ * Splits the given size off the start of the block.
+ * @returns The new block covering the start
+ */
+uint32_t SectionAllocator::splitBefore(uint32_t block, vk::DeviceSize size) {
+    auto start = createBlock(blocks[block].offset, size);
+    auto prev = blocks[block].prevPhysical;
+
+    blocks[start].prevPhysical = prev;
+    blocks[start].nextPhysical = block;
+    if (prev != NoBlock) {
+        blocks[prev].nextPhysical = start;
+    }
+
+    blocks[block].prevPhysical = start;
+    blocks[block].offset += size;
+    blocks[block].size -= size;
+
+    return start;
+}
+
+uint32_t SectionAllocator::merge(uint32_t first, uint32_t second) {
+    auto next = blocks[second].nextPhysical;
+
+    blocks[first].size += blocks[second].size;
+    blocks[first].nextPhysical = next;
+    if (next != NoBlock) {
+        blocks[next].prevPhysical = first;
+    }
+
+    releaseBlock(second);
+    return first;
+}
+
+}
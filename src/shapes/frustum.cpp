@@ -1,5 +1,14 @@
 #include <tech-core/shapes/frustum.hpp>
 #include <tech-core/shapes/plane.hpp>
+#include <algorithm>
+
+#if defined(__AVX__)
+#define FRUSTUM_CULL_AVX
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define FRUSTUM_CULL_SSE
+#include <immintrin.h>
+#endif
 
 namespace Engine {
 
@@ -50,4 +59,145 @@ void Frustum::update(const glm::mat4 &viewProj) {
     planes[Near] = normalize(rowW + rowZ);
     planes[Far] = normalize(rowW - rowZ);
 }
-}
\ No newline at end of file
+
+void Frustum::intersects(const BoxArrays &boxes, size_t count, uint64_t *visibility) const {
+    std::fill(visibility, visibility + (count + 63) / 64, 0);
+
+    // Only the corner furthest along each plane normal (the p-vertex) needs testing.
+    // The corner is the same for every box so pick the arrays up front
+    const float *pointX[6];
+    const float *pointY[6];
+    const float *pointZ[6];
+    for (int i = 0; i < 6; ++i) {
+        pointX[i] = (planes[i].x > 0) ? boxes.xMax : boxes.xMin;
+        pointY[i] = (planes[i].y > 0) ? boxes.yMax : boxes.yMin;
+        pointZ[i] = (planes[i].z > 0) ? boxes.zMax : boxes.zMin;
+    }
+
+    size_t index = 0;
+
+#if defined(FRUSTUM_CULL_AVX)
+    for (; index + 8 <= count; index += 8) {
+        __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int i = 0; i < 6; ++i) {
+            __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(
+                    _mm256_mul_ps(_mm256_set1_ps(planes[i].x), _mm256_loadu_ps(pointX[i] + index)),
+                    _mm256_mul_ps(_mm256_set1_ps(planes[i].y), _mm256_loadu_ps(pointY[i] + index))
+                ),
+                _mm256_add_ps(
+                    _mm256_mul_ps(_mm256_set1_ps(planes[i].z), _mm256_loadu_ps(pointZ[i] + index)),
+                    _mm256_set1_ps(planes[i].w)
+                )
+            );
+            visible = _mm256_and_ps(visible, _mm256_cmp_ps(distance, _mm256_setzero_ps(), _CMP_GT_OQ));
+        }
+
+        visibility[index / 64] |= static_cast<uint64_t>(_mm256_movemask_ps(visible)) << (index % 64);
+    }
+#elif defined(FRUSTUM_CULL_SSE)
+    for (; index + 4 <= count; index += 4) {
+        __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int i = 0; i < 6; ++i) {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(
+                    _mm_mul_ps(_mm_set1_ps(planes[i].x), _mm_loadu_ps(pointX[i] + index)),
+                    _mm_mul_ps(_mm_set1_ps(planes[i].y), _mm_loadu_ps(pointY[i] + index))
+                ),
+                _mm_add_ps(
+                    _mm_mul_ps(_mm_set1_ps(planes[i].z), _mm_loadu_ps(pointZ[i] + index)),
+                    _mm_set1_ps(planes[i].w)
+                )
+            );
+            visible = _mm_and_ps(visible, _mm_cmpgt_ps(distance, _mm_setzero_ps()));
+        }
+
+        visibility[index / 64] |= static_cast<uint64_t>(_mm_movemask_ps(visible)) << (index % 64);
+    }
+#endif
+
+    for (; index < count; ++index) {
+        bool visible = true;
+        for (int i = 0; i < 6 && visible; ++i) {
+            float distance = planes[i].x * pointX[i][index] + planes[i].y * pointY[i][index] +
+                planes[i].z * pointZ[i][index] + planes[i].w;
+            visible = distance > 0;
+        }
+
+        if (visible) {
+            visibility[index / 64] |= 1ull << (index % 64);
+        }
+    }
+}
+
+void Frustum::intersects(const SphereArrays &spheres, size_t count, uint64_t *visibility) const {
+    std::fill(visibility, visibility + (count + 63) / 64, 0);
+
+    // The planes are not normalised by their normal alone so scale the radius to match
+    float normalLength[6];
+    for (int i = 0; i < 6; ++i) {
+        normalLength[i] = glm::length(glm::vec3(planes[i]));
+    }
+
+    size_t index = 0;
+
+#if defined(FRUSTUM_CULL_AVX)
+    for (; index + 8 <= count; index += 8) {
+        __m256 x = _mm256_loadu_ps(spheres.x + index);
+        __m256 y = _mm256_loadu_ps(spheres.y + index);
+        __m256 z = _mm256_loadu_ps(spheres.z + index);
+        __m256 radius = _mm256_loadu_ps(spheres.radius + index);
+
+        __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int i = 0; i < 6; ++i) {
+            __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(
+                    _mm256_mul_ps(_mm256_set1_ps(planes[i].x), x),
+                    _mm256_mul_ps(_mm256_set1_ps(planes[i].y), y)
+                ),
+                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes[i].z), z), _mm256_set1_ps(planes[i].w))
+            );
+            __m256 limit = _mm256_sub_ps(
+                _mm256_setzero_ps(), _mm256_mul_ps(radius, _mm256_set1_ps(normalLength[i]))
+            );
+            visible = _mm256_and_ps(visible, _mm256_cmp_ps(distance, limit, _CMP_GT_OQ));
+        }
+
+        visibility[index / 64] |= static_cast<uint64_t>(_mm256_movemask_ps(visible)) << (index % 64);
+    }
+#elif defined(FRUSTUM_CULL_SSE)
+    for (; index + 4 <= count; index += 4) {
+        __m128 x = _mm_loadu_ps(spheres.x + index);
+        __m128 y = _mm_loadu_ps(spheres.y + index);
+        __m128 z = _mm_loadu_ps(spheres.z + index);
+        __m128 radius = _mm_loadu_ps(spheres.radius + index);
+
+        __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int i = 0; i < 6; ++i) {
+            __m128 distance = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[i].x), x), _mm_mul_ps(_mm_set1_ps(planes[i].y), y)),
+                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[i].z), z), _mm_set1_ps(planes[i].w))
+            );
+            __m128 limit = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(radius, _mm_set1_ps(normalLength[i])));
+            visible = _mm_and_ps(visible, _mm_cmpgt_ps(distance, limit));
+        }
+
+        visibility[index / 64] |= static_cast<uint64_t>(_mm_movemask_ps(visible)) << (index % 64);
+    }
+#endif
+
+    for (; index < count; ++index) {
+        bool visible = true;
+        for (int i = 0; i < 6 && visible; ++i) {
+            float distance = planes[i].x * spheres.x[index] + planes[i].y * spheres.y[index] +
+                planes[i].z * spheres.z[index] + planes[i].w;
+            visible = distance > -spheres.radius[index] * normalLength[i];
+        }
+
+        if (visible) {
+            visibility[index / 64] |= 1ull << (index % 64);
+        }
+    }
+}
+
+}
@@ -24,7 +24,11 @@ struct ImGuiPushConstant {
 
 void ImGuiSubsystem::initialiseWindow(GLFWwindow *window) {
     ImGui::CreateContext();
-    ImGui_ImplGlfw_InitForVulkan(window, true);
+
+    hasWindow = window != nullptr;
+    if (hasWindow) {
+        ImGui_ImplGlfw_InitForVulkan(window, true);
+    }
 }
 
 void ImGuiSubsystem::initialiseResources(
@@ -76,7 +80,8 @@ void ImGuiSubsystem::initialiseSwapChainResources(
         .withDynamicState(vk::DynamicState::eScissor)
         .withoutDepthWrite()
         .withoutDepthTest()
-        .bindSampledImagePoolImmutable(0, 0, MaxTexturesPerFrame, fontSampler)
+        // Each swap chain image gets its own range of the pool so frames in flight are not disturbed
+        .bindSampledImagePoolImmutable(0, 0, MaxTexturesPerFrame * swapChainImages, fontSampler)
         .withPushConstants<ImGuiPushConstant>(vk::ShaderStageFlagBits::eVertex);
 
     pipeline = builder
@@ -98,7 +103,9 @@ void ImGuiSubsystem::cleanupResources(vk::Device device, _E::RenderEngine &engin
     vertexBuffers.clear();
     vertexBuffers.shrink_to_fit();
 
-    ImGui_ImplGlfw_Shutdown();
+    if (hasWindow) {
+        ImGui_ImplGlfw_Shutdown();
+    }
     ImGui::DestroyContext();
 }
 
@@ -253,6 +260,7 @@ void ImGuiSubsystem::prepareFrame(uint32_t activeImage) {
     drawData = ImGui::GetDrawData();
 
     // Prepare the images and descriptor sets
+    uint32_t poolStart = activeImage * MaxTexturesPerFrame;
     uint32_t nextImagePoolIndex = 0;
     uint32_t nextTexturePoolIndex = 0;
 
@@ -276,13 +284,14 @@ void ImGuiSubsystem::prepareFrame(uint32_t activeImage) {
                     continue;
                 }
 
+                auto poolIndex = poolStart + nextImagePoolIndex;
                 if (image->isReadyForSampling()) {
-                    pipeline->updatePoolImage(0, 0, nextImagePoolIndex, *image, image->getCurrentLayout());
+                    pipeline->updatePoolImage(0, 0, poolIndex, *image, image->getCurrentLayout());
                 } else {
-                    pipeline->updatePoolImage(0, 0, nextImagePoolIndex, *image);
+                    pipeline->updatePoolImage(0, 0, poolIndex, *image);
                 }
 
-                imagePoolMapping[image] = nextImagePoolIndex;
+                imagePoolMapping[image] = poolIndex;
                 ++nextImagePoolIndex;
             }
         }
@@ -290,7 +299,14 @@ void ImGuiSubsystem::prepareFrame(uint32_t activeImage) {
 }
 
 void ImGuiSubsystem::beginFrame() {
-    ImGui_ImplGlfw_NewFrame();
+    if (hasWindow) {
+        ImGui_ImplGlfw_NewFrame();
+    } else {
+        auto bounds = engine->getScreenBounds();
+        auto &io = ImGui::GetIO();
+        io.DisplaySize = { bounds.width(), bounds.height() };
+        io.DeltaTime = 1.0f / 60.0f;
+    }
     ImGui::NewFrame();
     imagePoolMapping.clear();
 }
@@ -1,5 +1,6 @@
 #include "tech-core/swapchain.hpp"
 #include "tech-core/device.hpp"
+#include "tech-core/image.hpp"
 
 #include "vulkanutils.hpp"
 
@@ -14,11 +15,77 @@ SwapChain::SwapChain(vk::PhysicalDevice physicalDevice, VulkanDevice &device, vk
     setup(size);
 }
 
+SwapChain::SwapChain(VulkanDevice &device, std::vector<std::shared_ptr<Image>> targets)
+    : device(device), targets(std::move(targets)) {
+    auto &first = this->targets.front();
+    extent = { first->getWidth(), first->getHeight() };
+    imageFormat = first->getFormat();
+
+    for (auto &target : this->targets) {
+        images.push_back(target->image());
+        imageViews.push_back(target->imageView());
+    }
+}
+
 SwapChain::~SwapChain() {
 
 }
 
+vk::ImageLayout SwapChain::getFinalLayout() const {
+    if (isHeadless()) {
+        // Ready to be copied out
+        return vk::ImageLayout::eTransferSrcOptimal;
+    }
+
+    return vk::ImageLayout::ePresentSrcKHR;
+}
+
+uint32_t SwapChain::acquire(vk::Semaphore available) {
+    if (!isHeadless()) {
+        return device.device.acquireNextImageKHR(
+            swapChain, std::numeric_limits<uint64_t>::max(), available, vk::Fence()
+        ).value;
+    }
+
+    uint32_t imageIndex = nextTarget;
+    nextTarget = (nextTarget + 1) % targets.size();
+
+    // Nothing else is using the image so it is available straight away
+    vk::SubmitInfo submitInfo(0, nullptr, nullptr, 0, nullptr, 1, &available);
+    device.graphicsQueue.queue.submit(1, &submitInfo, {});
+
+    return imageIndex;
+}
+
+vk::Result SwapChain::present(uint32_t imageIndex, vk::Semaphore renderFinished) {
+    if (!isHeadless()) {
+        vk::PresentInfoKHR presentInfo(
+            1, &renderFinished,
+            1, &swapChain,
+            &imageIndex
+        );
+
+        return device.presentQueue.queue.presentKHR(presentInfo);
+    }
+
+    // The semaphore still has to be waited on before it can be signalled again
+    vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eAllCommands;
+    vk::SubmitInfo submitInfo(1, &renderFinished, &waitStage, 0, nullptr, 0, nullptr);
+    device.graphicsQueue.queue.submit(1, &submitInfo, {});
+
+    targets[imageIndex]->transitionOverride(
+        getFinalLayout(), true, vk::PipelineStageFlagBits::eColorAttachmentOutput
+    );
+
+    return vk::Result::eSuccess;
+}
+
 void SwapChain::rebuild(vk::Extent2D windowExtent) {
+    if (isHeadless()) {
+        // There is no surface to rebuild against, the targets keep their size
+        return;
+    }
+
     cleanup();
     setup(windowExtent);
 }
@@ -103,6 +170,11 @@ void SwapChain::setup(vk::Extent2D desiredExtent) {
 }
 
 void SwapChain::cleanup() {
+    if (isHeadless()) {
+        // The image views belong to the targets
+        return;
+    }
+
     for (auto &imageView : imageViews) {
         device.device.destroyImageView(imageView);
     }
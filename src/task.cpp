@@ -1,77 +1,253 @@
 #include "tech-core/task.hpp"
 #include "tech-core/device.hpp"
 #include "tech-core/buffer.hpp"
+#include "tech-core/image.hpp"
+#include "vulkanutils.hpp"
+
+#include <stdexcept>
 
 namespace Engine {
 
+// Command buffers are allocated in groups of this many. Each queue has at most one open batch
+// plus two flushed per frame for up to 3 frames in flight, so one group covers the worst case
+const uint32_t CommandBufferBatchSize = 8;
+
 TaskManager::TaskManager(VulkanDevice &device)
-    : device(device) {}
+    : device(device) {
+    graphicsTasks.queue = &device.graphicsQueue;
+    graphicsTasks.pool = device.graphicsPool;
+    transferTasks.queue = &device.transferQueue;
+    transferTasks.pool = device.transferPool;
+}
+
+TaskManager::~TaskManager() {
+    device.device.waitIdle();
+
+    for (auto queue : { &graphicsTasks, &transferTasks }) {
+        // Return everything to the pools first
+        queue->openBatch.reset();
+        queue->submittedBatches.clear();
+
+        if (!queue->allBuffers.empty()) {
+            device.device.freeCommandBuffers(queue->pool, vkUseArray(queue->allBuffers));
+        }
+    }
+}
 
 std::unique_ptr<Task> TaskManager::createTask() {
-    vk::CommandBufferAllocateInfo allocInfo(
-        device.graphicsPool,
-        vk::CommandBufferLevel::ePrimary,
-        1
-    );
+    return allocateTask(graphicsTasks, false);
+}
+
+std::unique_ptr<Task> TaskManager::createTransferTask() {
+    return allocateTask(transferTasks, true);
+}
 
-    auto commandBuffer = std::move(device.device.allocateCommandBuffersUnique(allocInfo)[0]);
+std::unique_ptr<Task> TaskManager::allocateTask(TaskQueue &queue, bool onTransferQueue) {
+    if (!queue.openBatch) {
+        if (queue.freeBuffers.empty()) {
+            vk::CommandBufferAllocateInfo allocInfo(
+                queue.pool,
+                vk::CommandBufferLevel::ePrimary,
+                CommandBufferBatchSize
+            );
 
-    vk::CommandBufferBeginInfo beginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
-    commandBuffer->begin(beginInfo);
+            auto buffers = device.device.allocateCommandBuffers(allocInfo);
+            queue.freeBuffers.insert(queue.freeBuffers.end(), buffers.begin(), buffers.end());
+            queue.allBuffers.insert(queue.allBuffers.end(), buffers.begin(), buffers.end());
+        }
 
-    vk::UniqueFence submitFence = device.device.createFenceUnique({});
+        auto commandBuffer = queue.freeBuffers.back();
+        queue.freeBuffers.pop_back();
+
+        vk::CommandBufferBeginInfo beginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
+        commandBuffer.begin(beginInfo);
+
+        queue.openBatch = Batch {};
+        queue.openBatch->commandBuffer = commandBuffer;
+        // Safe to reserve now as nothing else can signal this timeline before the batch is flushed
+        queue.openBatch->completion = queue.queue->nextTimelinePoint();
+    }
+
+    ++queue.openBatch->openTasks;
 
     return std::unique_ptr<Task>(
         new Task(
-            std::move(commandBuffer),
-            std::move(submitFence),
-            *this
+            queue.openBatch->commandBuffer,
+            queue.openBatch->completion,
+            *this,
+            onTransferQueue
         )
     );
 }
 
-vk::Fence TaskManager::submitTask(std::unique_ptr<Task> task) {
-    task->commandBuffer->end();
+void TaskManager::abandon(Task &task) {
+    auto &queue = task.onTransferQueue ? transferTasks : graphicsTasks;
+    if (!queue.openBatch) {
+        return;
+    }
 
-    vk::SubmitInfo submitInfo(0, nullptr, nullptr, 1, &task->commandBuffer.get());
-    device.graphicsQueue.queue.submit(1, &submitInfo, *task->submitFence);
+    auto &batch = *queue.openBatch;
+    --batch.openTasks;
 
-    auto fence = task->submitFence.get();
-    submittedTasks.push_back(std::move(task));
+    // Anything the task recorded is still submitted with the batch, so it must keep its
+    // waits and the buffers it reads from until the batch is complete
+    batch.waits.insert(batch.waits.end(), task.waits.begin(), task.waits.end());
+    batch.abandonedBuffers.insert(
+        batch.abandonedBuffers.end(), task.buffersToFree.begin(), task.buffersToFree.end()
+    );
+    for (auto &staging : task.stagingToFree) {
+        batch.abandonedStaging.push_back(std::move(staging));
+    }
+    task.stagingToFree.clear();
+}
+
+TimelinePoint TaskManager::submitTask(std::unique_ptr<Task> task) {
+    auto &queue = task->onTransferQueue ? transferTasks : graphicsTasks;
+    auto &batch = *queue.openBatch;
 
-    return fence;
+    task->submitted = true;
+    --batch.openTasks;
+
+    batch.waits.insert(batch.waits.end(), task->waits.begin(), task->waits.end());
+    batch.releaseBufferBarriers.insert(
+        batch.releaseBufferBarriers.end(), task->releaseBufferBarriers.begin(), task->releaseBufferBarriers.end()
+    );
+    batch.releaseImageBarriers.insert(
+        batch.releaseImageBarriers.end(), task->releaseImageBarriers.begin(), task->releaseImageBarriers.end()
+    );
+
+    auto &handOff = task->handOff;
+    batch.handOff.stages |= handOff.stages;
+    batch.handOff.bufferBarriers.insert(
+        batch.handOff.bufferBarriers.end(), handOff.bufferBarriers.begin(), handOff.bufferBarriers.end()
+    );
+    batch.handOff.imageBarriers.insert(
+        batch.handOff.imageBarriers.end(), handOff.imageBarriers.begin(), handOff.imageBarriers.end()
+    );
+
+    auto completion = task->completion;
+    batch.tasks.push_back(std::move(task));
+
+    return completion;
 }
 
-void TaskManager::processActions() {
-    submittedTasks.erase(
-        std::remove_if(
-            submittedTasks.begin(),
-            submittedTasks.end(),
-            [this](std::unique_ptr<Task> &task) {
-                if (this->device.device.waitForFences(1, &task->submitFence.get(), VK_FALSE, 0) ==
-                    vk::Result::eSuccess) {
-                    // Complete
-                    task->executeFinishCallbacks();
-                    return true;
-                }
-                return false;
-            }
-        ),
-        submittedTasks.end()
+void TaskManager::flush() {
+    flush(graphicsTasks);
+    flush(transferTasks);
+}
+
+void TaskManager::flush(TaskQueue &queue) {
+    if (!queue.openBatch) {
+        return;
+    }
+
+    auto &batch = *queue.openBatch;
+    if (batch.openTasks > 0) {
+        throw std::runtime_error("Tasks must be submitted before the frame is drawn");
+    }
+
+    if (!batch.releaseBufferBarriers.empty() || !batch.releaseImageBarriers.empty()) {
+        batch.commandBuffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe,
+            {},
+            0, nullptr,
+            vkUseArray(batch.releaseBufferBarriers),
+            vkUseArray(batch.releaseImageBarriers)
+        );
+    }
+
+    batch.commandBuffer.end();
+
+    std::vector<vk::Semaphore> waitSemaphores;
+    std::vector<uint64_t> waitValues;
+    std::vector<vk::PipelineStageFlags> waitStages;
+    for (auto &wait : batch.waits) {
+        waitSemaphores.push_back(wait.point.semaphore);
+        waitValues.push_back(wait.point.value);
+        waitStages.push_back(wait.stages);
+    }
+
+    vk::TimelineSemaphoreSubmitInfo timelineInfo(
+        vkUseArray(waitValues),
+        1, &batch.completion.value
+    );
+
+    vk::SubmitInfo submitInfo(
+        vkUseArray(waitSemaphores),
+        waitStages.data(),
+        1, &batch.commandBuffer,
+        1, &batch.completion.semaphore
     );
+    submitInfo.setPNext(&timelineInfo);
+
+    queue.queue->queue.submit(1, &submitInfo, {});
+
+    if (!batch.handOff.bufferBarriers.empty() || !batch.handOff.imageBarriers.empty()) {
+        // The graphics queue waits for the batch before acquiring the resources
+        batch.handOff.point = batch.completion;
+        pendingHandOffs.push_back(std::move(batch.handOff));
+    }
+
+    queue.submittedBatches.push_back(std::move(batch));
+    queue.openBatch.reset();
+}
+
+void TaskManager::processActions() {
+    retireCompleted(graphicsTasks);
+    retireCompleted(transferTasks);
+}
+
+void TaskManager::retireCompleted(TaskQueue &queue) {
+    if (queue.submittedBatches.empty()) {
+        return;
+    }
+
+    // A single read of the timeline tells us every batch that has completed on this queue
+    auto reached = device.device.getSemaphoreCounterValue(queue.queue->timeline);
+
+    while (!queue.submittedBatches.empty()) {
+        if (queue.submittedBatches.front().completion.value > reached) {
+            break;
+        }
+
+        // Callbacks may submit further tasks
+        auto batch = std::move(queue.submittedBatches.front());
+        queue.submittedBatches.pop_front();
+
+        for (auto &task : batch.tasks) {
+            task->executeFinishCallbacks();
+        }
+
+        batch.commandBuffer.reset({});
+        queue.freeBuffers.push_back(batch.commandBuffer);
+    }
+}
+
+std::vector<QueueHandOff> TaskManager::takeHandOffs() {
+    std::vector<QueueHandOff> handOffs;
+    handOffs.swap(pendingHandOffs);
+    return handOffs;
 }
 
 
 Task::Task(
-    vk::UniqueCommandBuffer commandBuffer,
-    vk::UniqueFence submitFence,
-    TaskManager &taskManager
-) : commandBuffer(std::move(commandBuffer)),
-    submitFence(std::move(submitFence)),
-    taskManager(taskManager) {}
+    vk::CommandBuffer commandBuffer,
+    const TimelinePoint &completion,
+    TaskManager &taskManager,
+    bool onTransferQueue
+) : commandBuffer(commandBuffer),
+    taskManager(taskManager),
+    onTransferQueue(onTransferQueue),
+    completion(completion) {}
+
+Task::~Task() {
+    if (!submitted) {
+        taskManager.abandon(*this);
+    }
+}
 
 void Task::execute(const std::function<void(vk::CommandBuffer)> &func) {
-    func(*commandBuffer);
+    func(commandBuffer);
 }
 
 void Task::addMemoryBarrier(
@@ -82,7 +258,7 @@ void Task::addMemoryBarrier(
 ) {
     vk::MemoryBarrier barrier(fromAccess, toAccess);
 
-    commandBuffer->pipelineBarrier(
+    commandBuffer.pipelineBarrier(
         fromStage, toStage,
         {},
         1, &barrier, // Memory barriers
@@ -91,6 +267,10 @@ void Task::addMemoryBarrier(
     );
 }
 
+void Task::waitFor(const TimelinePoint &point, const vk::PipelineStageFlags &stages) {
+    waits.push_back({ point, stages });
+}
+
 void Task::executeWhenComplete(const std::function<void()> &callback) {
     finishCallbacks.push_back(callback);
 }
@@ -109,4 +289,95 @@ void Task::freeWhenDone(std::unique_ptr<Buffer> &&buffer) {
     buffersToFree.emplace_back(std::move(buffer));
 }
 
-}
\ No newline at end of file
+void Task::freeWhenDone(std::unique_ptr<StagingBuffer> &&buffer) {
+    stagingToFree.emplace_back(std::move(buffer));
+}
+
+void Task::releaseToGraphics(
+    const Buffer &buffer, const vk::AccessFlags &dstAccess, const vk::PipelineStageFlags &dstStages
+) {
+    auto &device = taskManager.device;
+
+    if (!onTransferQueue || device.transferQueue.index == device.graphicsQueue.index) {
+        // Same queue family so a regular barrier is enough
+        vk::BufferMemoryBarrier barrier(
+            vk::AccessFlagBits::eTransferWrite, dstAccess,
+            VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+            buffer.buffer(), 0, VK_WHOLE_SIZE
+        );
+
+        commandBuffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer, dstStages,
+            {},
+            0, nullptr,
+            1, &barrier,
+            0, nullptr
+        );
+        return;
+    }
+
+    // Recorded with the rest of the batch's releases
+    releaseBufferBarriers.emplace_back(
+        vk::AccessFlagBits::eTransferWrite, vk::AccessFlags {},
+        device.transferQueue.index, device.graphicsQueue.index,
+        buffer.buffer(), 0, VK_WHOLE_SIZE
+    );
+
+    handOff.bufferBarriers.emplace_back(
+        vk::AccessFlags {}, dstAccess,
+        device.transferQueue.index, device.graphicsQueue.index,
+        buffer.buffer(), 0, VK_WHOLE_SIZE
+    );
+    handOff.stages |= dstStages;
+}
+
+void Task::releaseToGraphics(
+    Image &image, vk::ImageLayout layout, const vk::AccessFlags &dstAccess,
+    const vk::PipelineStageFlags &dstStages
+) {
+    auto &device = taskManager.device;
+
+    vk::ImageSubresourceRange range(
+        vk::ImageAspectFlagBits::eColor, 0, image.getMipLevels(), 0, image.getLayers()
+    );
+
+    if (!onTransferQueue || device.transferQueue.index == device.graphicsQueue.index) {
+        vk::ImageMemoryBarrier barrier(
+            vk::AccessFlagBits::eTransferWrite, dstAccess,
+            image.getCurrentLayout(), layout,
+            VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED,
+            image.image(), range
+        );
+
+        commandBuffer.pipelineBarrier(
+            vk::PipelineStageFlagBits::eTransfer, dstStages,
+            {},
+            0, nullptr,
+            0, nullptr,
+            1, &barrier
+        );
+    } else {
+        // The layout transition happens once, between the release and acquire.
+        // Recorded with the rest of the batch's releases
+        releaseImageBarriers.emplace_back(
+            vk::AccessFlagBits::eTransferWrite, vk::AccessFlags {},
+            image.getCurrentLayout(), layout,
+            device.transferQueue.index, device.graphicsQueue.index,
+            image.image(), range
+        );
+
+        handOff.imageBarriers.emplace_back(
+            vk::AccessFlags {}, dstAccess,
+            image.getCurrentLayout(), layout,
+            device.transferQueue.index, device.graphicsQueue.index,
+            image.image(), range
+        );
+        handOff.stages |= dstStages;
+    }
+
+    for (uint32_t layer = 0; layer < image.getLayers(); ++layer) {
+        image.transitionOverride(layout, false, dstStages, layer);
+    }
+}
+
+}
@@ -85,7 +85,16 @@ const Texture *TextureManager::add(const TextureBuilder &builder) {
         usage |= vk::ImageUsageFlagBits::eTransferSrc;
     }
 
-    auto task = engine.getTaskManager().createTask();
+    // Blitting mipmaps needs the graphics queue. Everything else is a plain copy
+    bool blitMipmaps = builder.mipType == TextureMipType::Generate && !useFallbackMipmapGen;
+
+    std::unique_ptr<Task> task;
+    if (blitMipmaps) {
+        task = engine.getTaskManager().createTask();
+    } else {
+        task = engine.getTaskManager().createTransferTask();
+    }
+
     auto imageBuilder = engine.createImage(width, height)
         .withFormat(vk::Format::eR8G8B8A8Unorm)
         .withImageTiling(vk::ImageTiling::eOptimal)
@@ -170,15 +179,22 @@ const Texture *TextureManager::add(const TextureBuilder &builder) {
             if (builder.mipType == TextureMipType::Generate && !useFallbackMipmapGen) {
                 // Blit the mipmaps
                 generateMipmaps(buffer, image);
-            }
 
-            image->transition(
-                buffer, vk::ImageLayout::eShaderReadOnlyOptimal, false,
-                vk::PipelineStageFlagBits::eFragmentShader
-            );
+                image->transition(
+                    buffer, vk::ImageLayout::eShaderReadOnlyOptimal, false,
+                    vk::PipelineStageFlagBits::eFragmentShader
+                );
+            }
         }
     );
 
+    if (!blitMipmaps) {
+        task->releaseToGraphics(
+            *image, vk::ImageLayout::eShaderReadOnlyOptimal, vk::AccessFlagBits::eShaderRead,
+            vk::PipelineStageFlagBits::eFragmentShader
+        );
+    }
+
     task->freeWhenDone(std::move(stagingBuffer));
 
     engine.getTaskManager().submitTask(std::move(task));
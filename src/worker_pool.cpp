@@ -0,0 +1,95 @@
+#include "worker_pool.hpp"
+#include <algorithm>
+
+namespace Engine::Internal {
+
+WorkerPool::WorkerPool(uint32_t threadCount) {
+    threads.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        threads.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+uint32_t WorkerPool::defaultThreadCount() {
+    auto cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 0;
+}
+
+void WorkerPool::parallelFor(
+    size_t count, size_t grainSize, const std::function<void(size_t begin, size_t end)> &callback
+) {
+    grainSize = std::max<size_t>(grainSize, 1);
+    if (count <= grainSize || threads.empty()) {
+        if (count > 0) {
+            callback(0, count);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard lock(mutex);
+        job = &callback;
+        jobCount = count;
+        jobGrain = grainSize;
+        nextItem = 0;
+        activeWorkers = static_cast<uint32_t>(threads.size());
+        ++generation;
+    }
+    wake.notify_all();
+
+    runRanges();
+
+    // Every worker must have left the job before it goes out of scope
+    std::unique_lock lock(mutex);
+    finished.wait(lock, [this] { return activeWorkers == 0; });
+    job = nullptr;
+}
+
+void WorkerPool::workerLoop() {
+    uint64_t seenGeneration = 0;
+
+    while (true) {
+        {
+            std::unique_lock lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) {
+                return;
+            }
+            seenGeneration = generation;
+        }
+
+        runRanges();
+
+        {
+            std::lock_guard lock(mutex);
+            if (--activeWorkers == 0) {
+                finished.notify_one();
+            }
+        }
+    }
+}
+
+void WorkerPool::runRanges() {
+    while (true) {
+        auto begin = nextItem.fetch_add(jobGrain);
+        if (begin >= jobCount) {
+            return;
+        }
+
+        (*job)(begin, std::min(begin + jobGrain, jobCount));
+    }
+}
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Engine::Internal {
+
+/**
+ * A fixed set of threads for splitting up CPU heavy loops.
+ * Only one loop runs at a time and the calling thread takes part in it.
+ */
+class WorkerPool {
+public:
+    /**
+     * @param threadCount The number of extra threads. Defaults to one less than the number of cores
+     */
+    explicit WorkerPool(uint32_t threadCount = defaultThreadCount());
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    /**
+     * Splits [0, count) into ranges of grainSize items and runs them across the workers.
+     * Returns once every range is complete. Small loops run on the calling thread only.
+     */
+    void parallelFor(size_t count, size_t grainSize, const std::function<void(size_t begin, size_t end)> &callback);
+
+    uint32_t getThreadCount() const { return static_cast<uint32_t>(threads.size()); }
+
+    static uint32_t defaultThreadCount();
+
+private:
+    // Owned
+    std::vector<std::thread> threads;
+
+    // State
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    uint64_t generation { 0 };
+    uint32_t activeWorkers { 0 };
+    bool stopping { false };
+
+    const std::function<void(size_t, size_t)> *job { nullptr };
+    size_t jobCount { 0 };
+    size_t jobGrain { 0 };
+    std::atomic<size_t> nextItem { 0 };
+
+    void workerLoop();
+    void runRanges();
+};
+
+}
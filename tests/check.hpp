@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+
+// Return code that ctest reports as skipped rather than failed, see SKIP_RETURN_CODE
+constexpr int TestSkipped = 77;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; \
+            std::exit(1); \
+        } \
+    } while (false)
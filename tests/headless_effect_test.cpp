@@ -0,0 +1,42 @@
+#include "check.hpp"
+#include "tech-core/camera.hpp"
+#include "tech-core/engine.hpp"
+#include "tech-core/post_processing.hpp"
+#include "tech-core/scene/scene.hpp"
+
+#include <stdexcept>
+
+/**
+ * Adding an effect after initialization rebuilds the swap chain, which must not
+ * touch the surface when there is none.
+ */
+int main() {
+    Engine::FPSCamera camera(90, { 0, 10, 10 }, 0, 0);
+    Engine::RenderEngine engine;
+    engine.setHeadless(320, 240);
+
+    try {
+        engine.initialize("Headless effect test");
+    } catch (std::runtime_error &error) {
+        // No Vulkan device to run on
+        std::cerr << "Skipped: " << error.what() << std::endl;
+        return TestSkipped;
+    }
+
+    engine.setCamera(camera);
+    engine.setScene(std::make_shared<Engine::Scene>());
+
+    auto effect = engine.createEffect("passthrough")
+        .withShader(PASSTHROUGH_SHADER)
+        .build();
+    engine.addEffect(effect);
+
+    CHECK(engine.getEffect("passthrough") == effect);
+
+    for (int frame = 0; frame < 3; ++frame) {
+        CHECK(engine.beginFrame());
+        engine.render();
+    }
+
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include "check.hpp"
+#include "tech-core/section_allocator.hpp"
+
+using namespace Engine;
+
+/**
+ * A free block that exactly fits the request sits in the request's own size class,
+ * which the rounded up search skips over.
+ */
+void testExactFit() {
+    SectionAllocator allocator(1000);
+
+    CHECK(allocator.allocate(10) == 0);
+    CHECK(allocator.allocate(990) == 10);
+    CHECK(allocator.getStats().freeSize == 0);
+    CHECK(allocator.allocate(1) == ALLOCATION_FAILED);
+}
+
+void testExactFitAfterFree() {
+    SectionAllocator allocator(4096);
+
+    auto first = allocator.allocate(1000);
+    auto second = allocator.allocate(1000);
+    CHECK(allocator.allocate(2096) != ALLOCATION_FAILED);
+
+    // Leaves a single free block of exactly 1000 between used ones
+    allocator.free(first);
+    CHECK(allocator.allocate(1000) == first);
+
+    allocator.free(second);
+    CHECK(allocator.allocate(1000, 8) == second);
+}
+
+void testWholeCapacity() {
+    for (vk::DeviceSize total = 1; total < 5000; ++total) {
+        SectionAllocator allocator(total);
+        CHECK(allocator.allocate(total) == 0);
+    }
+}
+
+int main() {
+    testExactFit();
+    testExactFitAfterFree();
+    testWholeCapacity();
+
+    return 0;
+}